@@ -4,10 +4,18 @@
 extern "C" {
 #endif
 
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 #include <uw.h>
 
 #define AMW_MAX_RECURSION_DEPTH  100
 
+// AMW blocks are parsed without recursion, their nesting is limited by memory only
+#define AMW_MAX_BLOCK_DEPTH  UINT_MAX
+
 #define AMW_COMMENT  '#'
 
 typedef struct {
@@ -29,23 +37,95 @@ extern UwTypeId UwTypeId_AmwStatus;
 /*
  * AMW error codes
  */
-extern uint16_t AMW_END_OF_BLOCK;  // for internal use
 extern uint16_t AMW_PARSE_ERROR;
+extern uint16_t AMW_IO_ERROR;
+extern uint16_t AMW_BAD_COMPILED_DATA;
+
+typedef struct _AmwFrame AmwFrame;  // see amw_parser.c
+typedef struct _AmwConvspec AmwConvspec;  // see amw_parser.c
+typedef struct _AmwRegistry AmwRegistry;  // see amw_parser.c
+
+typedef struct _AmwParser AmwParser;
+
+typedef UwResult (*AmwBlockParserFunc)(AmwParser* parser);
+
+typedef struct {
+    /*
+     * Streaming of top-level entries.
+     *
+     * If the parser has a handler, entries of the top-level map or list
+     * are passed to `entry` as soon as they are parsed and not added to the container,
+     * so the memory is used for one entry at a time. The top-level container
+     * is returned empty. Other top-level values are returned as usual.
+     *
+     * This works for both AMW and JSON. In lazy mode entries may be deferred values.
+     * Errors returned by handler functions stop parsing and are returned by the parser.
+     */
+    UwResult (*begin)(void* ctx, bool is_map);
+    UwResult (*entry)(void* ctx, UwValuePtr key, UwValuePtr value);  // key is nullptr for list items
+    UwResult (*end)(void* ctx);
+} AmwEventHandler;
+
+typedef UwResult (*AmwReadLinesFunc)(void* ctx, UwValuePtr lines);
+/*
+ * Append more lines to `lines` array, append nothing at the end of input.
+ * See AmwParser.read_lines.
+ */
 
-typedef struct  {
+#define AMW_NUM_BUILTIN_CONVSPECS  6
+
+struct _AmwParser {
     _UwValue  markup;
     _UwValue  current_line;
     unsigned  current_indent;  // measured indentation of current line
     unsigned  line_number;
     unsigned  block_indent;    // indent of current block
-    unsigned  blocklevel;      // recursion level
+    unsigned  blocklevel;      // nesting level of blocks
     unsigned  max_blocklevel;
     unsigned  json_depth;      // recursion level for JSON
     unsigned  max_json_depth;
     bool      skip_comments;   // initially true to skip leading comments in the block
     bool      eof;
-    _UwValue  custom_parsers;
-} AmwParser;
+    bool      validate_only;   // check markup without constructing values
+    bool      lazy;            // defer parsing of nested blocks, see amw_parse_lazy
+    bool      compute_hashes;  // see amw_parse_hashed
+    AmwRegistry* registry;     // conversion specifiers, shared and copied on write
+
+    // line pushed back at the end of block, see unread_line
+    _UwValue  unread_line;
+    bool      have_unread_line;
+    unsigned  unread_indent;
+    unsigned  unread_line_number;
+
+    _UwValue  key_intern;      // optional map of keys to themselves, see amw_parse_interned
+    _UwValue  read_status;     // error status of failed _amw_read_block_line
+
+    // stack of lists and maps being parsed
+    AmwFrame* frames;
+    unsigned  num_frames;
+    unsigned  frames_capacity;
+
+    // hashes computed when compute_hashes is set
+    uint64_t  raw_hash;        // hash of lines read so far
+    unsigned  hashed_lines;    // number of hashed lines, lines are not hashed twice after unread
+    uint64_t  value_hash;      // structural hash of the last value parsed by the driver
+    _UwValue  section_hashes;  // structural hashes of top-level map values
+
+    // used when markup is an array of lines
+    unsigned  line_index;          // next line to read
+    unsigned  end_line_index;      // stop reading at this line
+    unsigned  line_number_offset;  // line_number of markup[i] is line_number_offset + i + 1
+
+    // optional function to refill markup array when all lines are read,
+    // lines already read are removed from the array, see amw_read_fd_lines;
+    // in lazy mode deferred blocks copy their lines in this case
+    AmwReadLinesFunc read_lines;
+    void*     read_lines_ctx;
+
+    // optional handler of top-level entries
+    AmwEventHandler* handler;
+    void*     handler_ctx;
+};
 
 
 AmwParser* amw_create_parser(UwValuePtr markup);
@@ -53,6 +133,8 @@ AmwParser* amw_create_parser(UwValuePtr markup);
  * Create parser for `markup` which can be either File, StringIO, or any other value
  * that supports line reader interface. See UW library.
  *
+ * Markup can also be an array of lines.
+ *
  * This function invokes uw_start_read_lines for markup.
  *
  * Return parser on success or nullptr if out of memory.
@@ -63,11 +145,33 @@ void amw_delete_parser(AmwParser** parser_ptr);
  * Delete parser. The format of the argument is natural for gnu::cleanup attribute.
  */
 
-typedef UwResult (*AmwBlockParserFunc)(AmwParser* parser);
-
 UwResult amw_set_custom_parser(AmwParser* parser, char* convspec, AmwBlockParserFunc parser_func);
 /*
  * Set custom parser function for `convspec`.
+ * Built-in conversion specifiers can be overridden too.
+ *
+ * Parser functions should not construct values if `parser->validate_only` is set.
+ */
+
+AmwRegistry* _amw_registry_ref(AmwRegistry* registry);
+void _amw_registry_unref(AmwRegistry** registry_ptr);
+/*
+ * Share registry of conversion specifiers with deferred blocks.
+ */
+
+UwResult amw_parser_reset(AmwParser* parser, UwValuePtr markup);
+/*
+ * Prepare parser for another `markup`, reusing its buffers.
+ * Custom parsers and options such as validate_only, lazy, and key_intern are kept.
+ *
+ * Return UwOK on success.
+ */
+
+UwResult amw_parser_parse(AmwParser* parser);
+/*
+ * Parse markup the parser was created or reset for.
+ *
+ * Return parsed value or error.
  */
 
 UwResult amw_parse(UwValuePtr markup);
@@ -84,28 +188,923 @@ UwResult amw_parse_json(UwValuePtr markup);
  * Return parsed value or error.
  */
 
+UwResult amw_parser_parse_json(AmwParser* parser);
+/*
+ * Parse markup the parser was created or reset for as pure JSON.
+ *
+ * Return parsed value or error.
+ */
+
+UwResult amw_parse_lazy(UwValuePtr markup);
+/*
+ * Parse `markup` deferring nested blocks that start on the next line.
+ * Such blocks are returned as AmwDeferred values, use amw_resolve to get them parsed.
+ *
+ * Return parsed value or error.
+ */
+
+UwResult amw_parse_interned(UwValuePtr markup, UwValuePtr key_intern);
+/*
+ * Parse `markup` replacing string map keys with instances from `key_intern` map,
+ * so equal keys share the same string.
+ *
+ * `key_intern` is a map of keys to themselves. New keys are added to it.
+ * The same table can be used for multiple documents, but not concurrently.
+ *
+ * Return parsed value or error.
+ */
+
+typedef struct {
+    uint64_t  raw;         // hash of markup lines
+    uint64_t  structural;  // amw_value_hash of parsed value
+    _UwValue  sections;    // map of top-level keys to UwUnsigned structural hashes of their values
+} AmwHashes;
+
+UwResult amw_parse_hashed(UwValuePtr markup, AmwHashes* hashes);
+/*
+ * Parse `markup` and compute hashes while parsing.
+ *
+ * `structural` equals amw_value_hash of the returned value. Duplicate keys
+ * replace previous entries in the hash as they do in the map.
+ *
+ * `sections` is empty if top-level value is not a map.
+ * The caller should destroy it.
+ *
+ * Return parsed value or error.
+ */
+
+UwResult amw_parse_parallel(UwValuePtr markup, unsigned num_threads);
+/*
+ * Parse `markup` splitting top-level map or list into parts
+ * and parsing them in `num_threads` threads.
+ * If `num_threads` is zero, use the number of online CPUs.
+ *
+ * Only markup with top-level keys or items starting from the first column
+ * is split. Other markup is parsed sequentially.
+ *
+ * Return parsed value or error, the same as amw_parse would return.
+ */
+
+UwResult amw_parse_parallel_interned(UwValuePtr markup, unsigned num_threads, UwValuePtr key_intern);
+/*
+ * Parse `markup` in parallel like amw_parse_parallel, interning keys like amw_parse_interned.
+ *
+ * Parts are parsed concurrently, so each part interns keys in its own table.
+ * When parts are merged, their keys are added to `key_intern` and top-level keys
+ * are replaced with instances from it. Nested keys are shared within a part only.
+ */
+
+UwResult amw_validate(UwValuePtr markup);
+/*
+ * Check `markup` without constructing values.
+ *
+ * Return success or the same error as amw_parse would return.
+ */
+
+UwResult amw_validate_json(UwValuePtr markup);
+/*
+ * Check `markup` as pure JSON without constructing values.
+ *
+ * Return success or the same error as amw_parse_json would return.
+ */
+
+/*
+ * Incremental reparsing
+ */
+
+typedef struct {
+    unsigned   first_line;  // index of the first replaced line
+    unsigned   num_lines;   // number of replaced lines, zero to insert only
+    UwValuePtr new_lines;   // array of lines to insert, nullptr to delete only
+} AmwEdit;
+
+UwResult amw_reparse(UwValuePtr doc, UwValuePtr source_lines, AmwEdit* edits, unsigned num_edits);
+/*
+ * Apply `edits` to `source_lines` and return the value the new source parses to.
+ *
+ * `doc` must be the result of parsing `source_lines` before the edits.
+ * Edits are applied in order, line indexes of each edit refer to the source
+ * with previous edits applied. `source_lines` is replaced with the new array of lines.
+ *
+ * Only the smallest block of nested maps and lists that encloses all edited lines
+ * is parsed again, the rest of the result shares values with `doc`.
+ * If the block cannot be determined, the whole source is parsed.
+ *
+ * Return parsed value or error, the same as amw_parse would return for the new source.
+ */
+
+/*
+ * Schema-driven parsing
+ *
+ * Top-level map is parsed directly into C struct described by schema,
+ * without constructing intermediate maps and lists.
+ */
+
+typedef enum {
+    AMW_FIELD_BOOL = 0,  // bool
+    AMW_FIELD_INT,       // int64_t
+    AMW_FIELD_UINT,      // uint64_t
+    AMW_FIELD_FLOAT,     // double, integers are converted
+    AMW_FIELD_STRING,    // _UwValue
+    AMW_FIELD_VALUE,     // _UwValue of any type, parsed as usual
+    AMW_FIELD_STRUCT     // nested struct described by `schema`
+} AmwFieldType;
+
+typedef struct _AmwSchema AmwSchema;
+
+typedef struct {
+    char*        name;       // map key
+    size_t       offset;     // offset of field in the struct
+    AmwFieldType type;
+    AmwSchema*   schema;     // for AMW_FIELD_STRUCT
+    bool         required;   // missing key is an error
+    bool         optional;   // for AMW_FIELD_STRUCT: missing key is not an error
+                             // even if nested schema has required fields
+    bool         has_default;
+    union {
+        bool     bool_value;
+        int64_t  signed_value;
+        uint64_t unsigned_value;
+        double   float_value;
+        char*    string_value;
+    } default_value;         // used when key is missing and has_default is set,
+                             // otherwise field is set to zero or null
+
+    // computed by amw_init_schema
+    uint64_t     name_hash;
+    unsigned     name_length;
+} AmwField;
+
+struct _AmwSchema {
+    AmwField* fields;
+    unsigned  num_fields;
+    bool      initialized;
+};
+
+UwResult amw_init_schema(AmwSchema* schema);
+/*
+ * Compute hashes of field names for `schema` and nested schemas.
+ * This is done by amw_parse_into on first use, call it explicitly
+ * if the schema is shared by threads.
+ */
+
+UwResult amw_parse_into(UwValuePtr markup, AmwSchema* schema, void* out);
+/*
+ * Parse `markup` which must be a map and write values to the struct
+ * pointed by `out`. Keys not described by schema are checked and skipped.
+ * If the same key appears more than once, the last value is taken.
+ *
+ * If the key of nested struct is missing, required fields of its schema
+ * are reported missing unless the struct field is optional.
+ *
+ * On success the caller should free the struct with amw_destroy_struct.
+ * On error the struct is already freed.
+ *
+ * Return UwOK or error.
+ */
+
+void amw_destroy_struct(AmwSchema* schema, void* out);
+/*
+ * Destroy string and value fields of struct filled by amw_parse_into.
+ */
+
+/*
+ * Output
+ *
+ * Serializers write to output buffer which is passed to `flush` function
+ * when full and when serialization is complete. With `flush` function
+ * the buffer keeps its initial size and long values are written in slices.
+ * If `flush` is null, the buffer grows and accumulates all output,
+ * set `length` to zero to reuse it.
+ */
+
+typedef UwResult (*AmwFlushFunc)(void* ctx, char* data, size_t size);
+
+typedef struct {
+    char*     data;
+    size_t    length;    // number of bytes in the buffer
+    size_t    capacity;
+    AmwFlushFunc flush;
+    void*     ctx;       // argument for flush function
+} AmwOutput;
+
+#define AMW_DEFAULT_OUTPUT_CAPACITY  65536
+#define AMW_MIN_OUTPUT_CAPACITY      32768  // fits the largest chunk serializers reserve at once
+
+UwResult amw_init_output(AmwOutput* output, size_t capacity, AmwFlushFunc flush, void* ctx);
+/*
+ * Allocate output buffer. If `capacity` is zero, use default.
+ * With `flush` function capacity is at least AMW_MIN_OUTPUT_CAPACITY.
+ */
+
+void amw_fini_output(AmwOutput* output);
+/*
+ * Release output buffer. Pending data is discarded, call amw_flush_output first.
+ */
+
+UwResult amw_flush_output(AmwOutput* output);
+/*
+ * Pass pending data to flush function, if set.
+ */
+
+UwResult amw_write_fd(void* ctx, char* data, size_t size);
+/*
+ * Flush function that writes data to file descriptor `ctx` points to.
+ */
+
+UwResult _amw_output_reserve(AmwOutput* output, size_t size);
+/*
+ * Make sure the buffer has room for `size` bytes, flushing or growing it.
+ * Buffer with flush function is never grown, `size` must not exceed its capacity.
+ */
+
+UwResult _amw_output_write_slices(AmwOutput* output, char* data, size_t size);
+/*
+ * Write data that does not fit the buffer, flushing it as many times as needed.
+ */
+
+static inline UwResult _amw_output_write(AmwOutput* output, char* data, size_t size)
+{
+    if (output->capacity - output->length < size) {
+        return _amw_output_write_slices(output, data, size);
+    }
+    memcpy(output->data + output->length, data, size);
+    output->length += size;
+    return UwOK();
+}
+
+static inline UwResult _amw_output_putc(AmwOutput* output, char c)
+{
+    if (output->length == output->capacity) {
+        UwValue status = _amw_output_reserve(output, 1);
+        uw_return_if_error(&status);
+    }
+    output->data[output->length++] = c;
+    return UwOK();
+}
+
+/*
+ * Serialization
+ */
+
+UwResult amw_dump(UwValuePtr value, AmwOutput* output);
+/*
+ * Write `value` as AMW markup and flush output.
+ *
+ * Strings are written as literals where the parser would read them back unchanged,
+ * multi-line strings as :literal: blocks where possible, and quoted otherwise.
+ * Empty lists and maps are written as :json: [] and :json: {}.
+ * Deferred values are resolved.
+ *
+ * The result of amw_parse for the output is equal to `value`, except that
+ * unsigned integers within signed range become signed.
+ * Infinite and NaN floats cannot be written.
+ */
+
+UwResult amw_dump_json(UwValuePtr value, AmwOutput* output);
+/*
+ * Write `value` as compact JSON and flush output.
+ *
+ * Non-string map keys are converted to strings, datetimes are written
+ * as ISO 8601 strings, and timestamps as numbers.
+ * Deferred values are resolved.
+ */
+
+UwResult _amw_dump_json_value(AmwOutput* output, UwValuePtr value);
+UwResult _amw_dump_json_key(AmwOutput* output, UwValuePtr key);
+/*
+ * Write JSON value, or object key followed by colon. Output is not flushed.
+ */
+
+UwResult _amw_dump_key(AmwOutput* output, UwValuePtr key);
+/*
+ * Write map key followed by colon. Output is not flushed.
+ */
+
+UwResult _amw_dump_value(AmwOutput* output, UwValuePtr value, unsigned indent, bool map_value);
+/*
+ * Write value of map entry or list item which key or item marker is at `indent`.
+ * The output starts right after the colon or hyphen and ends with line break.
+ * Output is not flushed.
+ */
+
+unsigned _amw_format_unsigned(uint64_t value, char* buf);
+unsigned _amw_format_signed(int64_t value, char* buf);
+/*
+ * Write decimal integer to `buf` of at least 21 bytes.
+ * Return length.
+ */
+
+unsigned _amw_format_float(double value, char* buf);
+/*
+ * Write the shortest decimal that is parsed back as the same float,
+ * with decimal point or exponent, to `buf` of at least 32 bytes.
+ * Negative zero is written as 0.0 because the parser does not keep its sign.
+ * Return length or zero if value is infinite or NaN.
+ */
+
+unsigned _amw_format_datetime(UwValuePtr value, char* buf);
+/*
+ * Write datetime in ISO 8601 format to `buf` of at least 64 bytes.
+ * Return length.
+ */
+
+unsigned _amw_format_timestamp(UwValuePtr value, char* buf);
+/*
+ * Write timestamp as seconds with optional fraction to `buf` of at least 32 bytes.
+ * Return length.
+ */
+
+/*
+ * Streaming writer
+ *
+ * The writer generates AMW markup from a sequence of calls without building a tree.
+ * It keeps track of indentation and emits conversion specifiers where needed,
+ * the output is the same as amw_dump would produce for the equivalent value.
+ *
+ * Data is written to file descriptor through fixed-size buffer and nesting depth
+ * is limited, so memory usage does not depend on document size.
+ * The buffer may grow temporarily only for a single string longer than the buffer.
+ *
+ * Example:
+ *
+ *     amw_writer_begin_map(&writer);
+ *     amw_writer_key(&writer, &key);
+ *     amw_writer_begin_list(&writer);
+ *     amw_writer_scalar(&writer, &item);
+ *     amw_writer_end(&writer);
+ *     amw_writer_end(&writer);
+ *     amw_writer_finish(&writer);
+ *
+ * Functions return UW_ERROR_INCOMPATIBLE_TYPE if called out of sequence.
+ * After any error the state of the writer and the output are undefined.
+ */
+
+#define AMW_WRITER_MAX_DEPTH  AMW_MAX_RECURSION_DEPTH
+
+typedef struct {
+    bool      is_map;
+    bool      after_key;    // container is a map value, items start on the next line
+    bool      key_written;  // map key is written, value expected
+    unsigned  count;        // number of items or keys written
+    unsigned  indent;       // indent of items or keys
+} AmwWriterFrame;
+
+typedef struct {
+    AmwOutput output;
+    int       fd;
+    unsigned  depth;
+    bool      done;         // top-level value is started
+    AmwWriterFrame frames[AMW_WRITER_MAX_DEPTH];
+} AmwWriter;
+
+UwResult amw_writer_init(AmwWriter* writer, int fd, size_t buffer_size);
+/*
+ * Initialize writer for file descriptor `fd`.
+ * If `buffer_size` is zero, use default.
+ * The writer refers to itself and must not be moved after initialization.
+ */
+
+void amw_writer_fini(AmwWriter* writer);
+/*
+ * Release writer buffer. Pending data is discarded, call amw_writer_finish first.
+ */
+
+UwResult amw_writer_begin_map(AmwWriter* writer);
+UwResult amw_writer_begin_list(AmwWriter* writer);
+/*
+ * Start map or list as the next value.
+ */
+
+UwResult amw_writer_key(AmwWriter* writer, UwValuePtr key);
+/*
+ * Write map key. The next call must write its value.
+ */
+
+UwResult amw_writer_scalar(AmwWriter* writer, UwValuePtr value);
+/*
+ * Write the next value. Lists and maps are accepted as well
+ * and written entirely, as amw_dump does.
+ */
+
+UwResult amw_writer_end(AmwWriter* writer);
+/*
+ * End current map or list.
+ */
+
+UwResult amw_writer_finish(AmwWriter* writer);
+/*
+ * Make sure the document is complete and flush output.
+ */
+
+/*
+ * Concrete syntax tree
+ *
+ * The tree maps map entries and list items of a parsed document to byte ranges
+ * of the source, so a value can be replaced without touching the rest of the source.
+ * Comments, blank lines, and formatting of unchanged parts are kept,
+ * and writing the document is mostly copying of unchanged ranges.
+ *
+ * Only maps and lists written as indented blocks have nodes for their entries.
+ * Values written with conversion specifiers or in a layout the tree does not recognize
+ * have no child nodes and can only be replaced as a whole.
+ */
+
+typedef struct {
+    _UwValue  key;           // map key, null for list items and the root
+    unsigned  indent;        // column of the key or list item marker
+    unsigned  first_line;    // lines of the entry
+    unsigned  end_line;      // trailing blank lines and unindented comments are excluded
+    size_t    value_start;   // byte offset after the colon or hyphen, start of the first line for the root
+    size_t    end;           // byte offset after the last line
+    unsigned  first_child;   // child node indexes, zero if none
+    unsigned  last_child;
+    unsigned  next_sibling;
+    unsigned  num_children;
+    unsigned  patch;         // index of the patch replacing the value, or UINT_MAX
+    _UwValue  children;      // child node indexes by key or list index, built on first lookup
+    bool      is_map;        // the value is a block map or list with child nodes
+    bool      is_list;
+} AmwCstNode;
+
+typedef struct {
+    size_t    start;         // replaced range of the source
+    size_t    end;
+    unsigned  node;          // the node the patch belongs to
+    bool      removed;       // the patch is within a value replaced later
+    AmwOutput text;          // new text for the range
+} AmwCstPatch;
+
+typedef struct {
+    uint8_t*  data;          // source
+    size_t    size;
+    size_t*   line_starts;   // byte offsets of lines, followed by `size`
+    unsigned  num_lines;
+    _UwValue  lines;         // source split into lines
+    _UwValue  value;         // parsed source, edits do not change it
+
+    AmwCstNode* nodes;       // nodes[0] is the root
+    unsigned  num_nodes;
+    unsigned  nodes_capacity;
+
+    AmwCstPatch* patches;
+    unsigned  num_patches;
+    unsigned  patches_capacity;
+} AmwCst;
+
+UwResult amw_cst_init(AmwCst* cst, char* data, size_t size);
+/*
+ * Parse `data` and build the tree. The data is copied.
+ * On error the tree is empty and can be passed to amw_cst_fini.
+ */
+
+UwResult amw_cst_read_file(AmwCst* cst, char* path);
+/*
+ * Read file and build the tree.
+ */
+
+void amw_cst_fini(AmwCst* cst);
+/*
+ * Release the tree and the source.
+ */
+
+UwResult amw_cst_set(AmwCst* cst, UwValuePtr path, UwValuePtr value);
+/*
+ * Replace the value at `path` which is an array of map keys and list indexes.
+ * Empty path replaces the whole document.
+ *
+ * If the last element of the path is a key missing in the map, or an index
+ * equal to the length of the list, the entry is appended.
+ * Replaced values have no child nodes, so they can only be replaced again as a whole.
+ *
+ * Return UW_ERROR_INDEX_OUT_OF_RANGE if path is not found and
+ * UW_ERROR_INCOMPATIBLE_TYPE if it goes through a node with no children.
+ */
+
+UwResult amw_cst_write(AmwCst* cst, AmwOutput* output);
+/*
+ * Write the source with all replacements and flush output.
+ * Unchanged ranges larger than output buffer are passed to flush function directly.
+ */
+
+/*
+ * Compiled documents
+ *
+ * Compiled document is a position-independent image of parsed value.
+ * It can be mapped into memory and read without deserialization.
+ *
+ * The image consists of header, nodes and tables of containers, and string pool.
+ * All offsets, except offsets of strings, are from the beginning of the image.
+ * Offsets of strings are from the beginning of string pool.
+ * Strings are stored in UTF-8 with length in the node, they may contain zero bytes.
+ * Each string is followed by zero byte for convenience of C code.
+ *
+ * List table is an array of uint32_t node offsets.
+ * Map table is an array of uint32_t key and value node offsets in original order,
+ * followed by array of uint32_t entry indexes sorted by keys.
+ *
+ * Byte order is native, images are not portable across architectures.
+ */
+
+#define AMW_COMPILED_MAGIC    "AMWC"
+#define AMW_COMPILED_VERSION  1
+
+typedef enum {
+    AMW_COMPILED_NULL = 0,
+    AMW_COMPILED_BOOL,
+    AMW_COMPILED_SIGNED,
+    AMW_COMPILED_UNSIGNED,
+    AMW_COMPILED_FLOAT,
+    AMW_COMPILED_STRING,
+    AMW_COMPILED_DATETIME,
+    AMW_COMPILED_TIMESTAMP,
+    AMW_COMPILED_LIST,
+    AMW_COMPILED_MAP
+} AmwCompiledType;
+
+typedef struct {
+    char      magic[4];
+    uint32_t  version;
+    uint64_t  size;      // size of image
+    uint64_t  root;      // offset of root node
+    uint64_t  strings;   // offset of string pool
+} AmwCompiledHeader;
+
+typedef struct {
+    uint8_t   type;        // AmwCompiledType
+    uint8_t   reserved;
+    int16_t   gmt_offset;  // datetime
+    uint32_t  length;      // string length in bytes, number of list items or map entries, nanoseconds
+    union {
+        bool      bool_value;
+        int64_t   signed_value;
+        uint64_t  unsigned_value;
+        double    float_value;
+        uint64_t  offset;     // string or table
+        uint64_t  datetime;   // year << 40 | month << 32 | day << 24 | hour << 16 | minute << 8 | second
+        uint64_t  seconds;    // timestamp
+    };
+} AmwCompiledNode;
+
+_Static_assert(sizeof(AmwCompiledHeader) == 32, "AmwCompiledHeader must be 32 bytes");
+_Static_assert(sizeof(AmwCompiledNode) == 16, "AmwCompiledNode must be 16 bytes");
+
+typedef struct {
+    uint8_t*  data;
+    size_t    size;
+    void*     mapping;       // memory mapping to unmap on close, if any
+    size_t    mapping_size;
+    bool      allocated;     // data is allocated with `allocate` and released on close
+} AmwCompiled;
+
+UwResult amw_compile(UwValuePtr markup, char* out_path);
+/*
+ * Parse markup and write compiled document to `out_path`.
+ *
+ * The file is written to a temporary file, synced to disk, and then renamed,
+ * so readers never see incomplete image, even after crash.
+ */
+
+UwResult amw_compile_value(UwValuePtr value, char* out_path);
+/*
+ * Write compiled `value` to `out_path`.
+ */
+
+UwResult _amw_compile_to_buffer(UwValuePtr value, uint8_t** data, size_t* size);
+/*
+ * Compile `value` into memory allocated with `allocate`.
+ * The caller should `release` it.
+ */
+
+UwResult amw_open_compiled(char* path, AmwCompiled* compiled);
+/*
+ * Map compiled document into memory.
+ */
+
+UwResult amw_init_compiled(AmwCompiled* compiled, void* data, size_t size);
+/*
+ * Initialize `compiled` with image in memory.
+ * The memory is not copied and must remain valid while `compiled` is in use.
+ */
+
+void amw_close_compiled(AmwCompiled* compiled);
+/*
+ * Unmap or release compiled document.
+ */
+
+AmwCompiledNode* amw_compiled_root(AmwCompiled* compiled);
+/*
+ * Return root node or nullptr if `compiled` is not initialized.
+ */
+
+char* amw_compiled_string(AmwCompiled* compiled, AmwCompiledNode* node, unsigned* length);
+/*
+ * Return pointer to string node data and write its length to `length` if not null.
+ * Return nullptr if node is not a string.
+ */
+
+AmwCompiledNode* amw_compiled_list_item(AmwCompiled* compiled, AmwCompiledNode* node, unsigned index);
+/*
+ * Return list item or nullptr if node is not a list or index is out of range.
+ */
+
+bool amw_compiled_map_item(AmwCompiled* compiled, AmwCompiledNode* node, unsigned index,
+                           AmwCompiledNode** key, AmwCompiledNode** value);
+/*
+ * Get map entry by index in original order.
+ * Return false if node is not a map or index is out of range.
+ */
+
+AmwCompiledNode* amw_compiled_map_get(AmwCompiled* compiled, AmwCompiledNode* node, char* key, unsigned length);
+/*
+ * Look up string `key` of `length` bytes in the map using binary search.
+ * Return value node or nullptr if not found.
+ */
+
+#define AMW_MAX_COMPILED_DEPTH  10000
+
+UwResult amw_compiled_to_value(AmwCompiled* compiled, AmwCompiledNode* node);
+/*
+ * Convert compiled node to value.
+ *
+ * Images may come from untrusted sources, so children must precede
+ * their containers in the image, as the compiler writes them.
+ * This rules out cycles. Nesting deeper than AMW_MAX_COMPILED_DEPTH
+ * and images that reference more nodes than they contain are rejected
+ * with AMW_BAD_COMPILED_DATA.
+ */
+
+/*
+ * Hashing
+ */
+
+uint64_t amw_value_hash(UwValuePtr value);
+/*
+ * Return canonical structural hash of the value.
+ *
+ * The hash depends on types of scalars and does not depend on the order of map entries.
+ * Values parsed from AMW and from equivalent JSON have the same hash.
+ */
+
+// incremental hashing of containers, same as amw_value_hash does
+#define AMW_HASH_LIST_START  AMW_COMPILED_LIST
+#define AMW_HASH_MAP_START   0
+
+uint64_t _amw_hash_list_item(uint64_t hash, uint64_t item_hash);
+uint64_t _amw_hash_list_end(uint64_t hash, unsigned length);
+uint64_t _amw_hash_map_entry(uint64_t hash, uint64_t key_hash, uint64_t value_hash);
+uint64_t _amw_hash_map_end(uint64_t hash, unsigned length);
+
+uint64_t _amw_hash_mix(uint64_t a, uint64_t b);
+uint64_t _amw_hash_string(UwValuePtr str);
+uint64_t _amw_hash_substring(UwValuePtr str, unsigned start_pos, unsigned end_pos);
+/*
+ * FNV-1a hash of code points.
+ */
+
+/*
+ * Files
+ */
+
+#define AMW_FNV_OFFSET_BASIS  0xcbf29ce484222325ULL
+#define AMW_FNV_PRIME         0x100000001b3ULL
+
+uint64_t amw_fnv1a(void* data, size_t size, uint64_t hash);
+/*
+ * Continue FNV-1a hash of data. Initial `hash` should be AMW_FNV_OFFSET_BASIS.
+ */
+
+UwResult amw_split_lines(char* data, size_t size);
+/*
+ * Split UTF-8 data into array of lines without line terminators.
+ * Zero bytes are kept in lines.
+ */
+
+UwResult amw_read_file_lines(char* path);
+/*
+ * Read file and return array of lines.
+ */
+
+typedef struct {
+    int      fd;
+    char*    data;      // incomplete line read so far
+    size_t   length;
+    size_t   capacity;
+    bool     eof;
+} AmwLineReader;
+
+UwResult amw_init_line_reader(AmwLineReader* reader, int fd, size_t buffer_size);
+/*
+ * Initialize reader of lines from file descriptor.
+ * If `buffer_size` is zero, use default. The buffer grows for longer lines.
+ */
+
+void amw_fini_line_reader(AmwLineReader* reader);
+
+UwResult amw_read_fd_lines(void* ctx, UwValuePtr lines);
+/*
+ * AmwReadLinesFunc for AmwLineReader pointed by `ctx`.
+ *
+ * To parse input as it is read, create parser for empty array and set
+ * `parser->read_lines` to this function and `parser->read_lines_ctx` to the reader.
+ */
+
+UwResult _amw_read_fd(int fd, char* path, size_t size, uint8_t** data);
+/*
+ * Read `size` bytes from file descriptor into memory allocated with `allocate`.
+ * The memory is one byte larger than `size` and the last byte is zero.
+ * `path` is used in error messages.
+ */
+
+UwResult _amw_create_string_utf8(char* data, size_t length);
+/*
+ * Create string from `length` bytes of UTF-8 data.
+ * Unlike uw_create_string, zero bytes do not terminate the data.
+ */
+
+UwResult _amw_io_error(char* what, char* path);
+/*
+ * Return AMW_IO_ERROR with description made of `what`, `path` and errno.
+ */
+
+/*
+ * Parse cache
+ */
+
+typedef struct _AmwCache AmwCache;  // see amw_cache.c
+
+AmwCache* amw_create_cache(unsigned capacity, bool verify_content);
+/*
+ * Create cache of parsed files that holds at most `capacity` documents.
+ * Least recently used documents are evicted.
+ *
+ * Files are identified by path, device, inode, size, and modification time.
+ * If `verify_content` is set, the content is read and its hash is compared
+ * with the hash of cached document on each lookup.
+ *
+ * Cache is not thread-safe. Cached documents share reference counts
+ * with returned clones, and reference counts are not atomic,
+ * so each thread should use its own cache.
+ */
+
+void amw_delete_cache(AmwCache** cache_ptr);
+
+UwResult amw_cache_parse(AmwCache* cache, char* path);
+/*
+ * Return cached document for the file, parsing it if necessary.
+ * Documents are shared, callers should not modify them.
+ * Errors are not cached.
+ */
+
+void amw_cache_stats(AmwCache* cache, uint64_t* hits, uint64_t* misses);
+
+/*
+ * Shared memory cache
+ */
+
+#define AMW_SHM_WAIT_MS  10000  // how long to wait for another process publishing the document
+
+UwResult amw_shm_load(char* path, AmwCompiled* compiled);
+/*
+ * Get compiled document for the file from shared memory segment
+ * named after its content hash and effective uid.
+ * Segments are shared only between processes of the same user,
+ * segments owned by other users or writable by them are not used.
+ *
+ * If the segment does not exist, claim its name, parse the file, compile it,
+ * and publish the result for other processes. Processes that find the name
+ * claimed wait for the owner up to AMW_SHM_WAIT_MS instead of parsing the file,
+ * and take over if the owner dies or fails.
+ *
+ * If shared memory is not available, the document is compiled into private memory.
+ *
+ * Close `compiled` with amw_close_compiled.
+ */
+
+/*
+ * Deferred blocks
+ */
+
+extern UwTypeId UwTypeId_AmwDeferred;
+/*
+ * Type ID for AmwDeferred value.
+ */
+
+typedef struct {
+    _UwValue  lines;               // block lines, either shared markup or a copy
+    unsigned  start_index;         // range of block lines
+    unsigned  end_index;
+    unsigned  line_number_offset;  // same as in AmwParser
+    unsigned  block_indent;
+    unsigned  blocklevel;
+    AmwBlockParserFunc parser_func;
+    AmwRegistry* registry;         // conversion specifiers of the parser
+    bool      resolved;
+    _UwValue  result;              // cached result of parsing
+} AmwDeferredData;
+
+#define _amw_deferred_data_ptr(value)  ((AmwDeferredData*) _uw_get_data_ptr((value), UwTypeId_AmwDeferred))
+
+UwResult amw_resolve(UwValuePtr value);
+/*
+ * If `value` is deferred, parse it on first call and cache the result.
+ *
+ * Return parsed value or error. If `value` is not deferred, return its clone.
+ */
+
+UwResult _amw_defer_block(AmwParser* parser, unsigned block_pos, AmwBlockParserFunc parser_func);
+/*
+ * Skip nested block starting from `block_pos` in the current line
+ * and return AmwDeferred value to parse it later with `parser_func`.
+ */
+
+UwResult _amw_parse_part(AmwParser* parser, bool is_map, bool last_part);
+/*
+ * Parse map entries or list items starting from the current line, which is
+ * the first line of the part, until end of markup.
+ *
+ * Markup must be an array of lines. Unless `last_part` is set, its last line
+ * is the first line of the next part and parsing stops when it is read.
+ *
+ * Return map or list.
+ */
+
+UwResult _amw_parse_key(AmwParser* parser, unsigned* key_start, unsigned* key_end,
+                        AmwBlockParserFunc* convspec, unsigned* value_pos);
+/*
+ * Find map key starting from the current block and write its position
+ * in the `current_line` without making a substring.
+ * Quoted keys are parsed as usual.
+ *
+ * Return null if key position is written, quoted key, or error.
+ */
+
+UwResult _amw_parse_map_value(AmwParser* parser, AmwBlockParserFunc convspec, unsigned value_pos);
+/*
+ * Parse map value starting from `value_pos` in the current line
+ * or from the next line, as a nested block.
+ */
+
+UwResult _amw_enter_value_block(AmwParser* parser, unsigned value_pos, unsigned* saved_block_indent);
+void _amw_leave_block(AmwParser* parser, unsigned saved_block_indent);
+/*
+ * Start nested block for map value starting from `value_pos` in the current line
+ * or from the next line. When the block is parsed, call _amw_leave_block.
+ */
+
 UwResult _amw_json_parser_func(AmwParser* parser);
 /*
  * JSON parser function for AMW :json: conversion specifier.
  */
 
-UwResult _amw_read_block_line(AmwParser* parser);
+typedef enum {
+    AMW_LINE_READ = 0,
+    AMW_END_OF_BLOCK,
+    AMW_READ_ERROR
+} AmwReadResult;
+
+AmwReadResult _amw_read_block_line(AmwParser* parser);
 /*
  * Read line belonging to a block, until indent is less than `block_indent`.
  * Skip comments with indentation less than `block_indent`.
  *
- * Return success if line is read, AMW_END_OF_BLOCK if there's no more lines
- * in the block, or any other error.
+ * Return AMW_LINE_READ if line is read, AMW_END_OF_BLOCK if there's no more lines
+ * in the block, or AMW_READ_ERROR. In the latter case error status is saved
+ * in the parser and should be obtained with _amw_read_error.
+ *
+ * Statuses are not created for lines and ends of blocks because
+ * this function is called for each line of markup.
+ */
+
+UwResult _amw_intern_key(AmwParser* parser, UwValuePtr key);
+/*
+ * Return shared instance of string `key` from parser's intern table
+ * or the key itself if the table is not set. The key is moved,
+ * on error it is destroyed and error status is returned.
+ */
+
+bool _amw_significant_line(UwValuePtr line, unsigned* indent);
+/*
+ * Return true if line is neither empty nor comment and write its indent.
  */
 
-bool _amw_end_of_block(UwValuePtr status);
+UwResult _amw_read_error(AmwParser* parser);
 /*
- * Return true if status is AMW_END_OF_BLOCK
+ * Return error status of failed _amw_read_block_line.
  */
 
+#define _amw_return_if_read_error(parser, read_result)  \
+    do {  \
+        if ((read_result) == AMW_READ_ERROR) {  \
+            return _amw_read_error(parser);  \
+        }  \
+    } while (false)
+
 UwResult _amw_read_block(AmwParser* parser);
 /*
  * Read lines starting from current_line till the end of block.
+ *
+ * In validation mode lines are skipped and null is returned.
  */
 
 unsigned _amw_get_start_position(AmwParser* parser);
@@ -136,6 +1135,7 @@ UwResult _amw_parser_error(AmwParser* parser, char* source_file_name, unsigned s
 bool _amw_find_closing_quote(UwValuePtr line, char32_t quote, unsigned start_pos, unsigned* end_pos);
 /*
  * Search for closing quotation mark in escaped line.
+ * Quotation marks preceded by odd number of backslashes are escaped.
  * If found, write its position to `end_pos` and return true;
  */
 
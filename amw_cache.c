@@ -0,0 +1,296 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <amw.h>
+
+#define NO_ENTRY  UINT_MAX
+
+typedef struct {
+    char*     path;
+    unsigned  path_size;
+    uint64_t  path_hash;
+    dev_t     dev;
+    ino_t     ino;
+    off_t     size;
+    struct timespec mtime;
+    uint64_t  content_hash;
+    unsigned  next_in_bucket;
+    unsigned  more_recent;   // LRU list links
+    unsigned  less_recent;
+    _UwValue  doc;
+} CacheEntry;
+
+struct _AmwCache {
+    CacheEntry* entries;
+    unsigned  capacity;
+    unsigned  num_entries;
+    unsigned* buckets;       // heads of hash chains, indexes in entries
+    unsigned  num_buckets;   // power of two
+    unsigned  most_recent;   // ends of LRU list
+    unsigned  least_recent;
+    bool      verify_content;
+    uint64_t  hits;
+    uint64_t  misses;
+};
+
+static void release_entry(CacheEntry* entry)
+{
+    if (entry->path) {
+        release((void**) &entry->path, entry->path_size);
+    }
+    uw_destroy(&entry->doc);
+}
+
+AmwCache* amw_create_cache(unsigned capacity, bool verify_content)
+{
+    if (capacity == 0) {
+        capacity = 1;
+    }
+    if (capacity > UINT_MAX / 4) {
+        return nullptr;
+    }
+    unsigned num_buckets = 1;
+    while (num_buckets < capacity * 2) {
+        num_buckets <<= 1;
+    }
+    AmwCache* cache = allocate(sizeof(AmwCache), true);
+    if (!cache) {
+        return nullptr;
+    }
+    cache->entries = allocate(capacity * sizeof(CacheEntry), true);
+    if (!cache->entries) {
+        release((void**) &cache, sizeof(AmwCache));
+        return nullptr;
+    }
+    cache->buckets = allocate(num_buckets * sizeof(unsigned), false);
+    if (!cache->buckets) {
+        release((void**) &cache->entries, capacity * sizeof(CacheEntry));
+        release((void**) &cache, sizeof(AmwCache));
+        return nullptr;
+    }
+    for (unsigned i = 0; i < num_buckets; i++) {
+        cache->buckets[i] = NO_ENTRY;
+    }
+    cache->capacity = capacity;
+    cache->num_buckets = num_buckets;
+    cache->most_recent = NO_ENTRY;
+    cache->least_recent = NO_ENTRY;
+    cache->verify_content = verify_content;
+    return cache;
+}
+
+void amw_delete_cache(AmwCache** cache_ptr)
+{
+    AmwCache* cache = *cache_ptr;
+    if (!cache) {
+        return;
+    }
+    *cache_ptr = nullptr;
+    for (unsigned i = 0; i < cache->num_entries; i++) {
+        release_entry(&cache->entries[i]);
+    }
+    release((void**) &cache->entries, cache->capacity * sizeof(CacheEntry));
+    release((void**) &cache->buckets, cache->num_buckets * sizeof(unsigned));
+    release((void**) &cache, sizeof(AmwCache));
+}
+
+void amw_cache_stats(AmwCache* cache, uint64_t* hits, uint64_t* misses)
+{
+    *hits = cache->hits;
+    *misses = cache->misses;
+}
+
+static unsigned* bucket_of(AmwCache* cache, uint64_t path_hash)
+{
+    return &cache->buckets[path_hash & (cache->num_buckets - 1)];
+}
+
+static unsigned find_entry(AmwCache* cache, char* path, uint64_t path_hash)
+/*
+ * Return index of entry for `path` or NO_ENTRY.
+ */
+{
+    for (unsigned i = *bucket_of(cache, path_hash); i != NO_ENTRY; i = cache->entries[i].next_in_bucket) {
+        CacheEntry* entry = &cache->entries[i];
+        if (entry->path_hash == path_hash && strcmp(entry->path, path) == 0) {
+            return i;
+        }
+    }
+    return NO_ENTRY;
+}
+
+static void remove_from_bucket(AmwCache* cache, unsigned index)
+{
+    unsigned* link = bucket_of(cache, cache->entries[index].path_hash);
+    while (*link != index) {
+        link = &cache->entries[*link].next_in_bucket;
+    }
+    *link = cache->entries[index].next_in_bucket;
+}
+
+static void unlink_lru(AmwCache* cache, unsigned index)
+{
+    CacheEntry* entry = &cache->entries[index];
+    if (entry->more_recent == NO_ENTRY) {
+        cache->most_recent = entry->less_recent;
+    } else {
+        cache->entries[entry->more_recent].less_recent = entry->less_recent;
+    }
+    if (entry->less_recent == NO_ENTRY) {
+        cache->least_recent = entry->more_recent;
+    } else {
+        cache->entries[entry->less_recent].more_recent = entry->more_recent;
+    }
+}
+
+static void make_most_recent(AmwCache* cache, unsigned index)
+/*
+ * Put unlinked entry at the head of LRU list.
+ */
+{
+    CacheEntry* entry = &cache->entries[index];
+    entry->more_recent = NO_ENTRY;
+    entry->less_recent = cache->most_recent;
+    if (cache->most_recent == NO_ENTRY) {
+        cache->least_recent = index;
+    } else {
+        cache->entries[cache->most_recent].more_recent = index;
+    }
+    cache->most_recent = index;
+}
+
+static bool same_file(CacheEntry* entry, struct stat* st)
+{
+    return entry->dev == st->st_dev
+        && entry->ino == st->st_ino
+        && entry->size == st->st_size
+        && entry->mtime.tv_sec == st->st_mtim.tv_sec
+        && entry->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static bool lookup(AmwCache* cache, char* path, uint64_t path_hash, struct stat* st, uint64_t content_hash,
+                   UwValuePtr doc)
+/*
+ * If file is not changed, write clone of cached document to `doc` and return true.
+ * Count hit or miss.
+ */
+{
+    unsigned index = find_entry(cache, path, path_hash);
+    if (index != NO_ENTRY) {
+        CacheEntry* entry = &cache->entries[index];
+        if (same_file(entry, st)
+            && (!cache->verify_content || entry->content_hash == content_hash)) {
+
+            unlink_lru(cache, index);
+            make_most_recent(cache, index);
+            cache->hits++;
+            *doc = uw_clone(&entry->doc);
+            return true;
+        }
+    }
+    cache->misses++;
+    return false;
+}
+
+static UwResult store(AmwCache* cache, char* path, uint64_t path_hash, struct stat* st,
+                      uint64_t content_hash, UwValuePtr doc)
+{
+    unsigned path_size = strlen(path) + 1;
+    char* path_copy = allocate(path_size, false);
+    if (!path_copy) {
+        return UwOOM();
+    }
+    memcpy(path_copy, path, path_size);
+
+    unsigned index = find_entry(cache, path, path_hash);
+    if (index == NO_ENTRY) {
+        if (cache->num_entries < cache->capacity) {
+            index = cache->num_entries++;
+        } else {
+            // evict least recently used
+            index = cache->least_recent;
+            remove_from_bucket(cache, index);
+            unlink_lru(cache, index);
+            release_entry(&cache->entries[index]);
+        }
+        unsigned* bucket = bucket_of(cache, path_hash);
+        cache->entries[index].next_in_bucket = *bucket;
+        *bucket = index;
+    } else {
+        unlink_lru(cache, index);
+        release_entry(&cache->entries[index]);
+    }
+    make_most_recent(cache, index);
+
+    CacheEntry* entry = &cache->entries[index];
+    entry->path = path_copy;
+    entry->path_size = path_size;
+    entry->path_hash = path_hash;
+    entry->dev = st->st_dev;
+    entry->ino = st->st_ino;
+    entry->size = st->st_size;
+    entry->mtime = st->st_mtim;
+    entry->content_hash = content_hash;
+    entry->doc = uw_clone(doc);
+    return UwOK();
+}
+
+UwResult amw_cache_parse(AmwCache* cache, char* path)
+{
+    uint64_t path_hash = amw_fnv1a(path, strlen(path), AMW_FNV_OFFSET_BASIS);
+
+    if (!cache->verify_content) {
+        // fast path: stat only
+        struct stat st;
+        if (stat(path, &st) == -1) {
+            return _amw_io_error("Cannot stat", path);
+        }
+        UwValue doc = UwNull();
+        if (lookup(cache, path, path_hash, &st, 0, &doc)) {
+            return uw_move(&doc);
+        }
+    }
+
+    // read file; identity is taken from the opened file to avoid races with writers
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return _amw_io_error("Cannot open", path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        UwValue status = _amw_io_error("Cannot stat", path);
+        close(fd);
+        return uw_move(&status);
+    }
+    uint8_t* data;
+    UwValue status = _amw_read_fd(fd, path, st.st_size, &data);
+    close(fd);
+    uw_return_if_error(&status);
+
+    uint64_t content_hash = 0;
+    if (cache->verify_content) {
+        content_hash = amw_fnv1a(data, st.st_size, AMW_FNV_OFFSET_BASIS);
+
+        UwValue doc = UwNull();
+        if (lookup(cache, path, path_hash, &st, content_hash, &doc)) {
+            release((void**) &data, st.st_size + 1);
+            return uw_move(&doc);
+        }
+    }
+
+    UwValue lines = amw_split_lines((char*) data, st.st_size);
+    release((void**) &data, st.st_size + 1);
+    uw_return_if_error(&lines);
+
+    UwValue doc = amw_parse(&lines);
+    uw_return_if_error(&doc);
+
+    UwValue store_status = store(cache, path, path_hash, &st, content_hash, &doc);
+    uw_return_if_error(&store_status);
+
+    return uw_move(&doc);
+}
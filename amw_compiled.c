@@ -0,0 +1,740 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <amw.h>
+
+/*
+ * Compiler
+ */
+
+typedef struct {
+    uint8_t*  data;
+    unsigned  size;
+    unsigned  capacity;
+} Buffer;
+
+typedef struct {
+    Buffer    body;     // header, nodes and tables
+    Buffer    strings;  // string pool
+    _UwValue  string_offsets;  // map of strings to offsets in the pool, to store each string once
+} Compiler;
+
+typedef struct {
+    AmwCompiledNode* key;
+    char*     str;      // key string
+    uint32_t  index;    // entry index
+} SortKey;
+
+#define INITIAL_BUFFER_CAPACITY  4096
+
+static void release_buffer(Buffer* buf)
+{
+    if (buf->data) {
+        release((void**) &buf->data, buf->capacity);
+    }
+}
+
+static void release_compiler(Compiler* compiler)
+{
+    release_buffer(&compiler->body);
+    release_buffer(&compiler->strings);
+    uw_destroy(&compiler->string_offsets);
+}
+
+static bool reserve(Buffer* buf, unsigned size, unsigned alignment, unsigned* offset)
+/*
+ * Reserve `size` zeroed bytes in the buffer at `alignment` boundary.
+ * Write offset of reserved space to `offset`.
+ * Return false if out of memory or image grows beyond 4GB.
+ */
+{
+    unsigned start = (buf->size + alignment - 1) & ~(alignment - 1);
+    if (start < buf->size || start + size < start) {
+        return false;
+    }
+    unsigned new_size = start + size;
+    if (new_size > buf->capacity) {
+        unsigned new_capacity = buf->capacity? buf->capacity : INITIAL_BUFFER_CAPACITY;
+        while (new_capacity < new_size) {
+            if (new_capacity > UINT_MAX / 2) {
+                return false;
+            }
+            new_capacity *= 2;
+        }
+        uint8_t* new_data = allocate(new_capacity, true);
+        if (!new_data) {
+            return false;
+        }
+        if (buf->data) {
+            memcpy(new_data, buf->data, buf->size);
+            release((void**) &buf->data, buf->capacity);
+        }
+        buf->data = new_data;
+        buf->capacity = new_capacity;
+    }
+    memset(buf->data + buf->size, 0, new_size - buf->size);
+    buf->size = new_size;
+    *offset = start;
+    return true;
+}
+
+static UwResult compile_string(Compiler* compiler, UwValuePtr str, AmwCompiledNode* node)
+{
+    node->type = AMW_COMPILED_STRING;
+    node->length = uw_strlen_in_utf8(str);
+
+    UwValue known_offset = uw_map_get(&compiler->string_offsets, str);
+    if (uw_is_unsigned(&known_offset)) {
+        node->offset = known_offset.unsigned_value;
+        return UwOK();
+    }
+    unsigned offset;
+    if (!reserve(&compiler->strings, node->length + 1, 1, &offset)) {
+        return UwOOM();
+    }
+    uw_substr_to_utf8_buf(str, 0, uw_strlen(str), (char*) compiler->strings.data + offset);
+    node->offset = offset;
+
+    UwValue offset_value = UwUnsigned(offset);
+    return uw_map_update(&compiler->string_offsets, str, &offset_value);
+}
+
+static UwResult compile_node(Compiler* compiler, UwValuePtr value, uint32_t* node_offset);
+
+static UwResult compile_list(Compiler* compiler, UwValuePtr list, AmwCompiledNode* node)
+{
+    unsigned length = uw_array_length(list);
+
+    // reserve table first, items are compiled after it
+    unsigned table;
+    if (!reserve(&compiler->body, length * sizeof(uint32_t), sizeof(uint32_t), &table)) {
+        return UwOOM();
+    }
+    for (unsigned i = 0; i < length; i++) {{
+        UwValue item = uw_array_item(list, i);
+        uint32_t item_offset;
+        UwValue status = compile_node(compiler, &item, &item_offset);
+        uw_return_if_error(&status);
+
+        // buffer may be reallocated, get table address every time
+        ((uint32_t*) (compiler->body.data + table))[i] = item_offset;
+    }}
+
+    node->type = AMW_COMPILED_LIST;
+    node->length = length;
+    node->offset = table;
+    return UwOK();
+}
+
+static int compare_keys(const AmwCompiledNode* a, char* a_str, const AmwCompiledNode* b, char* b_str)
+/*
+ * Keys are ordered by type first. Strings are compared bytewise,
+ * other keys are compared by their binary representation.
+ */
+{
+    if (a->type != b->type) {
+        return (a->type < b->type)? -1 : 1;
+    }
+    if (a->type == AMW_COMPILED_STRING) {
+        unsigned len = (a->length < b->length)? a->length : b->length;
+        int result = memcmp(a_str, b_str, len);
+        if (result) {
+            return result;
+        }
+        if (a->length == b->length) {
+            return 0;
+        }
+        return (a->length < b->length)? -1 : 1;
+    }
+    return memcmp(&a->gmt_offset, &b->gmt_offset, sizeof(AmwCompiledNode) - offsetof(AmwCompiledNode, gmt_offset));
+}
+
+static int compare_sort_keys(const void* a, const void* b)
+{
+    const SortKey* ka = a;
+    const SortKey* kb = b;
+    return compare_keys(ka->key, ka->str, kb->key, kb->str);
+}
+
+static UwResult compile_map(Compiler* compiler, UwValuePtr map, AmwCompiledNode* node)
+{
+    unsigned length = uw_map_length(map);
+
+    // reserve table first, entries are compiled after it
+    unsigned table;
+    if (!reserve(&compiler->body, length * 3 * sizeof(uint32_t), sizeof(uint32_t), &table)) {
+        return UwOOM();
+    }
+    for (unsigned i = 0; i < length; i++) {{
+        UwValue key = UwNull();
+        UwValue value = UwNull();
+        uw_map_item(map, i, &key, &value);
+
+        uint32_t key_offset;
+        UwValue key_status = compile_node(compiler, &key, &key_offset);
+        uw_return_if_error(&key_status);
+
+        uint32_t value_offset;
+        UwValue value_status = compile_node(compiler, &value, &value_offset);
+        uw_return_if_error(&value_status);
+
+        // buffer may be reallocated, get table address every time
+        uint32_t* entries = (uint32_t*) (compiler->body.data + table);
+        entries[i * 2] = key_offset;
+        entries[i * 2 + 1] = value_offset;
+    }}
+    uint32_t* entries = (uint32_t*) (compiler->body.data + table);
+
+    // make index of entries sorted by keys;
+    // the buffers are not growing at this point so pointers remain valid
+
+    SortKey* sort_keys = allocate((length + 1) * sizeof(SortKey), false);
+    if (!sort_keys) {
+        return UwOOM();
+    }
+    for (unsigned i = 0; i < length; i++) {
+        AmwCompiledNode* key = (AmwCompiledNode*) (compiler->body.data + entries[i * 2]);
+        sort_keys[i].key = key;
+        sort_keys[i].str = (key->type == AMW_COMPILED_STRING)? (char*) compiler->strings.data + key->offset : nullptr;
+        sort_keys[i].index = i;
+    }
+    qsort(sort_keys, length, sizeof(SortKey), compare_sort_keys);
+
+    uint32_t* index = entries + length * 2;
+    for (unsigned i = 0; i < length; i++) {
+        index[i] = sort_keys[i].index;
+    }
+    release((void**) &sort_keys, (length + 1) * sizeof(SortKey));
+
+    node->type = AMW_COMPILED_MAP;
+    node->length = length;
+    node->offset = table;
+    return UwOK();
+}
+
+static UwResult compile_node(Compiler* compiler, UwValuePtr value, uint32_t* node_offset)
+/*
+ * Compile value and write offset of its node to `node_offset`.
+ */
+{
+    AmwCompiledNode node = {};
+
+    if (uw_is_null(value)) {
+        node.type = AMW_COMPILED_NULL;
+
+    } else if (uw_is_bool(value)) {
+        node.type = AMW_COMPILED_BOOL;
+        node.bool_value = value->bool_value;
+
+    } else if (uw_is_signed(value)) {
+        node.type = AMW_COMPILED_SIGNED;
+        node.signed_value = value->signed_value;
+
+    } else if (uw_is_unsigned(value)) {
+        node.type = AMW_COMPILED_UNSIGNED;
+        node.unsigned_value = value->unsigned_value;
+
+    } else if (uw_is_float(value)) {
+        node.type = AMW_COMPILED_FLOAT;
+        node.float_value = value->float_value;
+
+    } else if (uw_is_string(value)) {
+        UwValue status = compile_string(compiler, value, &node);
+        uw_return_if_error(&status);
+
+    } else if (uw_is_datetime(value)) {
+        node.type = AMW_COMPILED_DATETIME;
+        node.datetime = ((uint64_t) value->year << 40) | ((uint64_t) value->month << 32)
+                      | ((uint64_t) value->day << 24) | ((uint64_t) value->hour << 16)
+                      | ((uint64_t) value->minute << 8) | value->second;
+        node.length = value->nanosecond;
+        node.gmt_offset = value->gmt_offset;
+
+    } else if (uw_is_timestamp(value)) {
+        node.type = AMW_COMPILED_TIMESTAMP;
+        node.seconds = value->ts_seconds;
+        node.length = value->ts_nanoseconds;
+
+    } else if (uw_is_array(value)) {
+        UwValue status = compile_list(compiler, value, &node);
+        uw_return_if_error(&status);
+
+    } else if (uw_is_map(value)) {
+        UwValue status = compile_map(compiler, value, &node);
+        uw_return_if_error(&status);
+
+    } else if (value->type_id == UwTypeId_AmwDeferred) {
+        UwValue resolved = amw_resolve(value);
+        uw_return_if_error(&resolved);
+        return compile_node(compiler, &resolved, node_offset);
+
+    } else {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+
+    unsigned offset;
+    if (!reserve(&compiler->body, sizeof(AmwCompiledNode), _Alignof(AmwCompiledNode), &offset)) {
+        return UwOOM();
+    }
+    memcpy(compiler->body.data + offset, &node, sizeof(AmwCompiledNode));
+    *node_offset = offset;
+    return UwOK();
+}
+
+UwResult _amw_compile_to_buffer(UwValuePtr value, uint8_t** data, size_t* size)
+{
+    [[ gnu::cleanup(release_compiler) ]] Compiler compiler = {};
+    compiler.string_offsets = UwMap();
+    uw_return_if_error(&compiler.string_offsets);
+
+    unsigned header_offset;
+    if (!reserve(&compiler.body, sizeof(AmwCompiledHeader), _Alignof(AmwCompiledNode), &header_offset)) {
+        return UwOOM();
+    }
+    uint32_t root;
+    UwValue status = compile_node(&compiler, value, &root);
+    uw_return_if_error(&status);
+
+    // append string pool
+    unsigned strings;
+    if (!reserve(&compiler.body, compiler.strings.size, _Alignof(AmwCompiledNode), &strings)) {
+        return UwOOM();
+    }
+    if (compiler.strings.size) {
+        memcpy(compiler.body.data + strings, compiler.strings.data, compiler.strings.size);
+    }
+
+    AmwCompiledHeader* header = (AmwCompiledHeader*) compiler.body.data;
+    memcpy(header->magic, AMW_COMPILED_MAGIC, sizeof(header->magic));
+    header->version = AMW_COMPILED_VERSION;
+    header->size = compiler.body.size;
+    header->root = root;
+    header->strings = strings;
+
+    // shrink buffer to the size of image
+    uint8_t* image = allocate(compiler.body.size, false);
+    if (!image) {
+        return UwOOM();
+    }
+    memcpy(image, compiler.body.data, compiler.body.size);
+    *data = image;
+    *size = compiler.body.size;
+    return UwOK();
+}
+
+static UwResult sync_parent_dir(char* path)
+/*
+ * Sync directory containing `path` to make rename durable.
+ */
+{
+    char dir[strlen(path) + 2];
+    char* slash = strrchr(path, '/');
+    if (!slash) {
+        strcpy(dir, ".");
+    } else if (slash == path) {
+        strcpy(dir, "/");
+    } else {
+        memcpy(dir, path, slash - path);
+        dir[slash - path] = 0;
+    }
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd == -1) {
+        return _amw_io_error("Cannot open", dir);
+    }
+    UwValue status = UwOK();
+    if (fsync(fd) == -1) {
+        status = _amw_io_error("Cannot sync", dir);
+    }
+    close(fd);
+    return uw_move(&status);
+}
+
+static UwResult write_file(char* path, uint8_t* data, size_t size)
+/*
+ * Write data to temporary file and rename it to `path`.
+ */
+{
+    // unique name in the same directory, so rename stays within one file system
+    char tmp_path[strlen(path) + 16];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp.XXXXXX", path);
+
+    int fd = mkstemp(tmp_path);
+    if (fd == -1) {
+        return _amw_io_error("Cannot create", tmp_path);
+    }
+    // mkstemp creates the file readable by owner only
+    if (fchmod(fd, 0644) == -1) {
+        UwValue status = _amw_io_error("Cannot set mode of", tmp_path);
+        close(fd);
+        unlink(tmp_path);
+        return uw_move(&status);
+    }
+    while (size) {
+        ssize_t n = write(fd, data, size);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            UwValue status = _amw_io_error("Cannot write", tmp_path);
+            close(fd);
+            unlink(tmp_path);
+            return uw_move(&status);
+        }
+        data += n;
+        size -= n;
+    }
+    // make sure the data is on disk before the file gets its final name
+    if (fsync(fd) == -1) {
+        UwValue status = _amw_io_error("Cannot sync", tmp_path);
+        close(fd);
+        unlink(tmp_path);
+        return uw_move(&status);
+    }
+    if (close(fd) == -1) {
+        UwValue status = _amw_io_error("Cannot write", tmp_path);
+        unlink(tmp_path);
+        return uw_move(&status);
+    }
+    if (rename(tmp_path, path) == -1) {
+        UwValue status = _amw_io_error("Cannot rename to", path);
+        unlink(tmp_path);
+        return uw_move(&status);
+    }
+    return sync_parent_dir(path);
+}
+
+UwResult amw_compile_value(UwValuePtr value, char* out_path)
+{
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    UwValue status = _amw_compile_to_buffer(value, &data, &size);
+    uw_return_if_error(&status);
+
+    UwValue result = write_file(out_path, data, size);
+    release((void**) &data, size);
+    return uw_move(&result);
+}
+
+UwResult amw_compile(UwValuePtr markup, char* out_path)
+{
+    UwValue value = amw_parse(markup);
+    uw_return_if_error(&value);
+
+    return amw_compile_value(&value, out_path);
+}
+
+/*
+ * Reader
+ */
+
+UwResult amw_init_compiled(AmwCompiled* compiled, void* data, size_t size)
+{
+    compiled->data = data;
+    compiled->size = size;
+    compiled->mapping = nullptr;
+    compiled->mapping_size = 0;
+    compiled->allocated = false;
+
+    AmwCompiledHeader* header = data;
+    if (size < sizeof(AmwCompiledHeader)
+        || memcmp(header->magic, AMW_COMPILED_MAGIC, sizeof(header->magic)) != 0
+        || header->version != AMW_COMPILED_VERSION
+        || header->size != size
+        || header->root > size - sizeof(AmwCompiledNode)
+        || header->strings > size) {
+
+        compiled->data = nullptr;
+        compiled->size = 0;
+        return UwError(AMW_BAD_COMPILED_DATA);
+    }
+    return UwOK();
+}
+
+UwResult amw_open_compiled(char* path, AmwCompiled* compiled)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return _amw_io_error("Cannot open", path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        UwValue status = _amw_io_error("Cannot stat", path);
+        close(fd);
+        return uw_move(&status);
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return UwError(AMW_BAD_COMPILED_DATA);
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return _amw_io_error("Cannot map", path);
+    }
+    UwValue status = amw_init_compiled(compiled, data, st.st_size);
+    if (uw_error(&status)) {
+        munmap(data, st.st_size);
+        return uw_move(&status);
+    }
+    compiled->mapping = data;
+    compiled->mapping_size = st.st_size;
+    return UwOK();
+}
+
+void amw_close_compiled(AmwCompiled* compiled)
+{
+    if (compiled->mapping) {
+        munmap(compiled->mapping, compiled->mapping_size);
+    } else if (compiled->allocated && compiled->data) {
+        release((void**) &compiled->data, compiled->size);
+    }
+    compiled->data = nullptr;
+    compiled->size = 0;
+    compiled->mapping = nullptr;
+    compiled->mapping_size = 0;
+    compiled->allocated = false;
+}
+
+static inline AmwCompiledHeader* get_header(AmwCompiled* compiled)
+{
+    return (AmwCompiledHeader*) compiled->data;
+}
+
+static AmwCompiledNode* node_at(AmwCompiled* compiled, uint64_t offset)
+/*
+ * Return node at `offset` or nullptr if offset is out of range.
+ */
+{
+    if (offset > compiled->size - sizeof(AmwCompiledNode) || (offset % _Alignof(AmwCompiledNode))) {
+        return nullptr;
+    }
+    return (AmwCompiledNode*) (compiled->data + offset);
+}
+
+static uint32_t* get_table(AmwCompiled* compiled, AmwCompiledNode* node, unsigned entry_size)
+/*
+ * Return table of the container or nullptr if it's out of range.
+ */
+{
+    uint64_t table_size = (uint64_t) node->length * entry_size * sizeof(uint32_t);
+    if (node->offset > compiled->size || table_size > compiled->size - node->offset) {
+        return nullptr;
+    }
+    return (uint32_t*) (compiled->data + node->offset);
+}
+
+AmwCompiledNode* amw_compiled_root(AmwCompiled* compiled)
+{
+    if (!compiled->data) {
+        return nullptr;
+    }
+    return node_at(compiled, get_header(compiled)->root);
+}
+
+char* amw_compiled_string(AmwCompiled* compiled, AmwCompiledNode* node, unsigned* length)
+{
+    if (node->type != AMW_COMPILED_STRING) {
+        return nullptr;
+    }
+    uint64_t start = get_header(compiled)->strings + node->offset;
+    if (start + node->length >= compiled->size) {
+        return nullptr;
+    }
+    if (length) {
+        *length = node->length;
+    }
+    return (char*) compiled->data + start;
+}
+
+AmwCompiledNode* amw_compiled_list_item(AmwCompiled* compiled, AmwCompiledNode* node, unsigned index)
+{
+    if (node->type != AMW_COMPILED_LIST || index >= node->length) {
+        return nullptr;
+    }
+    uint32_t* table = get_table(compiled, node, 1);
+    if (!table) {
+        return nullptr;
+    }
+    return node_at(compiled, table[index]);
+}
+
+bool amw_compiled_map_item(AmwCompiled* compiled, AmwCompiledNode* node, unsigned index,
+                           AmwCompiledNode** key, AmwCompiledNode** value)
+{
+    if (node->type != AMW_COMPILED_MAP || index >= node->length) {
+        return false;
+    }
+    uint32_t* table = get_table(compiled, node, 3);
+    if (!table) {
+        return false;
+    }
+    *key = node_at(compiled, table[index * 2]);
+    *value = node_at(compiled, table[index * 2 + 1]);
+    return *key && *value;
+}
+
+AmwCompiledNode* amw_compiled_map_get(AmwCompiled* compiled, AmwCompiledNode* node, char* key, unsigned length)
+{
+    if (node->type != AMW_COMPILED_MAP) {
+        return nullptr;
+    }
+    uint32_t* table = get_table(compiled, node, 3);
+    if (!table) {
+        return nullptr;
+    }
+    uint32_t* index = table + node->length * 2;
+
+    AmwCompiledNode key_node = {
+        .type = AMW_COMPILED_STRING,
+        .length = length
+    };
+    unsigned lo = 0;
+    unsigned hi = node->length;
+    while (lo < hi) {
+        unsigned mid = lo + (hi - lo) / 2;
+        unsigned entry = index[mid];
+        if (entry >= node->length) {
+            return nullptr;
+        }
+        AmwCompiledNode* k = node_at(compiled, table[entry * 2]);
+        if (!k) {
+            return nullptr;
+        }
+        char* k_str = amw_compiled_string(compiled, k, nullptr);
+        if (k->type == AMW_COMPILED_STRING && !k_str) {
+            return nullptr;
+        }
+        int cmp = compare_keys(k, k_str, &key_node, key);
+        if (cmp == 0) {
+            return node_at(compiled, table[entry * 2 + 1]);
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return nullptr;
+}
+
+typedef struct {
+    AmwCompiled* compiled;
+    uint64_t  nodes_left;  // budget of nodes, shared subtrees must not multiply work
+} Decoder;
+
+static UwResult decode_node(Decoder* decoder, AmwCompiledNode* node, uint64_t parent_offset, unsigned depth)
+/*
+ * Convert node to value.
+ *
+ * Children are compiled before containers, so valid images have child offsets
+ * less than `parent_offset`. This check makes cycles impossible.
+ */
+{
+    AmwCompiled* compiled = decoder->compiled;
+
+    if (!node || depth > AMW_MAX_COMPILED_DEPTH || decoder->nodes_left == 0) {
+        return UwError(AMW_BAD_COMPILED_DATA);
+    }
+    uint64_t offset = (uint8_t*) node - compiled->data;
+    if (offset >= parent_offset) {
+        return UwError(AMW_BAD_COMPILED_DATA);
+    }
+    decoder->nodes_left--;
+
+    switch (node->type) {
+        case AMW_COMPILED_NULL:
+            return UwNull();
+
+        case AMW_COMPILED_BOOL:
+            return UwBool(node->bool_value);
+
+        case AMW_COMPILED_SIGNED:
+            return UwSigned(node->signed_value);
+
+        case AMW_COMPILED_UNSIGNED:
+            return UwUnsigned(node->unsigned_value);
+
+        case AMW_COMPILED_FLOAT:
+            return UwFloat(node->float_value);
+
+        case AMW_COMPILED_STRING: {
+            unsigned length;
+            char* str = amw_compiled_string(compiled, node, &length);
+            if (!str) {
+                return UwError(AMW_BAD_COMPILED_DATA);
+            }
+            return _amw_create_string_utf8(str, length);
+        }
+
+        case AMW_COMPILED_DATETIME: {
+            UWDECL_DateTime(result);
+            result.year       = node->datetime >> 40;
+            result.month      = node->datetime >> 32;
+            result.day        = node->datetime >> 24;
+            result.hour       = node->datetime >> 16;
+            result.minute     = node->datetime >> 8;
+            result.second     = node->datetime;
+            result.nanosecond = node->length;
+            result.gmt_offset = node->gmt_offset;
+            return uw_move(&result);
+        }
+
+        case AMW_COMPILED_TIMESTAMP: {
+            UWDECL_Timestamp(result);
+            result.ts_seconds = node->seconds;
+            result.ts_nanoseconds = node->length;
+            return uw_move(&result);
+        }
+
+        case AMW_COMPILED_LIST: {
+            UwValue result = UwArray();
+            uw_return_if_error(&result);
+            for (unsigned i = 0; i < node->length; i++) {{
+                UwValue item = decode_node(decoder, amw_compiled_list_item(compiled, node, i), offset, depth + 1);
+                uw_return_if_error(&item);
+                uw_expect_ok( uw_array_append(&result, &item) );
+            }}
+            return uw_move(&result);
+        }
+
+        case AMW_COMPILED_MAP: {
+            UwValue result = UwMap();
+            uw_return_if_error(&result);
+            for (unsigned i = 0; i < node->length; i++) {{
+                AmwCompiledNode* key_node;
+                AmwCompiledNode* value_node;
+                if (!amw_compiled_map_item(compiled, node, i, &key_node, &value_node)) {
+                    return UwError(AMW_BAD_COMPILED_DATA);
+                }
+                UwValue key = decode_node(decoder, key_node, offset, depth + 1);
+                uw_return_if_error(&key);
+                UwValue value = decode_node(decoder, value_node, offset, depth + 1);
+                uw_return_if_error(&value);
+                uw_expect_ok( uw_map_update(&result, &key, &value) );
+            }}
+            return uw_move(&result);
+        }
+
+        default:
+            return UwError(AMW_BAD_COMPILED_DATA);
+    }
+}
+
+UwResult amw_compiled_to_value(AmwCompiled* compiled, AmwCompiledNode* node)
+{
+    if (!compiled->data) {
+        return UwError(AMW_BAD_COMPILED_DATA);
+    }
+    Decoder decoder = {
+        .compiled = compiled,
+        .nodes_left = compiled->size / sizeof(AmwCompiledNode)
+    };
+    // the node itself may be any node of the image
+    return decode_node(&decoder, node, compiled->size, 0);
+}
@@ -0,0 +1,872 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <amw.h>
+
+#define NO_PATCH  UINT_MAX
+
+// column of the first line of a block is measured as usual
+#define LINE_INDENT  UINT_MAX
+
+// initial capacity of patch text
+#define PATCH_CAPACITY  256
+
+/*
+ * Source
+ */
+
+static size_t char_offset(AmwCst* cst, unsigned line_index, unsigned char_pos)
+/*
+ * Convert position of character in the line to byte offset in the source.
+ */
+{
+    size_t pos = cst->line_starts[line_index];
+    size_t end = cst->line_starts[line_index + 1];
+    for (unsigned n = 0; pos < end; pos++) {
+        if ((cst->data[pos] & 0xC0) != 0x80) {
+            if (n == char_pos) {
+                break;
+            }
+            n++;
+        }
+    }
+    return pos;
+}
+
+static bool content_line(AmwCst* cst, unsigned line_index, unsigned indent)
+/*
+ * Return true if line belongs to the value of entry with `indent`.
+ * Blank lines and comments not indented deeper belong to the surrounding block.
+ */
+{
+    UwValue line = uw_array_item(&cst->lines, line_index);
+    unsigned pos = uw_string_skip_spaces(&line, 0);
+    if (pos >= uw_strlen(&line)) {
+        return false;
+    }
+    return pos > indent || uw_char_at(&line, pos) != AMW_COMMENT;
+}
+
+static UwResult split_source(AmwCst* cst)
+{
+    unsigned num_lines = 0;
+    for (uint8_t* p = cst->data, *end = cst->data + cst->size; p < end; num_lines++) {
+        uint8_t* eol = memchr(p, '\n', end - p);
+        p = eol? eol + 1 : end;
+    }
+    cst->line_starts = allocate((num_lines + 1) * sizeof(size_t), false);
+    if (!cst->line_starts) {
+        return UwOOM();
+    }
+    cst->num_lines = num_lines;
+
+    size_t pos = 0;
+    for (unsigned i = 0; i < num_lines; i++) {
+        cst->line_starts[i] = pos;
+        uint8_t* eol = memchr(cst->data + pos, '\n', cst->size - pos);
+        pos = eol? (size_t) (eol - cst->data) + 1 : cst->size;
+    }
+    cst->line_starts[num_lines] = cst->size;
+
+    cst->lines = amw_split_lines((char*) cst->data, cst->size);
+    uw_return_if_error(&cst->lines);
+
+    if (uw_array_length(&cst->lines) != num_lines) {
+        // cannot happen, but byte offsets would be wrong
+        return UwError(AMW_PARSE_ERROR);
+    }
+    return UwOK();
+}
+
+/*
+ * Tree
+ */
+
+static unsigned add_node(AmwCst* cst)
+/*
+ * Return index of new node or zero if out of memory.
+ */
+{
+    if (cst->num_nodes == cst->nodes_capacity) {
+        unsigned new_capacity = cst->nodes_capacity? cst->nodes_capacity * 2 : 64;
+        AmwCstNode* new_nodes = allocate(new_capacity * sizeof(AmwCstNode), false);
+        if (!new_nodes) {
+            return 0;
+        }
+        if (cst->nodes) {
+            memcpy(new_nodes, cst->nodes, cst->num_nodes * sizeof(AmwCstNode));
+            release((void**) &cst->nodes, cst->nodes_capacity * sizeof(AmwCstNode));
+        }
+        cst->nodes = new_nodes;
+        cst->nodes_capacity = new_capacity;
+    }
+    unsigned index = cst->num_nodes++;
+    AmwCstNode* node = &cst->nodes[index];
+    memset(node, 0, sizeof(AmwCstNode));
+    node->key = UwNull();
+    node->children = UwNull();
+    node->patch = NO_PATCH;
+    return index;
+}
+
+static void link_child(AmwCst* cst, unsigned parent_index, unsigned child_index)
+{
+    AmwCstNode* parent = &cst->nodes[parent_index];
+    if (parent->num_children) {
+        cst->nodes[parent->last_child].next_sibling = child_index;
+    } else {
+        parent->first_child = child_index;
+    }
+    parent->last_child = child_index;
+    parent->num_children++;
+}
+
+static UwResult index_child(AmwCst* cst, unsigned parent_index, unsigned child_index)
+/*
+ * Add linked child to the lookup index of the parent if the index is built.
+ */
+{
+    AmwCstNode* parent = &cst->nodes[parent_index];
+    if (uw_is_null(&parent->children)) {
+        return UwOK();
+    }
+    UwValue index = UwUnsigned(child_index);
+    if (parent->is_map) {
+        return uw_map_update(&parent->children, &cst->nodes[child_index].key, &index);
+    }
+    return uw_array_append(&parent->children, &index);
+}
+
+static void make_opaque(AmwCst* cst, unsigned node_index)
+/*
+ * Detach children, the value will be replaced as a whole.
+ */
+{
+    AmwCstNode* node = &cst->nodes[node_index];
+    uw_destroy(&node->children);
+    node->first_child = 0;
+    node->last_child = 0;
+    node->num_children = 0;
+    node->is_map = false;
+    node->is_list = false;
+}
+
+typedef struct {
+    AmwCst*    cst;
+    AmwParser* parser;  // for reading keys
+} Builder;
+
+static UwResult build_children(Builder* builder, unsigned parent_index, UwValuePtr container,
+                               unsigned first_line, unsigned first_column, unsigned end_line, unsigned depth);
+
+static UwResult find_separator(Builder* builder, unsigned line_index, unsigned column, unsigned* separator_pos)
+/*
+ * Find key-value separator of map entry starting at `column`.
+ * Write position next to colon to `separator_pos`.
+ */
+{
+    AmwParser* parser = builder->parser;
+
+    UwValue status = amw_parser_reset(parser, &builder->cst->lines);
+    uw_return_if_error(&status);
+    parser->line_index = line_index;
+    parser->end_line_index = line_index + 1;
+    parser->skip_comments = false;
+
+    AmwReadResult read_status = _amw_read_block_line(parser);
+    _amw_return_if_read_error(parser, read_status);
+
+    // the key may follow list item marker
+    parser->block_indent = column;
+
+    unsigned key_start = 0;
+    unsigned key_end = 0;
+    unsigned value_pos = 0;
+    AmwBlockParserFunc convspec = nullptr;
+    UwValue quoted_key = _amw_parse_key(parser, &key_start, &key_end, &convspec, &value_pos);
+    uw_return_if_error(&quoted_key);
+
+    UwValuePtr line = &parser->current_line;
+    unsigned pos = key_end;
+    if (uw_is_string(&quoted_key)) {
+        // multi-line quoted keys are not supported
+        if (!_amw_find_closing_quote(line, uw_char_at(line, column), column + 1, &pos)) {
+            return UwError(AMW_PARSE_ERROR);
+        }
+        pos++;
+    }
+    pos = uw_string_skip_spaces(line, pos);
+    if (uw_char_at(line, pos) != ':') {
+        return UwError(AMW_PARSE_ERROR);
+    }
+    *separator_pos = pos + 1;
+    return UwOK();
+}
+
+static UwResult build_entry(Builder* builder, unsigned node_index, UwValuePtr value,
+                           unsigned value_pos, bool is_map, unsigned depth)
+/*
+ * Build children of the entry if its value is a block.
+ * `value_pos` is the position next to the key-value separator or list item marker.
+ */
+{
+    AmwCst* cst = builder->cst;
+    AmwCstNode* node = &cst->nodes[node_index];
+    unsigned line_index = node->first_line;
+
+    bool is_container = (uw_is_map(value) && uw_map_length(value))
+                        || (uw_is_array(value) && uw_array_length(value));
+    if (!is_container) {
+        return UwOK();
+    }
+
+    UwValue line = uw_array_item(&cst->lines, line_index);
+    unsigned pos = uw_string_skip_spaces(&line, value_pos);
+    unsigned end_line = node->end_line;
+
+    if (pos >= uw_strlen(&line) || uw_char_at(&line, pos) == AMW_COMMENT) {
+        // block starts from the next line
+        return build_children(builder, node_index, value, line_index + 1, LINE_INDENT, end_line, depth + 1);
+    }
+    if (!is_map && uw_char_at(&line, pos) != ':') {
+        // block starts after list item marker
+        return build_children(builder, node_index, value, line_index, pos, end_line, depth + 1);
+    }
+    // conversion specifier
+    return UwError(AMW_PARSE_ERROR);
+}
+
+static UwResult build_children(Builder* builder, unsigned parent_index, UwValuePtr container,
+                               unsigned first_line, unsigned first_column, unsigned end_line, unsigned depth)
+/*
+ * Make child nodes for entries of `container` parsed from lines `first_line` to `end_line`.
+ * If `first_column` is not LINE_INDENT, the block starts inside the first line.
+ *
+ * Return AMW_PARSE_ERROR if lines do not match the container,
+ * the caller should detach children of the parent node in this case.
+ */
+{
+    AmwCst* cst = builder->cst;
+    bool is_map = uw_is_map(container);
+    unsigned num_items = is_map? uw_map_length(container) : uw_array_length(container);
+
+    if (depth > AMW_MAX_RECURSION_DEPTH) {
+        return UwError(AMW_PARSE_ERROR);
+    }
+
+    // make nodes for lines with the same indent as the first one
+
+    unsigned indent = 0;
+    unsigned num_entries = 0;
+    for (unsigned i = first_line; i < end_line; i++) {{
+        unsigned line_indent;
+        if (i == first_line && first_column != LINE_INDENT) {
+            line_indent = first_column;
+        } else {
+            UwValue line = uw_array_item(&cst->lines, i);
+            if (!_amw_significant_line(&line, &line_indent)) {
+                continue;
+            }
+        }
+        if (num_entries == 0) {
+            indent = line_indent;
+        } else if (line_indent < indent) {
+            return UwError(AMW_PARSE_ERROR);
+        } else if (line_indent > indent) {
+            continue;
+        }
+        if (num_entries == num_items) {
+            return UwError(AMW_PARSE_ERROR);
+        }
+        unsigned child_index = add_node(cst);
+        if (!child_index) {
+            return UwOOM();
+        }
+        AmwCstNode* child = &cst->nodes[child_index];
+        child->indent = indent;
+        child->first_line = i;
+        link_child(cst, parent_index, child_index);
+        num_entries++;
+    }}
+    if (num_entries != num_items) {
+        return UwError(AMW_PARSE_ERROR);
+    }
+    AmwCstNode* parent = &cst->nodes[parent_index];
+    parent->is_map = is_map;
+    parent->is_list = !is_map;
+
+    // children were added consecutively, nodes may be reallocated by recursive calls
+    unsigned first_child = parent->first_child;
+
+    for (unsigned n = 0; n < num_entries; n++) {{
+        unsigned child_index = first_child + n;
+        AmwCstNode* child = &cst->nodes[child_index];
+
+        unsigned next_line = (n + 1 < num_entries)? cst->nodes[child_index + 1].first_line : end_line;
+        while (next_line > child->first_line + 1 && !content_line(cst, next_line - 1, indent)) {
+            next_line--;
+        }
+        child->end_line = next_line;
+        child->end = cst->line_starts[next_line];
+
+        UwValue value = UwNull();
+        if (is_map) {
+            uw_map_item(container, n, &child->key, &value);
+        } else {
+            value = uw_array_item(container, n);
+        }
+        unsigned value_pos = child->indent + 1;
+        if (!is_map) {
+            UwValue line = uw_array_item(&cst->lines, child->first_line);
+            if (uw_char_at(&line, child->indent) != '-') {
+                return UwError(AMW_PARSE_ERROR);
+            }
+        } else {
+            // if the key is not recognized, neither is the block
+            UwValue status = find_separator(builder, child->first_line, child->indent, &value_pos);
+            uw_return_if_error(&status);
+            child = &cst->nodes[child_index];
+        }
+        child->value_start = char_offset(cst, child->first_line, value_pos);
+
+        UwValue status = build_entry(builder, child_index, &value, value_pos, is_map, depth);
+        if (uw_error(&status)) {
+            if (status.status_code != AMW_PARSE_ERROR) {
+                return uw_move(&status);
+            }
+            make_opaque(cst, child_index);
+        }
+    }}
+    return UwOK();
+}
+
+static UwResult build_tree(AmwCst* cst)
+{
+    // the root gets zero index which is also returned on error
+    add_node(cst);
+    if (cst->num_nodes != 1) {
+        return UwOOM();
+    }
+
+    unsigned first_line = 0;
+    while (first_line < cst->num_lines && !content_line(cst, first_line, 0)) {
+        first_line++;
+    }
+    unsigned end_line = cst->num_lines;
+    while (end_line > first_line && !content_line(cst, end_line - 1, 0)) {
+        end_line--;
+    }
+    AmwCstNode* root = &cst->nodes[0];
+    root->first_line = first_line;
+    root->end_line = end_line;
+    root->value_start = cst->line_starts[first_line];
+    root->end = cst->line_starts[end_line];
+
+    if (!((uw_is_map(&cst->value) && uw_map_length(&cst->value))
+          || (uw_is_array(&cst->value) && uw_array_length(&cst->value)))) {
+        return UwOK();
+    }
+
+    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(&cst->lines);
+    if (!parser) {
+        return UwOOM();
+    }
+    Builder builder = { .cst = cst, .parser = parser };
+
+    UwValue status = build_children(&builder, 0, &cst->value, first_line, LINE_INDENT, end_line, 0);
+    if (uw_error(&status)) {
+        if (status.status_code != AMW_PARSE_ERROR) {
+            return uw_move(&status);
+        }
+        make_opaque(cst, 0);
+    }
+    return UwOK();
+}
+
+static UwResult load(AmwCst* cst)
+{
+    UwValue status = split_source(cst);
+    uw_return_if_error(&status);
+
+    cst->value = amw_parse(&cst->lines);
+    uw_return_if_error(&cst->value);
+
+    return build_tree(cst);
+}
+
+static void init_empty(AmwCst* cst)
+{
+    memset(cst, 0, sizeof(AmwCst));
+    cst->lines = UwNull();
+    cst->value = UwNull();
+}
+
+UwResult amw_cst_init(AmwCst* cst, char* data, size_t size)
+{
+    init_empty(cst);
+
+    cst->data = allocate(size + 1, false);
+    if (!cst->data) {
+        return UwOOM();
+    }
+    memcpy(cst->data, data, size);
+    cst->data[size] = 0;
+    cst->size = size;
+
+    UwValue status = load(cst);
+    if (uw_error(&status)) {
+        amw_cst_fini(cst);
+    }
+    return uw_move(&status);
+}
+
+UwResult amw_cst_read_file(AmwCst* cst, char* path)
+{
+    init_empty(cst);
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return _amw_io_error("Cannot open", path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        UwValue status = _amw_io_error("Cannot stat", path);
+        close(fd);
+        return uw_move(&status);
+    }
+    UwValue status = _amw_read_fd(fd, path, st.st_size, &cst->data);
+    close(fd);
+    uw_return_if_error(&status);
+    cst->size = st.st_size;
+
+    uw_destroy(&status);
+    status = load(cst);
+    if (uw_error(&status)) {
+        amw_cst_fini(cst);
+    }
+    return uw_move(&status);
+}
+
+void amw_cst_fini(AmwCst* cst)
+{
+    for (unsigned i = 0; i < cst->num_nodes; i++) {
+        uw_destroy(&cst->nodes[i].key);
+        uw_destroy(&cst->nodes[i].children);
+    }
+    if (cst->nodes) {
+        release((void**) &cst->nodes, cst->nodes_capacity * sizeof(AmwCstNode));
+    }
+    for (unsigned i = 0; i < cst->num_patches; i++) {
+        amw_fini_output(&cst->patches[i].text);
+    }
+    if (cst->patches) {
+        release((void**) &cst->patches, cst->patches_capacity * sizeof(AmwCstPatch));
+    }
+    if (cst->line_starts) {
+        release((void**) &cst->line_starts, (cst->num_lines + 1) * sizeof(size_t));
+    }
+    if (cst->data) {
+        release((void**) &cst->data, cst->size + 1);
+    }
+    uw_destroy(&cst->lines);
+    uw_destroy(&cst->value);
+    init_empty(cst);
+}
+
+/*
+ * Editing
+ */
+
+static UwResult add_patch(AmwCst* cst, unsigned node_index, size_t start, size_t end)
+/*
+ * Create empty patch for the node.
+ */
+{
+    if (cst->num_patches == cst->patches_capacity) {
+        unsigned new_capacity = cst->patches_capacity? cst->patches_capacity * 2 : 16;
+        AmwCstPatch* new_patches = allocate(new_capacity * sizeof(AmwCstPatch), false);
+        if (!new_patches) {
+            return UwOOM();
+        }
+        if (cst->patches) {
+            memcpy(new_patches, cst->patches, cst->num_patches * sizeof(AmwCstPatch));
+            release((void**) &cst->patches, cst->patches_capacity * sizeof(AmwCstPatch));
+        }
+        cst->patches = new_patches;
+        cst->patches_capacity = new_capacity;
+    }
+    AmwCstPatch* patch = &cst->patches[cst->num_patches];
+    UwValue status = amw_init_output(&patch->text, PATCH_CAPACITY, nullptr, nullptr);
+    uw_return_if_error(&status);
+
+    patch->start = start;
+    patch->end = end;
+    patch->node = node_index;
+    patch->removed = false;
+    cst->nodes[node_index].patch = cst->num_patches++;
+    return UwOK();
+}
+
+static void remove_patches(AmwCst* cst, unsigned node_index)
+/*
+ * Remove patches of descendant nodes.
+ */
+{
+    for (unsigned child_index = cst->nodes[node_index].first_child; child_index;
+         child_index = cst->nodes[child_index].next_sibling) {
+
+        AmwCstNode* child = &cst->nodes[child_index];
+        if (child->patch != NO_PATCH) {
+            cst->patches[child->patch].removed = true;
+            child->patch = NO_PATCH;
+        }
+        remove_patches(cst, child_index);
+    }
+}
+
+static bool index_matches(UwValuePtr key, unsigned n)
+{
+    if (uw_is_signed(key)) {
+        return key->signed_value >= 0 && (uint64_t) key->signed_value == n;
+    }
+    if (uw_is_unsigned(key)) {
+        return key->unsigned_value == n;
+    }
+    return false;
+}
+
+static UwResult write_appended_entry(AmwCst* cst, unsigned node_index, bool map_entry, UwValuePtr value)
+/*
+ * Write text of appended entry to its patch.
+ */
+{
+    AmwCstNode* node = &cst->nodes[node_index];
+    AmwCstPatch* patch = &cst->patches[node->patch];
+    AmwOutput* text = &patch->text;
+    text->length = 0;
+
+    if (patch->start && patch->start == cst->size && cst->data[patch->start - 1] != '\n') {
+        UwValue status = _amw_output_putc(text, '\n');
+        uw_return_if_error(&status);
+    }
+    for (unsigned i = 0; i < node->indent; i++) {{
+        UwValue status = _amw_output_putc(text, ' ');
+        uw_return_if_error(&status);
+    }}
+    UwValue status = map_entry? _amw_dump_key(text, &node->key) : _amw_output_putc(text, '-');
+    uw_return_if_error(&status);
+    return _amw_dump_value(text, value, node->indent, map_entry);
+}
+
+static UwResult append_entry(AmwCst* cst, unsigned parent_index, UwValuePtr key, UwValuePtr value)
+{
+    AmwCstNode* parent = &cst->nodes[parent_index];
+    bool is_map = parent->is_map;
+
+    if (!is_map && !index_matches(key, parent->num_children)) {
+        return UwError(UW_ERROR_INDEX_OUT_OF_RANGE);
+    }
+    unsigned indent = cst->nodes[parent->first_child].indent;
+    size_t pos = parent->end;
+
+    unsigned node_index = add_node(cst);
+    if (!node_index) {
+        return UwOOM();
+    }
+    AmwCstNode* node = &cst->nodes[node_index];
+    node->indent = indent;
+    node->value_start = pos;
+    node->end = pos;
+    if (is_map) {
+        node->key = uw_clone(key);
+    }
+    link_child(cst, parent_index, node_index);
+
+    UwValue status = index_child(cst, parent_index, node_index);
+    uw_return_if_error(&status);
+    status = add_patch(cst, node_index, pos, pos);
+    uw_return_if_error(&status);
+
+    return write_appended_entry(cst, node_index, is_map, value);
+}
+
+static bool find_trailing_comment(AmwCst* cst, unsigned node_index, size_t* value_end)
+/*
+ * Check if the value of single-line entry is followed by comment
+ * and write byte offset of the end of the value to `value_end`.
+ *
+ * Only scalars that can be followed by comment are recognized:
+ * quoted strings, numbers, dates, and keywords.
+ * Comment characters in literal strings and conversion specifiers belong to the value.
+ */
+{
+    AmwCstNode* node = &cst->nodes[node_index];
+    if (node->end_line != node->first_line + 1) {
+        return false;
+    }
+    UwValue line = uw_array_item(&cst->lines, node->first_line);
+    unsigned length = uw_strlen(&line);
+
+    unsigned pos = 0;
+    for (size_t i = cst->line_starts[node->first_line]; i < node->value_start; i++) {
+        if ((cst->data[i] & 0xC0) != 0x80) {
+            pos++;
+        }
+    }
+    pos = uw_string_skip_spaces(&line, pos);
+    if (pos >= length) {
+        return false;
+    }
+    char32_t chr = uw_char_at(&line, pos);
+    unsigned comment_pos;
+    if (chr == '"' || chr == '\'') {
+        unsigned closing_quote_pos;
+        if (!_amw_find_closing_quote(&line, chr, pos + 1, &closing_quote_pos)) {
+            return false;
+        }
+        comment_pos = uw_string_skip_spaces(&line, closing_quote_pos + 1);
+        if (comment_pos >= length || uw_char_at(&line, comment_pos) != AMW_COMMENT) {
+            return false;
+        }
+    } else {
+        unsigned digit_pos = (chr == '-' || chr == '+')? pos + 1 : pos;
+        bool is_scalar = uw_isdigit(uw_char_at(&line, digit_pos))
+                         || uw_substring_eq(&line, pos, pos + 4, "null")
+                         || uw_substring_eq(&line, pos, pos + 4, "true")
+                         || uw_substring_eq(&line, pos, pos + 5, "false");
+        if (!is_scalar || !uw_strchr(&line, AMW_COMMENT, pos, &comment_pos)) {
+            return false;
+        }
+    }
+    unsigned end_pos = comment_pos;
+    while (end_pos > pos && uw_isspace(uw_char_at(&line, end_pos - 1))) {
+        end_pos--;
+    }
+    *value_end = char_offset(cst, node->first_line, end_pos);
+    return true;
+}
+
+static UwResult replace_value(AmwCst* cst, unsigned node_index, bool map_value, UwValuePtr value)
+/*
+ * Write new value to the patch of the node.
+ * Comment that follows replaced single-line value is kept: the patch ends
+ * before it if the new value takes one line too, otherwise the comment
+ * follows the key if the block starts on the next line,
+ * or is written on its own line after the value.
+ */
+{
+    remove_patches(cst, node_index);
+    make_opaque(cst, node_index);
+
+    AmwCstNode* node = &cst->nodes[node_index];
+    if (node->patch == NO_PATCH) {
+        UwValue status = add_patch(cst, node_index, node->value_start, node->end);
+        uw_return_if_error(&status);
+        node = &cst->nodes[node_index];
+    }
+    AmwCstPatch* patch = &cst->patches[node->patch];
+    if (node_index && patch->start == patch->end) {
+        // appended entry is written as a whole
+        return write_appended_entry(cst, node_index, map_value, value);
+    }
+    AmwOutput* text = &patch->text;
+    text->length = 0;
+    patch->end = node->end;
+    if (node_index == 0) {
+        return amw_dump(value, text);
+    }
+    size_t value_end;
+    if (!find_trailing_comment(cst, node_index, &value_end)) {
+        return _amw_dump_value(text, value, node->indent, map_value);
+    }
+    // comment with preceding spaces, without line break
+    char* comment = (char*) cst->data + value_end;
+    size_t comment_length = node->end - value_end;
+    if (comment_length && comment[comment_length - 1] == '\n') {
+        comment_length--;
+    }
+    bool block_after_key = map_value && ((uw_is_map(value) && uw_map_length(value))
+                                         || (uw_is_array(value) && uw_array_length(value)));
+    if (block_after_key) {
+        UwValue status = _amw_output_write(text, comment, comment_length);
+        uw_return_if_error(&status);
+        return _amw_dump_value(text, value, node->indent, map_value);
+    }
+    UwValue status = _amw_dump_value(text, value, node->indent, map_value);
+    uw_return_if_error(&status);
+
+    char* eol = memchr(text->data, '\n', text->length);
+    if (eol && eol == text->data + text->length - 1) {
+        // the rest of source line follows new value
+        text->length--;
+        patch->end = value_end;
+        return UwOK();
+    }
+    char* comment_start = memchr(comment, AMW_COMMENT, comment_length);
+    comment_length -= comment_start - comment;
+    for (unsigned i = 0; i < node->indent; i++) {{
+        UwValue status = _amw_output_putc(text, ' ');
+        uw_return_if_error(&status);
+    }}
+    status = _amw_output_write(text, comment_start, comment_length);
+    uw_return_if_error(&status);
+    return _amw_output_putc(text, '\n');
+}
+
+static UwResult find_child(AmwCst* cst, unsigned node_index, UwValuePtr key, unsigned* child_index)
+/*
+ * Find child node by map key or list index, write zero to `child_index` if not found.
+ * Build lookup index on first call, so bulk edits do not scan siblings.
+ */
+{
+    AmwCstNode* node = &cst->nodes[node_index];
+    *child_index = 0;
+
+    if (uw_is_null(&node->children)) {
+        UwValue children = node->is_map? UwMap() : UwArray();
+        uw_return_if_error(&children);
+        node->children = uw_move(&children);
+
+        for (unsigned i = node->first_child; i; i = cst->nodes[i].next_sibling) {{
+            UwValue status = index_child(cst, node_index, i);
+            if (uw_error(&status)) {
+                uw_destroy(&cst->nodes[node_index].children);
+                return uw_move(&status);
+            }
+        }}
+    }
+    if (node->is_map) {
+        UwValue found = uw_map_get(&node->children, key);
+        if (uw_is_unsigned(&found)) {
+            *child_index = found.unsigned_value;
+        }
+        return UwOK();
+    }
+    unsigned n;
+    if (uw_is_signed(key)) {
+        if (key->signed_value < 0 || (uint64_t) key->signed_value >= node->num_children) {
+            return UwOK();
+        }
+        n = key->signed_value;
+    } else if (uw_is_unsigned(key)) {
+        if (key->unsigned_value >= node->num_children) {
+            return UwOK();
+        }
+        n = key->unsigned_value;
+    } else {
+        return UwOK();
+    }
+    UwValue found = uw_array_item(&node->children, n);
+    if (uw_is_unsigned(&found)) {
+        *child_index = found.unsigned_value;
+    }
+    return UwOK();
+}
+
+UwResult amw_cst_set(AmwCst* cst, UwValuePtr path, UwValuePtr value)
+{
+    if (!uw_is_array(path) || cst->num_nodes == 0) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    unsigned path_length = uw_array_length(path);
+    unsigned node_index = 0;
+    bool map_value = false;
+
+    for (unsigned i = 0; i < path_length; i++) {{
+        AmwCstNode* node = &cst->nodes[node_index];
+        if (!node->is_map && !node->is_list) {
+            return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+        }
+        bool is_map = node->is_map;
+        UwValue key = uw_array_item(path, i);
+
+        unsigned child_index;
+        UwValue status = find_child(cst, node_index, &key, &child_index);
+        uw_return_if_error(&status);
+        if (!child_index) {
+            if (i + 1 == path_length) {
+                return append_entry(cst, node_index, &key, value);
+            }
+            return UwError(UW_ERROR_INDEX_OUT_OF_RANGE);
+        }
+        node_index = child_index;
+        map_value = is_map;
+    }}
+    return replace_value(cst, node_index, map_value, value);
+}
+
+/*
+ * Writing
+ */
+
+static UwResult write_source(AmwOutput* output, uint8_t* data, size_t size)
+/*
+ * Write unchanged part of the source, large parts bypass the buffer.
+ */
+{
+    if (output->flush && size >= output->capacity) {
+        UwValue status = amw_flush_output(output);
+        uw_return_if_error(&status);
+        return output->flush(output->ctx, (char*) data, size);
+    }
+    return _amw_output_write(output, (char*) data, size);
+}
+
+static int compare_patches(const void* a, const void* b)
+/*
+ * Order patches by position, patches at the same position keep the order they were added.
+ */
+{
+    AmwCstPatch* patch_a = *(AmwCstPatch**) a;
+    AmwCstPatch* patch_b = *(AmwCstPatch**) b;
+    if (patch_a->start != patch_b->start) {
+        return patch_a->start < patch_b->start? -1 : 1;
+    }
+    return (patch_a > patch_b) - (patch_a < patch_b);
+}
+
+UwResult amw_cst_write(AmwCst* cst, AmwOutput* output)
+{
+    unsigned num_patches = cst->num_patches;
+    AmwCstPatch** order = nullptr;
+    if (num_patches) {
+        order = allocate(num_patches * sizeof(AmwCstPatch*), false);
+        if (!order) {
+            return UwOOM();
+        }
+        for (unsigned i = 0; i < num_patches; i++) {
+            order[i] = &cst->patches[i];
+        }
+        qsort(order, num_patches, sizeof(AmwCstPatch*), compare_patches);
+    }
+
+    UwValue status = UwOK();
+    size_t pos = 0;
+    for (unsigned i = 0; i < num_patches; i++) {
+        AmwCstPatch* patch = order[i];
+        if (patch->removed) {
+            continue;
+        }
+        status = write_source(output, cst->data + pos, patch->start - pos);
+        if (uw_error(&status)) {
+            break;
+        }
+        status = _amw_output_write(output, patch->text.data, patch->text.length);
+        if (uw_error(&status)) {
+            break;
+        }
+        pos = patch->end;
+    }
+    if (order) {
+        release((void**) &order, num_patches * sizeof(AmwCstPatch*));
+    }
+    uw_return_if_error(&status);
+
+    status = write_source(output, cst->data + pos, cst->size - pos);
+    uw_return_if_error(&status);
+    return amw_flush_output(output);
+}
@@ -0,0 +1,152 @@
+#include <limits.h>
+
+#include <amw.h>
+
+UwTypeId UwTypeId_AmwDeferred = 0;
+
+static UwResult amw_deferred_init(UwValuePtr self, void* ctor_args)
+{
+    AmwDeferredData* data = _amw_deferred_data_ptr(self);
+    data->lines = UwNull();
+    data->start_index = 0;
+    data->end_index = 0;
+    data->line_number_offset = 0;
+    data->registry = nullptr;
+    data->resolved = false;
+    data->result = UwNull();
+    return UwOK();
+}
+
+static void amw_deferred_fini(UwValuePtr self)
+{
+    AmwDeferredData* data = _amw_deferred_data_ptr(self);
+    uw_destroy(&data->lines);
+    _amw_registry_unref(&data->registry);
+    uw_destroy(&data->result);
+}
+
+static UwType amw_deferred_type;
+
+[[ gnu::constructor ]]
+static void init_amw_deferred()
+{
+    UwTypeId_AmwDeferred = uw_subtype(&amw_deferred_type, "AmwDeferred", UwTypeId_Struct, AmwDeferredData);
+    amw_deferred_type.init = amw_deferred_init;
+    amw_deferred_type.fini = amw_deferred_fini;
+}
+
+static UwResult copy_current_line(AmwParser* parser, AmwDeferredData* data)
+/*
+ * Append current line to deferred block.
+ */
+{
+    // comments skipped by _amw_read_block_line leave gaps,
+    // fill them with placeholders to keep line numbers
+    while (data->line_number_offset + uw_array_length(&data->lines) + 1 < parser->line_number) {{
+        UwValue placeholder = uw_create_string("#");
+        uw_return_if_error(&placeholder);
+        uw_expect_ok( uw_array_append(&data->lines, &placeholder) );
+    }}
+    UwValue line = uw_substr(&parser->current_line, 0, UINT_MAX);
+    uw_return_if_error(&line);
+    uw_expect_ok( uw_array_append(&data->lines, &line) );
+    return UwOK();
+}
+
+UwResult _amw_defer_block(AmwParser* parser, unsigned block_pos, AmwBlockParserFunc parser_func)
+{
+    if (parser->blocklevel >= parser->max_blocklevel) {
+        return amw_parser_error(parser, parser->current_indent, "Too many nested blocks");
+    }
+
+    UwValue result = uw_create(UwTypeId_AmwDeferred);
+    uw_return_if_error(&result);
+
+    AmwDeferredData* data = _amw_deferred_data_ptr(&result);
+    data->block_indent = block_pos;
+    data->blocklevel = parser->blocklevel + 1;
+    data->parser_func = parser_func;
+    data->registry = _amw_registry_ref(parser->registry);
+
+    // lines of markup that is already an array are not copied,
+    // unless read_lines removes consumed lines from it: indexes would point to wrong lines
+    bool copy_lines = !uw_is_array(&parser->markup) || parser->read_lines;
+    if (copy_lines) {
+        data->lines = UwArray();
+        uw_return_if_error(&data->lines);
+        data->line_number_offset = parser->line_number - 1;
+    } else {
+        data->lines = uw_clone(&parser->markup);
+        data->line_number_offset = parser->line_number_offset;
+        data->start_index = parser->line_index - 1;
+    }
+
+    // skip the block, this checks indentation only
+
+    unsigned saved_block_indent = parser->block_indent;
+    parser->block_indent = block_pos;
+
+    for (;;) {{
+        if (copy_lines) {
+            UwValue status = copy_current_line(parser, data);
+            uw_return_if_error(&status);
+        }
+        AmwReadResult status = _amw_read_block_line(parser);
+        if (status == AMW_END_OF_BLOCK) {
+            break;
+        }
+        _amw_return_if_read_error(parser, status);
+    }}
+
+    parser->block_indent = saved_block_indent;
+
+    if (copy_lines) {
+        data->end_index = uw_array_length(&data->lines);
+    } else {
+        data->end_index = parser->line_index;
+    }
+    return uw_move(&result);
+}
+
+UwResult amw_resolve(UwValuePtr value)
+{
+    if (value->type_id != UwTypeId_AmwDeferred) {
+        return uw_clone(value);
+    }
+    AmwDeferredData* data = _amw_deferred_data_ptr(value);
+    if (data->resolved) {
+        return uw_clone(&data->result);
+    }
+
+    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(&data->lines);
+    if (!parser) {
+        return UwOOM();
+    }
+    _amw_registry_unref(&parser->registry);
+    parser->registry = _amw_registry_ref(data->registry);
+
+    parser->line_index = data->start_index;
+    parser->end_line_index = data->end_index;
+    parser->line_number_offset = data->line_number_offset;
+    parser->block_indent = data->block_indent;
+    parser->blocklevel = data->blocklevel;
+    parser->lazy = true;
+
+    // read first line of the block
+    AmwReadResult status = _amw_read_block_line(parser);
+    _amw_return_if_read_error(parser, status);
+
+    UwValue result = data->parser_func(parser);
+    uw_return_if_error(&result);
+
+    // make sure the block has no more data
+    AmwReadResult next_status = _amw_read_block_line(parser);
+    if (!parser->eof) {
+        _amw_return_if_read_error(parser, next_status);
+        return amw_parser_error(parser, parser->current_indent, "Extra data after parsed value");
+    }
+
+    data->result = uw_clone(&result);
+    data->resolved = true;
+    return uw_move(&result);
+}
@@ -0,0 +1,994 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <amw.h>
+
+#define INDENT_WIDTH  2
+
+// number of characters escaped at once, see write_quoted
+#define QUOTE_CHUNK  256
+
+/*
+ * Output buffer
+ */
+
+UwResult amw_init_output(AmwOutput* output, size_t capacity, AmwFlushFunc flush, void* ctx)
+{
+    if (capacity == 0) {
+        capacity = AMW_DEFAULT_OUTPUT_CAPACITY;
+    } else if (flush && capacity < AMW_MIN_OUTPUT_CAPACITY) {
+        capacity = AMW_MIN_OUTPUT_CAPACITY;
+    }
+    output->data = allocate(capacity, false);
+    if (!output->data) {
+        return UwOOM();
+    }
+    output->length = 0;
+    output->capacity = capacity;
+    output->flush = flush;
+    output->ctx = ctx;
+    return UwOK();
+}
+
+void amw_fini_output(AmwOutput* output)
+{
+    if (output->data) {
+        release((void**) &output->data, output->capacity);
+    }
+    output->length = 0;
+    output->capacity = 0;
+}
+
+UwResult amw_flush_output(AmwOutput* output)
+{
+    if (!output->flush || output->length == 0) {
+        return UwOK();
+    }
+    size_t length = output->length;
+    output->length = 0;
+    return output->flush(output->ctx, output->data, length);
+}
+
+UwResult _amw_output_reserve(AmwOutput* output, size_t size)
+{
+    if (output->capacity - output->length >= size) {
+        return UwOK();
+    }
+    if (output->flush) {
+        // the buffer is fixed, larger data must be written in slices
+        UwValue status = amw_flush_output(output);
+        uw_return_if_error(&status);
+        if (output->capacity < size) {
+            return UwError(UW_ERROR_INDEX_OUT_OF_RANGE);
+        }
+        return UwOK();
+    }
+    // grow
+    size_t new_capacity = output->capacity? output->capacity * 2 : AMW_DEFAULT_OUTPUT_CAPACITY;
+    while (new_capacity - output->length < size) {
+        new_capacity *= 2;
+    }
+    char* new_data = allocate(new_capacity, false);
+    if (!new_data) {
+        return UwOOM();
+    }
+    if (output->data) {
+        memcpy(new_data, output->data, output->length);
+        release((void**) &output->data, output->capacity);
+    }
+    output->data = new_data;
+    output->capacity = new_capacity;
+    return UwOK();
+}
+
+UwResult _amw_output_write_slices(AmwOutput* output, char* data, size_t size)
+{
+    if (!output->flush) {
+        UwValue status = _amw_output_reserve(output, size);
+        uw_return_if_error(&status);
+        memcpy(output->data + output->length, data, size);
+        output->length += size;
+        return UwOK();
+    }
+    while (size) {
+        if (output->length == output->capacity) {
+            UwValue status = amw_flush_output(output);
+            uw_return_if_error(&status);
+        }
+        size_t n = output->capacity - output->length;
+        if (n > size) {
+            n = size;
+        }
+        memcpy(output->data + output->length, data, n);
+        output->length += n;
+        data += n;
+        size -= n;
+    }
+    return UwOK();
+}
+
+UwResult amw_write_fd(void* ctx, char* data, size_t size)
+{
+    int fd = *(int*) ctx;
+    while (size) {
+        ssize_t n = write(fd, data, size);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return _amw_io_error("Cannot write", "output");
+        }
+        data += n;
+        size -= n;
+    }
+    return UwOK();
+}
+
+/*
+ * Scalars
+ */
+
+static const char digit_pairs[200] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+unsigned _amw_format_unsigned(uint64_t value, char* buf)
+{
+    // write two digits at a time from the end
+    char digits[20];
+    char* p = digits + sizeof(digits);
+    while (value >= 100) {
+        unsigned i = (value % 100) * 2;
+        value /= 100;
+        p -= 2;
+        memcpy(p, digit_pairs + i, 2);
+    }
+    if (value >= 10) {
+        p -= 2;
+        memcpy(p, digit_pairs + value * 2, 2);
+    } else {
+        *--p = (char) ('0' + value);
+    }
+    unsigned length = digits + sizeof(digits) - p;
+    memcpy(buf, p, length);
+    buf[length] = 0;
+    return length;
+}
+
+unsigned _amw_format_signed(int64_t value, char* buf)
+{
+    if (value < 0) {
+        buf[0] = '-';
+        return 1 + _amw_format_unsigned(-(uint64_t) value, buf + 1);
+    }
+    return _amw_format_unsigned(value, buf);
+}
+
+static const double powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+    1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17
+};
+
+#define MAX_EXACT_INTEGER  9007199254740992.0  // 2^53
+
+static unsigned format_fixed(double value, char* buf)
+/*
+ * Try to find the shortest decimal m / 10^d for positive `value`
+ * such that m < 2^53 and d < 18.
+ *
+ * Both m and 10^d are exact doubles, so their quotient is correctly rounded,
+ * same as strtod result for the decimal, and the check is exact.
+ *
+ * Return length or zero if not found.
+ */
+{
+    for (unsigned d = 0; d < sizeof(powers_of_ten) / sizeof(powers_of_ten[0]); d++) {
+        double scaled = value * powers_of_ten[d];
+        if (scaled >= MAX_EXACT_INTEGER) {
+            break;
+        }
+        uint64_t m = (uint64_t) (scaled + 0.5);
+        if ((double) m / powers_of_ten[d] != value) {
+            continue;
+        }
+        char digits[24];
+        unsigned num_digits = _amw_format_unsigned(m, digits);
+        char* p = buf;
+        if (d == 0) {
+            memcpy(p, digits, num_digits);
+            p += num_digits;
+            *p++ = '.';
+            *p++ = '0';
+        } else if (num_digits > d) {
+            unsigned int_digits = num_digits - d;
+            memcpy(p, digits, int_digits);
+            p += int_digits;
+            *p++ = '.';
+            memcpy(p, digits + int_digits, d);
+            p += d;
+        } else {
+            *p++ = '0';
+            *p++ = '.';
+            memset(p, '0', d - num_digits);
+            p += d - num_digits;
+            memcpy(p, digits, num_digits);
+            p += num_digits;
+        }
+        *p = 0;
+        return p - buf;
+    }
+    return 0;
+}
+
+unsigned _amw_format_float(double value, char* buf)
+{
+    if (!isfinite(value)) {
+        return 0;
+    }
+    if (value == 0.0) {
+        // the parser reads -0.0 as 0.0, write both zeros the same way
+        memcpy(buf, "0.0", 4);
+        return 3;
+    }
+    char* p = buf;
+    if (signbit(value)) {
+        *p++ = '-';
+        value = -value;
+    }
+
+    // fast path for typical values
+    if (value >= 1e-5 && value < 1e15) {
+        unsigned length = format_fixed(value, p);
+        if (length) {
+            return p + length - buf;
+        }
+    }
+
+    // the shortest of up to 17 significant digits that round-trips
+    int length = 0;
+    for (int precision = 15; precision <= 17; precision++) {
+        length = snprintf(p, 28, "%.*g", precision, value);
+        if (strtod(p, nullptr) == value) {
+            break;
+        }
+    }
+    // make sure it is not parsed as integer
+    if (!strpbrk(p, ".e")) {
+        p[length++] = '.';
+        p[length++] = '0';
+        p[length] = 0;
+    }
+    return p + length - buf;
+}
+
+static unsigned format_nanoseconds(uint32_t nanoseconds, char* buf)
+/*
+ * Write fraction of second with leading dot and without trailing zeros.
+ * Return length, zero if `nanoseconds` is zero.
+ */
+{
+    if (nanoseconds == 0) {
+        buf[0] = 0;
+        return 0;
+    }
+    int length = snprintf(buf, 12, ".%09u", nanoseconds);
+    while (buf[length - 1] == '0') {
+        length--;
+    }
+    buf[length] = 0;
+    return length;
+}
+
+unsigned _amw_format_datetime(UwValuePtr value, char* buf)
+{
+    char frac[12];
+    format_nanoseconds(value->nanosecond, frac);
+
+    char offset[8] = "";
+    if (value->gmt_offset) {
+        unsigned minutes = (value->gmt_offset < 0)? -value->gmt_offset : value->gmt_offset;
+        snprintf(offset, sizeof(offset), "%c%02u:%02u",
+                 (value->gmt_offset < 0)? '-' : '+', minutes / 60, minutes % 60);
+    }
+    return snprintf(buf, 64, "%04u-%02u-%02uT%02u:%02u:%02u%s%s",
+                    value->year, value->month, value->day,
+                    value->hour, value->minute, value->second, frac, offset);
+}
+
+unsigned _amw_format_timestamp(UwValuePtr value, char* buf)
+{
+    unsigned length = _amw_format_unsigned(value->ts_seconds, buf);
+    return length + format_nanoseconds(value->ts_nanoseconds, buf + length);
+}
+
+static UwResult write_cstr(AmwOutput* output, char* str)
+{
+    return _amw_output_write(output, str, strlen(str));
+}
+
+static UwResult write_spaces(AmwOutput* output, unsigned n)
+{
+    while (n) {
+        if (output->length == output->capacity) {
+            UwValue status = _amw_output_reserve(output, 1);
+            uw_return_if_error(&status);
+        }
+        size_t room = output->capacity - output->length;
+        if (room > n) {
+            room = n;
+        }
+        memset(output->data + output->length, ' ', room);
+        output->length += room;
+        n -= room;
+    }
+    return UwOK();
+}
+
+static UwResult write_simple_value(AmwOutput* output, UwValuePtr value)
+/*
+ * Write null, bool, or number without line break.
+ */
+{
+    char buf[32];
+    if (uw_is_null(value)) {
+        return write_cstr(output, "null");
+    }
+    if (uw_is_bool(value)) {
+        return write_cstr(output, value->bool_value? "true" : "false");
+    }
+    if (uw_is_signed(value)) {
+        return _amw_output_write(output, buf, _amw_format_signed(value->signed_value, buf));
+    }
+    if (uw_is_unsigned(value)) {
+        return _amw_output_write(output, buf, _amw_format_unsigned(value->unsigned_value, buf));
+    }
+    if (uw_is_float(value)) {
+        unsigned length = _amw_format_float(value->float_value, buf);
+        if (length == 0) {
+            return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+        }
+        return _amw_output_write(output, buf, length);
+    }
+    return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+}
+
+static UwResult write_datetime(AmwOutput* output, UwValuePtr value)
+{
+    char buf[80] = ":datetime: ";
+    unsigned length = strlen(buf);
+    length += _amw_format_datetime(value, buf + length);
+    return _amw_output_write(output, buf, length);
+}
+
+static UwResult write_timestamp(AmwOutput* output, UwValuePtr value)
+{
+    char buf[48] = ":timestamp: ";
+    unsigned length = strlen(buf);
+    length += _amw_format_timestamp(value, buf + length);
+    return _amw_output_write(output, buf, length);
+}
+
+/*
+ * Strings
+ */
+
+static inline bool is_control(char32_t c)
+{
+    return c < 0x20 || c == 0x7f;
+}
+
+static bool starts_with(UwValuePtr str, unsigned length, char* prefix)
+{
+    unsigned prefix_length = strlen(prefix);
+    return length >= prefix_length && uw_substring_eq(str, 0, prefix_length, prefix);
+}
+
+static bool is_safe_literal(UwValuePtr str)
+/*
+ * Check if string can be written as a single-line literal
+ * so that parse_value reads it back as the same string.
+ * Such strings are also valid map keys.
+ */
+{
+    unsigned length = uw_strlen(str);
+    if (length == 0) {
+        return false;
+    }
+    char32_t first = uw_char_at(str, 0);
+    char32_t second = (length > 1)? uw_char_at(str, 1) : 0;
+
+    if (uw_isspace(first) || uw_isspace(uw_char_at(str, length - 1))) {
+        // would be stripped
+        return false;
+    }
+    switch (first) {
+        case '"':
+        case '\'':
+        case ':':          // conversion specifier
+        case AMW_COMMENT:
+            return false;
+        case '-':
+            // list item or negative number
+            if (length == 1 || uw_isspace(second) || uw_isdigit(second)) {
+                return false;
+            }
+            break;
+        case '+':
+            if (uw_isdigit(second)) {
+                return false;
+            }
+            break;
+        default:
+            if (uw_isdigit(first)) {
+                return false;
+            }
+            break;
+    }
+    // reserved keywords, followed by anything they make bad markup
+    if (starts_with(str, length, "null") || starts_with(str, length, "true") || starts_with(str, length, "false")) {
+        return false;
+    }
+    for (unsigned i = 0; i < length; i++) {
+        char32_t c = uw_char_at(str, i);
+        if (is_control(c)) {
+            return false;
+        }
+        if (c == ':') {
+            // key-value separator, possibly with conversion specifier
+            if (i + 1 == length) {
+                return false;
+            }
+            char32_t next = uw_char_at(str, i + 1);
+            if (uw_isspace(next) || next == ':') {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool is_safe_literal_block(UwValuePtr str)
+/*
+ * Check if multi-line string can be written as :literal: block
+ * so that parse_literal_string reads it back as the same string.
+ *
+ * The string must end with single line break, lines must not have trailing spaces,
+ * at least one line must have no indent because the block is dedented,
+ * and the first line must be neither empty nor comment.
+ */
+{
+    unsigned length = uw_strlen(str);
+    if (length < 3 || uw_char_at(str, length - 1) != '\n' || uw_char_at(str, length - 2) == '\n') {
+        return false;
+    }
+    char32_t first = uw_char_at(str, 0);
+    if (first == '\n' || first == AMW_COMMENT) {
+        return false;
+    }
+    unsigned num_lines = 0;
+    bool unindented_line = false;
+    bool line_start = true;
+    for (unsigned i = 0; i < length; i++) {
+        char32_t c = uw_char_at(str, i);
+        if (c == '\n') {
+            if (i && uw_isspace(uw_char_at(str, i - 1)) && !line_start) {
+                return false;
+            }
+            num_lines++;
+            line_start = true;
+            continue;
+        }
+        if (is_control(c)) {
+            return false;
+        }
+        if (line_start) {
+            if (c == ' ') {
+                if (i == 0) {
+                    // first line is checked for comment by its indent, keep it simple
+                    return false;
+                }
+            } else if (uw_isspace(c)) {
+                return false;
+            } else {
+                unindented_line = true;
+            }
+            line_start = false;
+        }
+    }
+    return num_lines > 1 && unindented_line;
+}
+
+static UwResult write_substr(AmwOutput* output, UwValuePtr str, unsigned start_pos, unsigned end_pos)
+/*
+ * Write part of string in UTF-8.
+ */
+{
+    if (start_pos == end_pos) {
+        return UwOK();
+    }
+    // with flush function the buffer is fixed and long strings are written in slices;
+    // uw_substr_to_utf8_buf writes terminating zero, leave room for it
+    size_t limit = output->flush? output->capacity - 1 : SIZE_MAX;
+    while (start_pos < end_pos) {
+        // this is not the fastest way to measure UTF-8 length of substring,
+        // but characters are needed anyway
+        size_t size = 0;
+        unsigned slice_end = start_pos;
+        while (slice_end < end_pos) {
+            char32_t c = uw_char_at(str, slice_end);
+            unsigned n = (c < 0x80)? 1 : (c < 0x800)? 2 : (c < 0x10000)? 3 : 4;
+            if (size + n > limit) {
+                break;
+            }
+            size += n;
+            slice_end++;
+        }
+        if (output->capacity - output->length < size + 1) {
+            UwValue status = _amw_output_reserve(output, size + 1);
+            uw_return_if_error(&status);
+        }
+        uw_substr_to_utf8_buf(str, start_pos, slice_end, output->data + output->length);
+        output->length += size;
+        start_pos = slice_end;
+    }
+    return UwOK();
+}
+
+static inline char* put_utf8(char* p, char32_t c)
+{
+    if (c < 0x80) {
+        *p++ = (char) c;
+    } else if (c < 0x800) {
+        *p++ = (char) (0xC0 | (c >> 6));
+        *p++ = (char) (0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+        *p++ = (char) (0xE0 | (c >> 12));
+        *p++ = (char) (0x80 | ((c >> 6) & 0x3F));
+        *p++ = (char) (0x80 | (c & 0x3F));
+    } else {
+        *p++ = (char) (0xF0 | (c >> 18));
+        *p++ = (char) (0x80 | ((c >> 12) & 0x3F));
+        *p++ = (char) (0x80 | ((c >> 6) & 0x3F));
+        *p++ = (char) (0x80 | (c & 0x3F));
+    }
+    return p;
+}
+
+static UwResult write_quoted(AmwOutput* output, UwValuePtr str)
+/*
+ * Write single-line double-quoted string with JSON escapes.
+ */
+{
+    static char hex[] = "0123456789abcdef";
+
+    unsigned length = uw_strlen(str);
+
+    UwValue status = _amw_output_putc(output, '"');
+    uw_return_if_error(&status);
+
+    for (unsigned start = 0; start < length; start += QUOTE_CHUNK) {
+        unsigned end = start + QUOTE_CHUNK;
+        if (end > length) {
+            end = length;
+        }
+        // the longest escape \u001f takes 6 bytes
+        if (output->capacity - output->length < (end - start) * 6) {
+            UwValue status = _amw_output_reserve(output, (end - start) * 6);
+            uw_return_if_error(&status);
+        }
+        char* p = output->data + output->length;
+        for (unsigned i = start; i < end; i++) {
+            char32_t c = uw_char_at(str, i);
+            switch (c) {
+                case '"':  *p++ = '\\'; *p++ = '"';  break;
+                case '\\': *p++ = '\\'; *p++ = '\\'; break;
+                case '\b': *p++ = '\\'; *p++ = 'b';  break;
+                case '\f': *p++ = '\\'; *p++ = 'f';  break;
+                case '\n': *p++ = '\\'; *p++ = 'n';  break;
+                case '\r': *p++ = '\\'; *p++ = 'r';  break;
+                case '\t': *p++ = '\\'; *p++ = 't';  break;
+                default:
+                    if (is_control(c)) {
+                        *p++ = '\\'; *p++ = 'u'; *p++ = '0'; *p++ = '0';
+                        *p++ = hex[(c >> 4) & 15];
+                        *p++ = hex[c & 15];
+                    } else {
+                        p = put_utf8(p, c);
+                    }
+                    break;
+            }
+        }
+        output->length = p - output->data;
+    }
+    return _amw_output_putc(output, '"');
+}
+
+static UwResult write_literal_block(AmwOutput* output, UwValuePtr str, unsigned indent)
+/*
+ * Write :literal: block, lines are indented by `indent`.
+ */
+{
+    UwValue status = write_cstr(output, ":literal:\n");
+    uw_return_if_error(&status);
+
+    unsigned length = uw_strlen(str);
+    unsigned line_start = 0;
+    for (unsigned i = 0; i < length; i++) {{
+        if (uw_char_at(str, i) != '\n') {
+            continue;
+        }
+        if (i > line_start) {
+            UwValue status = write_spaces(output, indent);
+            uw_return_if_error(&status);
+            status = write_substr(output, str, line_start, i);
+            uw_return_if_error(&status);
+        }
+        UwValue status = _amw_output_putc(output, '\n');
+        uw_return_if_error(&status);
+        line_start = i + 1;
+    }}
+    return UwOK();
+}
+
+static UwResult write_key(AmwOutput* output, UwValuePtr key)
+{
+    if (uw_is_string(key)) {
+        if (is_safe_literal(key)) {
+            return write_substr(output, key, 0, uw_strlen(key));
+        }
+        return write_quoted(output, key);
+    }
+    return write_simple_value(output, key);
+}
+
+/*
+ * Values
+ */
+
+typedef enum {
+    AT_LINE_START,  // output is at the line start with indent written
+    AFTER_HYPHEN,   // list item marker is written
+    AFTER_KEY       // key and colon are written
+} Position;
+
+typedef struct {
+    _UwValue  container;
+    bool      is_map;
+    bool      inline_first;  // first item starts at current position
+    unsigned  index;
+    unsigned  length;
+    unsigned  indent;        // indent of items or keys
+} DumpFrame;
+
+typedef struct {
+    AmwOutput* output;
+    DumpFrame* frames;
+    unsigned   num_frames;
+    unsigned   frames_capacity;
+} Dumper;
+
+static void release_dumper(Dumper* dumper)
+{
+    for (unsigned i = 0; i < dumper->num_frames; i++) {
+        uw_destroy(&dumper->frames[i].container);
+    }
+    if (dumper->frames) {
+        release((void**) &dumper->frames, dumper->frames_capacity * sizeof(DumpFrame));
+    }
+}
+
+static UwResult push_frame(Dumper* dumper, UwValuePtr container, unsigned indent, bool inline_first)
+{
+    if (dumper->num_frames == dumper->frames_capacity) {
+        unsigned new_capacity = dumper->frames_capacity? dumper->frames_capacity * 2 : 16;
+        DumpFrame* new_frames = allocate(new_capacity * sizeof(DumpFrame), false);
+        if (!new_frames) {
+            return UwOOM();
+        }
+        if (dumper->frames) {
+            memcpy(new_frames, dumper->frames, dumper->num_frames * sizeof(DumpFrame));
+            release((void**) &dumper->frames, dumper->frames_capacity * sizeof(DumpFrame));
+        }
+        dumper->frames = new_frames;
+        dumper->frames_capacity = new_capacity;
+    }
+    DumpFrame* frame = &dumper->frames[dumper->num_frames++];
+    frame->container = uw_clone(container);
+    frame->is_map = uw_is_map(container);
+    frame->inline_first = inline_first;
+    frame->index = 0;
+    frame->length = frame->is_map? uw_map_length(container) : uw_array_length(container);
+    frame->indent = indent;
+    return UwOK();
+}
+
+static UwResult dump_value(Dumper* dumper, UwValuePtr value, unsigned indent, Position position)
+/*
+ * Write scalar value or start writing container.
+ *
+ * `indent` is the indent of the block the value belongs to.
+ */
+{
+    AmwOutput* output = dumper->output;
+
+    if (value->type_id == UwTypeId_AmwDeferred) {
+        UwValue resolved = amw_resolve(value);
+        uw_return_if_error(&resolved);
+        return dump_value(dumper, &resolved, indent, position);
+    }
+
+    bool is_list = uw_is_array(value);
+    bool is_map = uw_is_map(value);
+
+    if ((is_list && uw_array_length(value)) || (is_map && uw_map_length(value))) {
+        if (position == AFTER_KEY) {
+            UwValue status = _amw_output_putc(output, '\n');
+            uw_return_if_error(&status);
+        }
+        return push_frame(dumper, value, indent, position != AFTER_KEY);
+    }
+
+    if (position == AFTER_KEY) {
+        UwValue status = _amw_output_putc(output, ' ');
+        uw_return_if_error(&status);
+    }
+
+    UwValue status = UwOK();
+    if (is_list) {
+        status = write_cstr(output, ":json: []");
+    } else if (is_map) {
+        status = write_cstr(output, ":json: {}");
+    } else if (uw_is_string(value)) {
+        if (is_safe_literal(value)) {
+            status = write_substr(output, value, 0, uw_strlen(value));
+        } else if (is_safe_literal_block(value)) {
+            // literal block ends with line break
+            return write_literal_block(output, value, indent + INDENT_WIDTH);
+        } else {
+            status = write_quoted(output, value);
+        }
+    } else if (uw_is_datetime(value)) {
+        status = write_datetime(output, value);
+    } else if (uw_is_timestamp(value)) {
+        status = write_timestamp(output, value);
+    } else {
+        status = write_simple_value(output, value);
+    }
+    uw_return_if_error(&status);
+    return _amw_output_putc(output, '\n');
+}
+
+static UwResult dump(AmwOutput* output, UwValuePtr value, unsigned indent, Position position)
+/*
+ * Write `value` as a block value at `indent` and `position`.
+ */
+{
+    [[ gnu::cleanup(release_dumper) ]] Dumper dumper = { .output = output };
+
+    UwValue status = dump_value(&dumper, value, indent, position);
+    uw_return_if_error(&status);
+
+    while (dumper.num_frames) {{
+        DumpFrame* frame = &dumper.frames[dumper.num_frames - 1];
+        if (frame->index == frame->length) {
+            uw_destroy(&frame->container);
+            dumper.num_frames--;
+            continue;
+        }
+        if (frame->index || !frame->inline_first) {
+            UwValue status = write_spaces(output, frame->indent);
+            uw_return_if_error(&status);
+        }
+        // dump_value may push new frame, don't use `frame` after it
+        unsigned index = frame->index++;
+        unsigned item_indent = frame->indent + INDENT_WIDTH;
+
+        if (frame->is_map) {
+            UwValue key = UwNull();
+            UwValue value = UwNull();
+            uw_map_item(&frame->container, index, &key, &value);
+
+            UwValue status = write_key(output, &key);
+            uw_return_if_error(&status);
+            status = _amw_output_putc(output, ':');
+            uw_return_if_error(&status);
+            status = dump_value(&dumper, &value, item_indent, AFTER_KEY);
+            uw_return_if_error(&status);
+        } else {
+            UwValue item = uw_array_item(&frame->container, index);
+
+            UwValue status = write_cstr(output, "- ");
+            uw_return_if_error(&status);
+            status = dump_value(&dumper, &item, item_indent, AFTER_HYPHEN);
+            uw_return_if_error(&status);
+        }
+    }}
+    return UwOK();
+}
+
+UwResult amw_dump(UwValuePtr value, AmwOutput* output)
+{
+    UwValue status = dump(output, value, 0, AT_LINE_START);
+    uw_return_if_error(&status);
+    return amw_flush_output(output);
+}
+
+UwResult _amw_dump_key(AmwOutput* output, UwValuePtr key)
+{
+    UwValue status = write_key(output, key);
+    uw_return_if_error(&status);
+    return _amw_output_putc(output, ':');
+}
+
+UwResult _amw_dump_value(AmwOutput* output, UwValuePtr value, unsigned indent, bool map_value)
+{
+    if (map_value) {
+        return dump(output, value, indent + INDENT_WIDTH, AFTER_KEY);
+    }
+    UwValue status = _amw_output_putc(output, ' ');
+    uw_return_if_error(&status);
+    return dump(output, value, indent + INDENT_WIDTH, AFTER_HYPHEN);
+}
+
+/*
+ * Streaming writer
+ */
+
+UwResult amw_writer_init(AmwWriter* writer, int fd, size_t buffer_size)
+{
+    writer->fd = fd;
+    writer->depth = 0;
+    writer->done = false;
+    return amw_init_output(&writer->output, buffer_size, amw_write_fd, &writer->fd);
+}
+
+void amw_writer_fini(AmwWriter* writer)
+{
+    amw_fini_output(&writer->output);
+}
+
+static UwResult start_item(AmwOutput* output, AmwWriterFrame* frame)
+/*
+ * Write line break and indent before list item or map key.
+ */
+{
+    if (frame->count == 0 && frame->after_key) {
+        UwValue status = _amw_output_putc(output, '\n');
+        uw_return_if_error(&status);
+    }
+    if (frame->count || frame->after_key) {
+        UwValue status = write_spaces(output, frame->indent);
+        uw_return_if_error(&status);
+    }
+    frame->count++;
+    return UwOK();
+}
+
+static UwResult start_value(AmwWriter* writer, unsigned* indent, Position* position)
+/*
+ * Prepare output for the next value: write list item marker
+ * or make sure map key is written.
+ * Return indent of the block the value belongs to and output position.
+ */
+{
+    if (writer->depth == 0) {
+        if (writer->done) {
+            // only one top-level value is allowed
+            return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+        }
+        writer->done = true;
+        *indent = 0;
+        *position = AT_LINE_START;
+        return UwOK();
+    }
+    AmwWriterFrame* frame = &writer->frames[writer->depth - 1];
+    *indent = frame->indent + INDENT_WIDTH;
+    if (frame->is_map) {
+        if (!frame->key_written) {
+            return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+        }
+        frame->key_written = false;
+        *position = AFTER_KEY;
+        return UwOK();
+    }
+    UwValue status = start_item(&writer->output, frame);
+    uw_return_if_error(&status);
+    *position = AFTER_HYPHEN;
+    return write_cstr(&writer->output, "- ");
+}
+
+static UwResult begin_container(AmwWriter* writer, bool is_map)
+{
+    if (writer->depth == AMW_WRITER_MAX_DEPTH) {
+        return UwError(UW_ERROR_INDEX_OUT_OF_RANGE);
+    }
+    unsigned indent;
+    Position position;
+    UwValue status = start_value(writer, &indent, &position);
+    uw_return_if_error(&status);
+
+    // nothing is written until the first item because empty container needs conversion specifier
+    AmwWriterFrame* frame = &writer->frames[writer->depth++];
+    frame->is_map = is_map;
+    frame->after_key = position == AFTER_KEY;
+    frame->key_written = false;
+    frame->count = 0;
+    frame->indent = indent;
+    return UwOK();
+}
+
+UwResult amw_writer_begin_map(AmwWriter* writer)
+{
+    return begin_container(writer, true);
+}
+
+UwResult amw_writer_begin_list(AmwWriter* writer)
+{
+    return begin_container(writer, false);
+}
+
+UwResult amw_writer_key(AmwWriter* writer, UwValuePtr key)
+{
+    if (writer->depth == 0) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    AmwWriterFrame* frame = &writer->frames[writer->depth - 1];
+    if (!frame->is_map || frame->key_written) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    AmwOutput* output = &writer->output;
+
+    UwValue status = start_item(output, frame);
+    uw_return_if_error(&status);
+    status = write_key(output, key);
+    uw_return_if_error(&status);
+    frame->key_written = true;
+    return _amw_output_putc(output, ':');
+}
+
+UwResult amw_writer_scalar(AmwWriter* writer, UwValuePtr value)
+{
+    unsigned indent;
+    Position position;
+    UwValue status = start_value(writer, &indent, &position);
+    uw_return_if_error(&status);
+    return dump(&writer->output, value, indent, position);
+}
+
+UwResult amw_writer_end(AmwWriter* writer)
+{
+    if (writer->depth == 0) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    AmwWriterFrame* frame = &writer->frames[writer->depth - 1];
+    if (frame->key_written) {
+        // map key without value
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    if (frame->count == 0) {
+        AmwOutput* output = &writer->output;
+        if (frame->after_key) {
+            UwValue status = _amw_output_putc(output, ' ');
+            uw_return_if_error(&status);
+        }
+        UwValue status = write_cstr(output, frame->is_map? ":json: {}\n" : ":json: []\n");
+        uw_return_if_error(&status);
+    }
+    writer->depth--;
+    return UwOK();
+}
+
+UwResult amw_writer_finish(AmwWriter* writer)
+{
+    if (writer->depth || !writer->done) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    return amw_flush_output(&writer->output);
+}
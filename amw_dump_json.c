@@ -0,0 +1,342 @@
+#include <string.h>
+
+#include <amw.h>
+
+// number of bytes escaped at once, see write_string
+#define ESCAPE_CHUNK  4096
+
+/*
+ * String escaping, the inverse of _amw_unescape_line.
+ *
+ * Strings are converted to UTF-8 first, then scanned eight bytes at a time
+ * for characters that need escaping: quotation mark, backslash, and control characters.
+ * Runs of bytes that need no escaping are copied as is.
+ */
+
+#define SWAR_ONES   0x0101010101010101ULL
+#define SWAR_HIGHS  0x8080808080808080ULL
+
+static inline uint64_t escape_mask(uint64_t x)
+/*
+ * Return mask with high bit set for bytes that need escaping.
+ * Bytes above the first match may have false positives because of borrows,
+ * so only the lowest bit is reliable.
+ */
+{
+    uint64_t control = (x - SWAR_ONES * 0x20) & ~x;
+    uint64_t quote = x ^ (SWAR_ONES * '"');
+    quote = (quote - SWAR_ONES) & ~quote;
+    uint64_t backslash = x ^ (SWAR_ONES * '\\');
+    backslash = (backslash - SWAR_ONES) & ~backslash;
+    return (control | quote | backslash) & SWAR_HIGHS;
+}
+
+static inline bool needs_escape(uint8_t c)
+{
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+static size_t skip_clean_bytes(uint8_t* data, size_t pos, size_t end)
+/*
+ * Return position of the first byte that needs escaping, or `end`.
+ */
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (end - pos >= 8) {
+        uint64_t x;
+        memcpy(&x, data + pos, 8);
+        uint64_t mask = escape_mask(x);
+        if (mask) {
+            return pos + (__builtin_ctzll(mask) >> 3);
+        }
+        pos += 8;
+    }
+#endif
+    while (pos < end && !needs_escape(data[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+static inline char* put_escape(char* p, uint8_t c)
+{
+    static char hex[] = "0123456789abcdef";
+
+    *p++ = '\\';
+    switch (c) {
+        case '"':  *p++ = '"';  break;
+        case '\\': *p++ = '\\'; break;
+        case '\b': *p++ = 'b';  break;
+        case '\f': *p++ = 'f';  break;
+        case '\n': *p++ = 'n';  break;
+        case '\r': *p++ = 'r';  break;
+        case '\t': *p++ = 't';  break;
+        default:
+            *p++ = 'u';
+            *p++ = '0';
+            *p++ = '0';
+            *p++ = hex[c >> 4];
+            *p++ = hex[c & 15];
+            break;
+    }
+    return p;
+}
+
+typedef struct {
+    _UwValue  container;
+    bool      is_map;
+    unsigned  index;
+    unsigned  length;
+} JsonFrame;
+
+typedef struct {
+    AmwOutput* output;
+    JsonFrame* frames;
+    unsigned   num_frames;
+    unsigned   frames_capacity;
+
+    // UTF-8 representation of the string being written
+    uint8_t*   utf8;
+    size_t     utf8_capacity;
+} JsonDumper;
+
+static void release_json_dumper(JsonDumper* dumper)
+{
+    for (unsigned i = 0; i < dumper->num_frames; i++) {
+        uw_destroy(&dumper->frames[i].container);
+    }
+    if (dumper->frames) {
+        release((void**) &dumper->frames, dumper->frames_capacity * sizeof(JsonFrame));
+    }
+    if (dumper->utf8) {
+        release((void**) &dumper->utf8, dumper->utf8_capacity);
+    }
+}
+
+static UwResult write_string(JsonDumper* dumper, UwValuePtr str)
+{
+    AmwOutput* output = dumper->output;
+
+    // convert to UTF-8, the buffer is reused for all strings
+    size_t size = uw_strlen_in_utf8(str);
+    if (dumper->utf8_capacity < size + 1) {
+        size_t new_capacity = (size + 1 + 255) & ~(size_t) 255;
+        uint8_t* new_utf8 = allocate(new_capacity, false);
+        if (!new_utf8) {
+            return UwOOM();
+        }
+        if (dumper->utf8) {
+            release((void**) &dumper->utf8, dumper->utf8_capacity);
+        }
+        dumper->utf8 = new_utf8;
+        dumper->utf8_capacity = new_capacity;
+    }
+    uw_substr_to_utf8_buf(str, 0, uw_strlen(str), (char*) dumper->utf8);
+
+    UwValue status = _amw_output_putc(output, '"');
+    uw_return_if_error(&status);
+
+    for (size_t start = 0; start < size; start += ESCAPE_CHUNK) {
+        size_t end = start + ESCAPE_CHUNK;
+        if (end > size) {
+            end = size;
+        }
+        // the longest escape \u001f takes 6 bytes
+        if (output->capacity - output->length < (end - start) * 6) {
+            UwValue status = _amw_output_reserve(output, (end - start) * 6);
+            uw_return_if_error(&status);
+        }
+        char* p = output->data + output->length;
+        size_t pos = start;
+        while (pos < end) {
+            size_t clean_end = skip_clean_bytes(dumper->utf8, pos, end);
+            memcpy(p, dumper->utf8 + pos, clean_end - pos);
+            p += clean_end - pos;
+            if (clean_end == end) {
+                break;
+            }
+            p = put_escape(p, dumper->utf8[clean_end]);
+            pos = clean_end + 1;
+        }
+        output->length = p - output->data;
+    }
+    return _amw_output_putc(output, '"');
+}
+
+static UwResult write_key(JsonDumper* dumper, UwValuePtr key)
+/*
+ * Write map key, JSON keys are always strings.
+ */
+{
+    if (uw_is_string(key)) {
+        return write_string(dumper, key);
+    }
+    char buf[40];
+    unsigned length;
+    if (uw_is_null(key)) {
+        length = 4;
+        memcpy(buf, "null", 4);
+    } else if (uw_is_bool(key)) {
+        length = key->bool_value? 4 : 5;
+        memcpy(buf, key->bool_value? "true" : "false", length);
+    } else if (uw_is_signed(key)) {
+        length = _amw_format_signed(key->signed_value, buf);
+    } else if (uw_is_unsigned(key)) {
+        length = _amw_format_unsigned(key->unsigned_value, buf);
+    } else if (uw_is_float(key)) {
+        length = _amw_format_float(key->float_value, buf);
+        if (length == 0) {
+            return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+        }
+    } else {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    AmwOutput* output = dumper->output;
+    if (output->capacity - output->length < length + 2) {
+        UwValue status = _amw_output_reserve(output, length + 2);
+        uw_return_if_error(&status);
+    }
+    char* p = output->data + output->length;
+    *p++ = '"';
+    memcpy(p, buf, length);
+    p += length;
+    *p++ = '"';
+    output->length = p - output->data;
+    return UwOK();
+}
+
+static UwResult push_frame(JsonDumper* dumper, UwValuePtr container, bool is_map)
+{
+    if (dumper->num_frames == dumper->frames_capacity) {
+        unsigned new_capacity = dumper->frames_capacity? dumper->frames_capacity * 2 : 16;
+        JsonFrame* new_frames = allocate(new_capacity * sizeof(JsonFrame), false);
+        if (!new_frames) {
+            return UwOOM();
+        }
+        if (dumper->frames) {
+            memcpy(new_frames, dumper->frames, dumper->num_frames * sizeof(JsonFrame));
+            release((void**) &dumper->frames, dumper->frames_capacity * sizeof(JsonFrame));
+        }
+        dumper->frames = new_frames;
+        dumper->frames_capacity = new_capacity;
+    }
+    JsonFrame* frame = &dumper->frames[dumper->num_frames++];
+    frame->container = uw_clone(container);
+    frame->is_map = is_map;
+    frame->index = 0;
+    frame->length = is_map? uw_map_length(container) : uw_array_length(container);
+    return _amw_output_putc(dumper->output, is_map? '{' : '[');
+}
+
+static UwResult dump_value(JsonDumper* dumper, UwValuePtr value)
+/*
+ * Write scalar value or start writing container.
+ */
+{
+    AmwOutput* output = dumper->output;
+    char buf[80];
+    unsigned length;
+
+    if (uw_is_string(value)) {
+        return write_string(dumper, value);
+    }
+    if (uw_is_array(value)) {
+        return push_frame(dumper, value, false);
+    }
+    if (uw_is_map(value)) {
+        return push_frame(dumper, value, true);
+    }
+    if (uw_is_null(value)) {
+        return _amw_output_write(output, "null", 4);
+    }
+    if (uw_is_bool(value)) {
+        return value->bool_value? _amw_output_write(output, "true", 4) : _amw_output_write(output, "false", 5);
+    }
+    if (uw_is_signed(value)) {
+        length = _amw_format_signed(value->signed_value, buf);
+
+    } else if (uw_is_unsigned(value)) {
+        length = _amw_format_unsigned(value->unsigned_value, buf);
+
+    } else if (uw_is_float(value)) {
+        length = _amw_format_float(value->float_value, buf);
+        if (length == 0) {
+            return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+        }
+    } else if (uw_is_datetime(value)) {
+        buf[0] = '"';
+        length = 1 + _amw_format_datetime(value, buf + 1);
+        buf[length++] = '"';
+
+    } else if (uw_is_timestamp(value)) {
+        length = _amw_format_timestamp(value, buf);
+
+    } else if (value->type_id == UwTypeId_AmwDeferred) {
+        UwValue resolved = amw_resolve(value);
+        uw_return_if_error(&resolved);
+        return dump_value(dumper, &resolved);
+
+    } else {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    return _amw_output_write(output, buf, length);
+}
+
+UwResult _amw_dump_json_value(AmwOutput* output, UwValuePtr value)
+{
+    [[ gnu::cleanup(release_json_dumper) ]] JsonDumper dumper = { .output = output };
+
+    UwValue status = dump_value(&dumper, value);
+    uw_return_if_error(&status);
+
+    while (dumper.num_frames) {{
+        JsonFrame* frame = &dumper.frames[dumper.num_frames - 1];
+        if (frame->index == frame->length) {
+            UwValue status = _amw_output_putc(output, frame->is_map? '}' : ']');
+            uw_return_if_error(&status);
+            uw_destroy(&frame->container);
+            dumper.num_frames--;
+            continue;
+        }
+        if (frame->index) {
+            UwValue status = _amw_output_putc(output, ',');
+            uw_return_if_error(&status);
+        }
+        // dump_value may push new frame, don't use `frame` after it
+        unsigned index = frame->index++;
+
+        if (frame->is_map) {
+            UwValue key = UwNull();
+            UwValue value = UwNull();
+            uw_map_item(&frame->container, index, &key, &value);
+
+            UwValue status = write_key(&dumper, &key);
+            uw_return_if_error(&status);
+            status = _amw_output_putc(output, ':');
+            uw_return_if_error(&status);
+            status = dump_value(&dumper, &value);
+            uw_return_if_error(&status);
+        } else {
+            UwValue item = uw_array_item(&frame->container, index);
+            UwValue status = dump_value(&dumper, &item);
+            uw_return_if_error(&status);
+        }
+    }}
+    return UwOK();
+}
+
+UwResult _amw_dump_json_key(AmwOutput* output, UwValuePtr key)
+{
+    [[ gnu::cleanup(release_json_dumper) ]] JsonDumper dumper = { .output = output };
+
+    UwValue status = write_key(&dumper, key);
+    uw_return_if_error(&status);
+    return _amw_output_putc(output, ':');
+}
+
+UwResult amw_dump_json(UwValuePtr value, AmwOutput* output)
+{
+    UwValue status = _amw_dump_json_value(output, value);
+    uw_return_if_error(&status);
+    return amw_flush_output(output);
+}
@@ -0,0 +1,192 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <amw.h>
+
+uint64_t amw_fnv1a(void* data, size_t size, uint64_t hash)
+{
+    uint8_t* p = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= AMW_FNV_PRIME;
+    }
+    return hash;
+}
+
+UwResult _amw_create_string_utf8(char* data, size_t length)
+{
+    if (length > UINT_MAX) {
+        return UwOOM();
+    }
+    UwValue str = uw_create_empty_string(length, 1);
+    uw_return_if_error(&str);
+
+    unsigned bytes_processed;
+    if (!uw_string_append_utf8(&str, (char8_t*) data, length, &bytes_processed)) {
+        return UwOOM();
+    }
+    return uw_move(&str);
+}
+
+UwResult _amw_io_error(char* what, char* path)
+{
+    int err = errno;
+    UwValue status = UwError(AMW_IO_ERROR);
+    _uw_set_status_desc(&status, "%s %s: %s", what, path, strerror(err));
+    return uw_move(&status);
+}
+
+UwResult _amw_read_fd(int fd, char* path, size_t size, uint8_t** data)
+{
+    uint8_t* buf = allocate(size + 1, false);
+    if (!buf) {
+        return UwOOM();
+    }
+    size_t pos = 0;
+    while (pos < size) {
+        ssize_t n = read(fd, buf + pos, size - pos);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            UwValue status = _amw_io_error("Cannot read", path);
+            release((void**) &buf, size + 1);
+            return uw_move(&status);
+        }
+        if (n == 0) {
+            // file is truncated while reading
+            memset(buf + pos, '\n', size - pos);
+            break;
+        }
+        pos += n;
+    }
+    buf[size] = 0;
+    *data = buf;
+    return UwOK();
+}
+
+static UwResult append_lines(UwValuePtr lines, char* data, size_t size)
+{
+    char* end = data + size;
+    while (data < end) {{
+        char* eol = memchr(data, '\n', end - data);
+        size_t len = eol? (size_t) (eol - data) : (size_t) (end - data);
+
+        UwValue line = _amw_create_string_utf8(data, len);
+        uw_return_if_error(&line);
+        UwValue status = uw_array_append(lines, &line);
+        uw_return_if_error(&status);
+
+        data += len + 1;
+    }}
+    return UwOK();
+}
+
+UwResult amw_split_lines(char* data, size_t size)
+{
+    UwValue lines = UwArray();
+    uw_return_if_error(&lines);
+
+    UwValue status = append_lines(&lines, data, size);
+    uw_return_if_error(&status);
+    return uw_move(&lines);
+}
+
+UwResult amw_read_file_lines(char* path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return _amw_io_error("Cannot open", path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        UwValue status = _amw_io_error("Cannot stat", path);
+        close(fd);
+        return uw_move(&status);
+    }
+    uint8_t* data;
+    UwValue status = _amw_read_fd(fd, path, st.st_size, &data);
+    close(fd);
+    uw_return_if_error(&status);
+
+    UwValue lines = amw_split_lines((char*) data, st.st_size);
+    release((void**) &data, st.st_size + 1);
+    return uw_move(&lines);
+}
+
+UwResult amw_init_line_reader(AmwLineReader* reader, int fd, size_t buffer_size)
+{
+    if (buffer_size == 0) {
+        buffer_size = AMW_DEFAULT_OUTPUT_CAPACITY;
+    }
+    reader->data = allocate(buffer_size, false);
+    if (!reader->data) {
+        return UwOOM();
+    }
+    reader->fd = fd;
+    reader->length = 0;
+    reader->capacity = buffer_size;
+    reader->eof = false;
+    return UwOK();
+}
+
+void amw_fini_line_reader(AmwLineReader* reader)
+{
+    if (reader->data) {
+        release((void**) &reader->data, reader->capacity);
+    }
+    reader->capacity = 0;
+}
+
+UwResult amw_read_fd_lines(void* ctx, UwValuePtr lines)
+{
+    AmwLineReader* reader = ctx;
+    while (!reader->eof) {
+        if (reader->length == reader->capacity) {
+            // the line does not fit the buffer
+            size_t new_capacity = reader->capacity * 2;
+            char* new_data = allocate(new_capacity, false);
+            if (!new_data) {
+                return UwOOM();
+            }
+            memcpy(new_data, reader->data, reader->length);
+            release((void**) &reader->data, reader->capacity);
+            reader->data = new_data;
+            reader->capacity = new_capacity;
+        }
+        ssize_t n = read(reader->fd, reader->data + reader->length, reader->capacity - reader->length);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return _amw_io_error("Cannot read", "input");
+        }
+        if (n == 0) {
+            // the last line may have no line break
+            reader->eof = true;
+            UwValue status = append_lines(lines, reader->data, reader->length);
+            reader->length = 0;
+            return uw_move(&status);
+        }
+        size_t start = reader->length;
+        reader->length += n;
+
+        // append complete lines and keep the incomplete one
+        size_t size = reader->length;
+        while (size > start && reader->data[size - 1] != '\n') {
+            size--;
+        }
+        if (size > start) {
+            UwValue status = append_lines(lines, reader->data, size);
+            uw_return_if_error(&status);
+            reader->length -= size;
+            memmove(reader->data, reader->data + size, reader->length);
+            return UwOK();
+        }
+    }
+    return UwOK();
+}
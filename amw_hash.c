@@ -0,0 +1,120 @@
+#include <string.h>
+
+#include <amw.h>
+
+uint64_t _amw_hash_mix(uint64_t a, uint64_t b)
+{
+    uint64_t h = a ^ (b + 0x9e3779b97f4a7c15ULL + (a << 6) + (a >> 2));
+
+    // splitmix64 finalizer
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+uint64_t _amw_hash_substring(UwValuePtr str, unsigned start_pos, unsigned end_pos)
+{
+    uint64_t hash = AMW_FNV_OFFSET_BASIS;
+    for (unsigned i = start_pos; i < end_pos; i++) {
+        char32_t c = uw_char_at(str, i);
+        hash = amw_fnv1a(&c, sizeof(c), hash);
+    }
+    return hash;
+}
+
+uint64_t _amw_hash_string(UwValuePtr str)
+{
+    return _amw_hash_substring(str, 0, uw_strlen(str));
+}
+
+uint64_t amw_value_hash(UwValuePtr value)
+{
+    if (uw_is_null(value)) {
+        return _amw_hash_mix(AMW_COMPILED_NULL, 0);
+
+    } else if (uw_is_bool(value)) {
+        return _amw_hash_mix(AMW_COMPILED_BOOL, value->bool_value);
+
+    } else if (uw_is_signed(value)) {
+        return _amw_hash_mix(AMW_COMPILED_SIGNED, value->signed_value);
+
+    } else if (uw_is_unsigned(value)) {
+        return _amw_hash_mix(AMW_COMPILED_UNSIGNED, value->unsigned_value);
+
+    } else if (uw_is_float(value)) {
+        uint64_t bits;
+        memcpy(&bits, &value->float_value, sizeof(bits));
+        return _amw_hash_mix(AMW_COMPILED_FLOAT, bits);
+
+    } else if (uw_is_string(value)) {
+        return _amw_hash_mix(AMW_COMPILED_STRING, _amw_hash_string(value));
+
+    } else if (uw_is_datetime(value)) {
+        uint64_t hash = _amw_hash_mix(AMW_COMPILED_DATETIME, value->year);
+        hash = _amw_hash_mix(hash, value->month);
+        hash = _amw_hash_mix(hash, value->day);
+        hash = _amw_hash_mix(hash, value->hour);
+        hash = _amw_hash_mix(hash, value->minute);
+        hash = _amw_hash_mix(hash, value->second);
+        hash = _amw_hash_mix(hash, value->nanosecond);
+        return _amw_hash_mix(hash, (uint64_t) value->gmt_offset);
+
+    } else if (uw_is_timestamp(value)) {
+        uint64_t hash = _amw_hash_mix(AMW_COMPILED_TIMESTAMP, value->ts_seconds);
+        return _amw_hash_mix(hash, value->ts_nanoseconds);
+
+    } else if (uw_is_array(value)) {
+        uint64_t hash = AMW_HASH_LIST_START;
+        unsigned length = uw_array_length(value);
+        for (unsigned i = 0; i < length; i++) {{
+            UwValue item = uw_array_item(value, i);
+            hash = _amw_hash_list_item(hash, amw_value_hash(&item));
+        }}
+        return _amw_hash_list_end(hash, length);
+
+    } else if (uw_is_map(value)) {
+        uint64_t hash = AMW_HASH_MAP_START;
+        unsigned length = uw_map_length(value);
+        for (unsigned i = 0; i < length; i++) {{
+            UwValue key = UwNull();
+            UwValue item = UwNull();
+            uw_map_item(value, i, &key, &item);
+            hash = _amw_hash_map_entry(hash, amw_value_hash(&key), amw_value_hash(&item));
+        }}
+        return _amw_hash_map_end(hash, length);
+
+    } else if (value->type_id == UwTypeId_AmwDeferred) {
+        UwValue resolved = amw_resolve(value);
+        if (uw_error(&resolved)) {
+            return 0;
+        }
+        return amw_value_hash(&resolved);
+
+    } else {
+        return _amw_hash_mix(0xff, value->type_id);
+    }
+}
+
+uint64_t _amw_hash_list_item(uint64_t hash, uint64_t item_hash)
+{
+    return _amw_hash_mix(hash, item_hash);
+}
+
+uint64_t _amw_hash_list_end(uint64_t hash, unsigned length)
+{
+    return _amw_hash_mix(hash, length);
+}
+
+uint64_t _amw_hash_map_entry(uint64_t hash, uint64_t key_hash, uint64_t value_hash)
+{
+    // sum of entry hashes does not depend on the order of entries
+    return hash + _amw_hash_mix(key_hash, value_hash);
+}
+
+uint64_t _amw_hash_map_end(uint64_t hash, unsigned length)
+{
+    return _amw_hash_mix(_amw_hash_mix(AMW_COMPILED_MAP, length), hash);
+}
@@ -26,14 +26,15 @@ static UwResult skip_spaces(AmwParser* parser, unsigned* pos, unsigned source_li
             }
         }
         // read next line
-        UwValue status = _amw_read_block_line(parser);
-        if (_amw_end_of_block(&status)) {
+        AmwReadResult status = _amw_read_block_line(parser);
+        if (status == AMW_END_OF_BLOCK) {
             UwValue error = amw_parser_error(parser, parser->current_indent, "Unexpected end of block");
             if (error.status_code == AMW_PARSE_ERROR) {
                 _uw_set_status_location(&error, __FILE__, source_line);
             }
             return uw_move(&error);
         }
+        _amw_return_if_read_error(parser, status);
         *pos = parser->current_indent;
     }
 }
@@ -69,6 +70,42 @@ static UwResult parse_string(AmwParser* parser, unsigned start_pos, unsigned* en
     return amw_parser_error(parser, parser->current_indent, "String has no closing quote");
 }
 
+static inline bool streaming(AmwParser* parser)
+/*
+ * Return true if items of the array or object being parsed
+ * are passed to event handler, see AmwEventHandler.
+ */
+{
+    return parser->handler && parser->num_frames == 0 && parser->json_depth == 2;
+}
+
+static UwResult add_item(AmwParser* parser, UwValuePtr result, UwValuePtr key, UwValuePtr value)
+/*
+ * Add item to array if `key` is nullptr, or member to object.
+ */
+{
+    if (streaming(parser)) {
+        return parser->handler->entry(parser->handler_ctx, key, value);
+    }
+    if (parser->validate_only) {
+        return UwOK();
+    }
+    if (key) {
+        return uw_map_update(result, key, value);
+    }
+    return uw_array_append(result, value);
+}
+
+static UwResult end_container(AmwParser* parser, UwValuePtr result)
+{
+    if (streaming(parser)) {
+        UwValue status = parser->handler->end(parser->handler_ctx);
+        uw_return_if_error(&status);
+    }
+    parser->json_depth--;
+    return uw_move(result);
+}
+
 static UwResult parse_array(AmwParser* parser, unsigned start_pos, unsigned* end_pos)
 /*
  * `start_pos` points to the next character after opening square bracket
@@ -76,24 +113,29 @@ static UwResult parse_array(AmwParser* parser, unsigned start_pos, unsigned* end
 {
     parser->json_depth++;
 
-    UwValue result = UwArray();
+    UwValue result = parser->validate_only? UwNull() : UwArray();
     uw_return_if_error(&result);
 
+    if (streaming(parser)) {
+        UwValue status = parser->handler->begin(parser->handler_ctx, false);
+        uw_return_if_error(&status);
+    }
+
     UwValue chr = skip_spaces(parser, &start_pos, __LINE__);
     uw_return_if_error(&chr);
 
     if (chr.unsigned_value == ']') {
         // empty array
         *end_pos = start_pos + 1;
-        parser->json_depth--;
-        return uw_move(&result);
+        return end_container(parser, &result);
     }
 
     // parse first item
     UwValue first_item = _amw_parse_json_value(parser, start_pos, &start_pos);
     uw_return_if_error(&first_item);
 
-    uw_expect_ok( uw_array_append(&result, &first_item) );
+    UwValue status = add_item(parser, &result, nullptr, &first_item);
+    uw_return_if_error(&status);
 
     // parse subsequent items
     for (;;) {{
@@ -103,8 +145,7 @@ static UwResult parse_array(AmwParser* parser, unsigned start_pos, unsigned* end
         if (chr.unsigned_value == ']') {
             // done
             *end_pos = start_pos + 1;
-            parser->json_depth--;
-            return uw_move(&result);
+            return end_container(parser, &result);
         }
         if (chr.unsigned_value != ',') {
             return amw_parser_error(parser, parser->current_indent, "Array items must be separated with comma");
@@ -112,7 +153,8 @@ static UwResult parse_array(AmwParser* parser, unsigned start_pos, unsigned* end
         UwValue item = _amw_parse_json_value(parser, start_pos + 1, &start_pos);
         uw_return_if_error(&item);
 
-        uw_expect_ok( uw_array_append(&result, &item) );
+        UwValue status = add_item(parser, &result, nullptr, &item);
+        uw_return_if_error(&status);
     }}
 }
 
@@ -125,6 +167,9 @@ static UwResult parse_object_member(AmwParser* parser, unsigned* pos, UwValuePtr
 {
     UwValue key = parse_string(parser, *pos, pos);
     uw_return_if_error(&key);
+    UwValue interned = _amw_intern_key(parser, &key);
+    uw_return_if_error(&interned);
+    key = uw_move(&interned);
 
     UwValue chr = skip_spaces(parser, pos, __LINE__);
     uw_return_if_error(&chr);
@@ -138,7 +183,7 @@ static UwResult parse_object_member(AmwParser* parser, unsigned* pos, UwValuePtr
     UwValue value = _amw_parse_json_value(parser, *pos, pos);
     uw_return_if_error(&value);
 
-    return uw_map_update(result, &key, &value);
+    return add_item(parser, result, &key, &value);
 }
 
 static UwResult parse_object(AmwParser* parser, unsigned start_pos, unsigned* end_pos)
@@ -148,17 +193,21 @@ static UwResult parse_object(AmwParser* parser, unsigned start_pos, unsigned* en
 {
     parser->json_depth++;
 
-    UwValue result = UwMap();
+    UwValue result = parser->validate_only? UwNull() : UwMap();
     uw_return_if_error(&result);
 
+    if (streaming(parser)) {
+        UwValue status = parser->handler->begin(parser->handler_ctx, true);
+        uw_return_if_error(&status);
+    }
+
     UwValue chr = skip_spaces(parser, &start_pos, __LINE__);
     uw_return_if_error(&chr);
 
     if (chr.unsigned_value == '}') {
         // empty object
         *end_pos = start_pos + 1;
-        parser->json_depth--;
-        return uw_move(&result);
+        return end_container(parser, &result);
     }
 
     // parse first member
@@ -173,8 +222,7 @@ static UwResult parse_object(AmwParser* parser, unsigned start_pos, unsigned* en
         if (chr.unsigned_value == '}') {
             // done
             *end_pos = start_pos + 1;
-            parser->json_depth--;
-            return uw_move(&result);
+            return end_container(parser, &result);
         }
         if (chr.unsigned_value != ',') {
             return amw_parser_error(parser, parser->current_indent, "Object members must be separated with comma");
@@ -239,8 +287,9 @@ UwResult _amw_json_parser_func(AmwParser* parser)
     if (_amw_comment_or_end_of_line(parser, end_pos)) {
 
         // make sure current block has no more data
-        UwValue status = _amw_read_block_line(parser);
-        if (!_amw_end_of_block(&status)) {
+        AmwReadResult status = _amw_read_block_line(parser);
+        _amw_return_if_read_error(parser, status);
+        if (status != AMW_END_OF_BLOCK) {
             return amw_parser_error(parser, parser->current_indent, garbage);
         }
     } else {
@@ -249,15 +298,14 @@ UwResult _amw_json_parser_func(AmwParser* parser)
     return uw_move(&result);
 }
 
-UwResult amw_parse_json(UwValuePtr markup)
+static UwResult parse_json_markup(AmwParser* parser)
+/*
+ * Parse markup the parser was created for as pure JSON.
+ */
 {
-    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(markup);
-    if (!parser) {
-        return UwOOM();
-    }
     // read first line to prepare for parsing and to detect EOF
-    UwValue status = _amw_read_block_line(parser);
-    uw_return_if_error(&status);
+    AmwReadResult status = _amw_read_block_line(parser);
+    _amw_return_if_read_error(parser, status);
 
     // parse root value
     unsigned end_pos;
@@ -276,8 +324,35 @@ UwResult amw_parse_json(UwValuePtr markup)
     if (parser->eof) {
         // all right, no op
     } else {
-        uw_return_if_error(&status);
+        _amw_return_if_read_error(parser, status);
         return amw_parser_error(parser, parser->current_indent, extra_data);
     }
     return uw_move(&result);
 }
+
+UwResult amw_parse_json(UwValuePtr markup)
+{
+    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(markup);
+    if (!parser) {
+        return UwOOM();
+    }
+    return parse_json_markup(parser);
+}
+
+UwResult amw_parser_parse_json(AmwParser* parser)
+{
+    return parse_json_markup(parser);
+}
+
+UwResult amw_validate_json(UwValuePtr markup)
+{
+    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(markup);
+    if (!parser) {
+        return UwOOM();
+    }
+    parser->validate_only = true;
+
+    UwValue result = parse_json_markup(parser);
+    uw_return_if_error(&result);
+    return UwOK();
+}
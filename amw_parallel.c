@@ -0,0 +1,329 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include <amw.h>
+
+#define PARTS_PER_THREAD  4
+#define MAX_THREADS       256
+
+typedef struct {
+    _UwValue  lines;     // lines of the part followed by the first line of the next part
+    unsigned  line_number_offset;
+    bool      last_part;
+    _UwValue  key_intern;  // keys of the part, null if interning is off
+    _UwValue  result;
+} Part;
+
+typedef struct {
+    Part*        parts;
+    unsigned     num_parts;
+    bool         is_map;
+    atomic_uint  next_part;
+} Job;
+
+static void release_job(Job* job)
+{
+    if (job->parts) {
+        for (unsigned i = 0; i < job->num_parts; i++) {
+            uw_destroy(&job->parts[i].lines);
+            uw_destroy(&job->parts[i].key_intern);
+            uw_destroy(&job->parts[i].result);
+        }
+        release((void**) &job->parts, job->num_parts * sizeof(Part));
+    }
+}
+
+static UwResult read_all_lines(UwValuePtr markup)
+{
+    UwValue lines = UwArray();
+    uw_return_if_error(&lines);
+
+    UwValue status = uw_start_read_lines(markup);
+    uw_return_if_error(&status);
+
+    UwValue line = uw_create_empty_string(250, 1);
+    uw_return_if_error(&line);
+
+    for (;;) {{
+        UwValue status = uw_read_line_inplace(markup, &line);
+        if (uw_eof(&status)) {
+            return uw_move(&lines);
+        }
+        uw_return_if_error(&status);
+
+        UwValue copy = uw_substr(&line, 0, UINT_MAX);
+        uw_return_if_error(&copy);
+        uw_expect_ok( uw_array_append(&lines, &copy) );
+    }}
+}
+
+static bool is_list_item(UwValuePtr line)
+/*
+ * Return true if the line starts with hyphen followed by space or end of line.
+ */
+{
+    if (uw_char_at(line, 0) != '-') {
+        return false;
+    }
+    return !uw_string_index_valid(line, 1) || uw_isspace(uw_char_at(line, 1));
+}
+
+static UwResult make_part(Part* part, UwValuePtr lines, unsigned start, unsigned end)
+/*
+ * Initialize part with lines from `start` to `end` and the first line of the next part.
+ */
+{
+    part->lines = UwArray();
+    uw_return_if_error(&part->lines);
+
+    part->line_number_offset = start;
+    part->last_part = (end == uw_array_length(lines));
+
+    for (unsigned i = start; i < end; i++) {{
+        UwValue line = uw_array_item(lines, i);
+        uw_expect_ok( uw_array_append(&part->lines, &line) );
+    }}
+    if (!part->last_part) {
+        // this line is also the first line of the next part
+        // which is parsed in another thread, so make a copy
+        UwValue line = uw_array_item(lines, end);
+        UwValue copy = uw_substr(&line, 0, UINT_MAX);
+        uw_return_if_error(&copy);
+        uw_expect_ok( uw_array_append(&part->lines, &copy) );
+    }
+    return UwOK();
+}
+
+static UwResult parse_part(Part* part, bool is_map)
+{
+    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(&part->lines);
+    if (!parser) {
+        return UwOOM();
+    }
+    parser->line_number_offset = part->line_number_offset;
+    parser->key_intern = uw_clone(&part->key_intern);
+
+    // read first line, this skips leading comments of the first part
+    AmwReadResult status = _amw_read_block_line(parser);
+    _amw_return_if_read_error(parser, status);
+
+    return _amw_parse_part(parser, is_map, part->last_part);
+}
+
+static void* worker(void* arg)
+{
+    Job* job = arg;
+    for (;;) {
+        unsigned i = atomic_fetch_add(&job->next_part, 1);
+        if (i >= job->num_parts) {
+            return nullptr;
+        }
+        job->parts[i].result = parse_part(&job->parts[i], job->is_map);
+    }
+}
+
+static UwResult merge_keys(UwValuePtr key_intern, UwValuePtr part_keys)
+/*
+ * Add keys interned by the part to the caller's table.
+ */
+{
+    unsigned n = uw_map_length(part_keys);
+    for (unsigned i = 0; i < n; i++) {{
+        UwValue key = UwNull();
+        UwValue value = UwNull();
+        uw_map_item(part_keys, i, &key, &value);
+        if (!uw_map_has_key(key_intern, &key)) {
+            UwValue status = uw_map_update(key_intern, &key, &key);
+            uw_return_if_error(&status);
+        }
+    }}
+    return UwOK();
+}
+
+static UwResult merge_part(UwValuePtr result, Part* part, bool is_map, UwValuePtr key_intern)
+/*
+ * Append entries of the part to the result.
+ * If `key_intern` is not null, merge keys of the part into it
+ * and replace top-level keys with instances from the table.
+ */
+{
+    UwValuePtr part_result = &part->result;
+    if (key_intern) {
+        UwValue status = merge_keys(key_intern, &part->key_intern);
+        uw_return_if_error(&status);
+    }
+    if (is_map) {
+        unsigned n = uw_map_length(part_result);
+        for (unsigned i = 0; i < n; i++) {{
+            UwValue key = UwNull();
+            UwValue value = UwNull();
+            uw_map_item(part_result, i, &key, &value);
+            if (key_intern && uw_is_string(&key)) {
+                UwValue interned = uw_map_get(key_intern, &key);
+                if (uw_is_string(&interned)) {
+                    uw_destroy(&key);
+                    key = uw_move(&interned);
+                }
+            }
+            UwValue status = uw_map_update(result, &key, &value);
+            uw_return_if_error(&status);
+        }}
+    } else {
+        unsigned n = uw_array_length(part_result);
+        for (unsigned i = 0; i < n; i++) {{
+            UwValue item = uw_array_item(part_result, i);
+            UwValue status = uw_array_append(result, &item);
+            uw_return_if_error(&status);
+        }}
+    }
+    return UwOK();
+}
+
+static UwResult parse_sequential(UwValuePtr lines, UwValuePtr key_intern)
+{
+    return key_intern? amw_parse_interned(lines, key_intern) : amw_parse(lines);
+}
+
+static UwResult parse_parallel(UwValuePtr markup, unsigned num_threads, UwValuePtr key_intern)
+/*
+ * Implementation of amw_parse_parallel and amw_parse_parallel_interned.
+ * `key_intern` is null if keys are not interned.
+ */
+{
+    UwValue lines = UwNull();
+    if (uw_is_array(markup)) {
+        lines = uw_clone(markup);
+    } else {
+        lines = read_all_lines(markup);
+        uw_return_if_error(&lines);
+    }
+
+    if (num_threads == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = (n > 0)? n : 1;
+    }
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+
+    /*
+     * Find top-level lines. Nested blocks always have greater indent,
+     * so each top-level line starts a map entry or list item.
+     */
+    UwValue top_lines = UwArray();
+    uw_return_if_error(&top_lines);
+
+    unsigned num_lines = uw_array_length(&lines);
+    bool first_line = true;
+    for (unsigned i = 0; i < num_lines; i++) {{
+        UwValue line = uw_array_item(&lines, i);
+        unsigned indent;
+        if (!_amw_significant_line(&line, &indent)) {
+            continue;
+        }
+        if (indent == 0) {
+            UwValue n = UwUnsigned(i);
+            uw_expect_ok( uw_array_append(&top_lines, &n) );
+        } else if (first_line) {
+            // indented top-level value, nested blocks may start at the same indent
+            return parse_sequential(&lines, key_intern);
+        }
+        first_line = false;
+    }}
+
+    unsigned num_top_lines = uw_array_length(&top_lines);
+    if (num_threads < 2 || num_top_lines < 2) {
+        return parse_sequential(&lines, key_intern);
+    }
+
+    // split markup
+
+    [[ gnu::cleanup(release_job) ]] Job job = {};
+
+    job.num_parts = num_threads * PARTS_PER_THREAD;
+    if (job.num_parts > num_top_lines) {
+        job.num_parts = num_top_lines;
+    }
+    job.parts = allocate(job.num_parts * sizeof(Part), true);
+    if (!job.parts) {
+        return UwOOM();
+    }
+    for (unsigned i = 0; i < job.num_parts; i++) {
+        job.parts[i].lines = UwNull();
+        job.parts[i].key_intern = UwNull();
+        job.parts[i].result = UwNull();
+    }
+    {
+        UwValue first_top_line = uw_array_item(&top_lines, 0);
+        UwValue line = uw_array_item(&lines, first_top_line.unsigned_value);
+        job.is_map = !is_list_item(&line);
+    }
+    unsigned start = 0;  // the first part includes leading comments
+    for (unsigned i = 0; i < job.num_parts; i++) {{
+        unsigned end = num_lines;
+        if (i + 1 < job.num_parts) {
+            UwValue next_top_line = uw_array_item(&top_lines, (i + 1) * num_top_lines / job.num_parts);
+            end = next_top_line.unsigned_value;
+        }
+        UwValue status = make_part(&job.parts[i], &lines, start, end);
+        uw_return_if_error(&status);
+        if (key_intern) {
+            // parts are parsed concurrently, each one interns keys in its own table
+            job.parts[i].key_intern = UwMap();
+            uw_return_if_error(&job.parts[i].key_intern);
+        }
+        start = end;
+    }}
+
+    // parse parts
+
+    if (num_threads > job.num_parts) {
+        num_threads = job.num_parts;
+    }
+    pthread_t threads[num_threads];
+    unsigned num_started = 0;
+    while (num_started < num_threads) {
+        if (pthread_create(&threads[num_started], nullptr, worker, &job) != 0) {
+            break;
+        }
+        num_started++;
+    }
+    if (num_started == 0) {
+        worker(&job);
+    }
+    for (unsigned i = 0; i < num_started; i++) {
+        pthread_join(threads[i], nullptr);
+    }
+
+    // assemble the result in order
+
+    UwValue result = job.is_map? UwMap() : UwArray();
+    uw_return_if_error(&result);
+
+    for (unsigned i = 0; i < job.num_parts; i++) {{
+        UwValuePtr part_result = &job.parts[i].result;
+        if (uw_error(part_result)) {
+            if (i == 0) {
+                // not a map or list, or the first part is bad;
+                // parse sequentially to get exactly the same result or error
+                return parse_sequential(&lines, key_intern);
+            }
+            return uw_move(part_result);
+        }
+        UwValue status = merge_part(&result, &job.parts[i], job.is_map, key_intern);
+        uw_return_if_error(&status);
+    }}
+    return uw_move(&result);
+}
+
+UwResult amw_parse_parallel(UwValuePtr markup, unsigned num_threads)
+{
+    return parse_parallel(markup, num_threads, nullptr);
+}
+
+UwResult amw_parse_parallel_interned(UwValuePtr markup, unsigned num_threads, UwValuePtr key_intern)
+{
+    return parse_parallel(markup, num_threads, key_intern);
+}
@@ -1,5 +1,6 @@
 #include <errno.h>
 #include <limits.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -55,8 +56,45 @@
 #   define TRACE(...)
 #endif
 
+// parser stack frame, see push_frame
+struct _AmwFrame {
+    _UwValue  container;     // list or map
+    unsigned  indent;        // indent of list items or map keys
+    unsigned  block_indent;  // indent of the block the container belongs to
+    bool      is_map;
+    bool      nested_block;  // current item is parsed in nested block started by start_item
+
+    // structural hash, see amw_parse_hashed
+    uint64_t  hash;
+    unsigned  count;
+    uint64_t  key_hash;
+
+    // pending map entry
+    _UwValue  key;
+    AmwBlockParserFunc convspec;  // parser function for conversion specifier, if any
+    unsigned  value_pos;
+};
+
+// custom conversion specifier, see amw_set_custom_parser
+struct _AmwConvspec {
+    uint64_t  hash;    // FNV-1a of code points
+    unsigned  length;
+    char32_t* name;
+    AmwBlockParserFunc parser_func;
+};
+
+// parser functions for conversion specifiers;
+// registries are immutable once shared, see amw_set_custom_parser
+struct _AmwRegistry {
+    atomic_uint  refcount;  // zero for default_registry which is never released
+    AmwBlockParserFunc builtin_parsers[AMW_NUM_BUILTIN_CONVSPECS];
+    AmwConvspec* convspecs;
+    unsigned  num_convspecs;
+    unsigned  convspecs_capacity;
+};
+
 // forward declarations
-static UwResult parse_value(AmwParser* parser, unsigned* nested_value_pos, UwValuePtr convspec);
+static UwResult parse_value(AmwParser* parser, unsigned* nested_value_pos, AmwBlockParserFunc* convspec);
 static UwResult value_parser_func(AmwParser* parser);
 static UwResult parse_raw_value(AmwParser* parser);
 static UwResult parse_literal_string(AmwParser* parser);
@@ -64,6 +102,38 @@ static UwResult parse_folded_string(AmwParser* parser);
 static UwResult parse_datetime(AmwParser* parser);
 static UwResult parse_timestamp(AmwParser* parser);
 
+// built-in conversion specifiers
+enum {
+    CONVSPEC_RAW = 0,
+    CONVSPEC_LITERAL,
+    CONVSPEC_FOLDED,
+    CONVSPEC_DATETIME,
+    CONVSPEC_TIMESTAMP,
+    CONVSPEC_JSON
+};
+
+static char* builtin_convspecs[AMW_NUM_BUILTIN_CONVSPECS] = {
+    [CONVSPEC_RAW]       = "raw",
+    [CONVSPEC_LITERAL]   = "literal",
+    [CONVSPEC_FOLDED]    = "folded",
+    [CONVSPEC_DATETIME]  = "datetime",
+    [CONVSPEC_TIMESTAMP] = "timestamp",
+    [CONVSPEC_JSON]      = "json"
+};
+
+static AmwRegistry default_registry = {
+    .builtin_parsers = {
+        [CONVSPEC_RAW]       = parse_raw_value,
+        [CONVSPEC_LITERAL]   = parse_literal_string,
+        [CONVSPEC_FOLDED]    = parse_folded_string,
+        [CONVSPEC_DATETIME]  = parse_datetime,
+        [CONVSPEC_TIMESTAMP] = parse_timestamp,
+        [CONVSPEC_JSON]      = _amw_json_parser_func
+    }
+};
+
+static void pop_frame(AmwParser* parser);
+
 static char number_terminators[] = { AMW_COMMENT, ':', 0 };
 
 
@@ -76,34 +146,37 @@ AmwParser* amw_create_parser(UwValuePtr markup)
     parser->markup = uw_clone(markup);
 
     parser->blocklevel = 1;
-    parser->max_blocklevel = AMW_MAX_RECURSION_DEPTH;
+    parser->max_blocklevel = AMW_MAX_BLOCK_DEPTH;
 
     parser->json_depth = 1;
     parser->max_json_depth = AMW_MAX_RECURSION_DEPTH;
 
     parser->skip_comments = true;
+    parser->read_status = UwNull();
+    parser->key_intern = UwNull();
+    parser->section_hashes = UwNull();
 
     UwValue status = UwNull();
 
+    parser->registry = &default_registry;
+
     parser->current_line = uw_create_empty_string(DEFAULT_LINE_CAPACITY, 1);
     if (uw_error(&parser->current_line)) {
         goto error;
     }
-    parser->custom_parsers = UwMap(
-        UwCharPtr("raw"),       UwPtr((void*) parse_raw_value),
-        UwCharPtr("literal"),   UwPtr((void*) parse_literal_string),
-        UwCharPtr("folded"),    UwPtr((void*) parse_folded_string),
-        UwCharPtr("datetime"),  UwPtr((void*) parse_datetime),
-        UwCharPtr("timestamp"), UwPtr((void*) parse_timestamp),
-        UwCharPtr("json"),      UwPtr((void*) _amw_json_parser_func)
-    );
-    if (uw_error(&parser->custom_parsers)) {
+    parser->unread_line = uw_create_empty_string(DEFAULT_LINE_CAPACITY, 1);
+    if (uw_error(&parser->unread_line)) {
         goto error;
     }
 
-    status = uw_start_read_lines(markup);
-    if (uw_error(&status)) {
-        goto error;
+    if (uw_is_array(markup)) {
+        // read lines from array, see read_line
+        parser->end_line_index = uw_array_length(markup);
+    } else {
+        status = uw_start_read_lines(markup);
+        if (uw_error(&status)) {
+            goto error;
+        }
     }
 
     return parser;
@@ -116,30 +189,223 @@ error:
 void amw_delete_parser(AmwParser** parser_ptr)
 {
     AmwParser* parser = *parser_ptr;
+    if (!parser) {
+        return;
+    }
     *parser_ptr = nullptr;
+    while (parser->num_frames) {
+        pop_frame(parser);
+    }
+    if (parser->frames) {
+        release((void**) &parser->frames, parser->frames_capacity * sizeof(AmwFrame));
+    }
     uw_destroy(&parser->markup);
     uw_destroy(&parser->current_line);
-    uw_destroy(&parser->custom_parsers);
+    uw_destroy(&parser->unread_line);
+    _amw_registry_unref(&parser->registry);
+    uw_destroy(&parser->read_status);
+    uw_destroy(&parser->key_intern);
+    uw_destroy(&parser->section_hashes);
     release((void**) &parser, sizeof(AmwParser));
 }
 
-UwResult amw_set_custom_parser(AmwParser* parser, char* convspec, AmwBlockParserFunc parser_func)
+static int lookup_builtin_convspec(UwValuePtr str, unsigned start_pos, unsigned end_pos)
+/*
+ * Built-in conversion specifiers have distinct lengths,
+ * so the length is a perfect hash and one comparison is enough.
+ *
+ * Return index in builtin_convspecs or -1 if not found.
+ */
+{
+    int index;
+    switch (end_pos - start_pos) {
+        case 3: index = CONVSPEC_RAW;       break;
+        case 4: index = CONVSPEC_JSON;      break;
+        case 6: index = CONVSPEC_FOLDED;    break;
+        case 7: index = CONVSPEC_LITERAL;   break;
+        case 8: index = CONVSPEC_DATETIME;  break;
+        case 9: index = CONVSPEC_TIMESTAMP; break;
+        default: return -1;
+    }
+    if (uw_substring_eq(str, start_pos, end_pos, builtin_convspecs[index])) {
+        return index;
+    }
+    return -1;
+}
+
+static bool convspec_eq(AmwConvspec* convspec, UwValuePtr str, unsigned start_pos)
+{
+    for (unsigned i = 0; i < convspec->length; i++) {
+        if (convspec->name[i] != uw_char_at(str, start_pos + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static AmwBlockParserFunc lookup_convspec(AmwParser* parser, UwValuePtr str, unsigned start_pos, unsigned end_pos)
+/*
+ * Find parser function for conversion specifier in `str` without making substring.
+ * Return nullptr if not found.
+ */
+{
+    AmwRegistry* registry = parser->registry;
+
+    int builtin = lookup_builtin_convspec(str, start_pos, end_pos);
+    if (builtin >= 0) {
+        return registry->builtin_parsers[builtin];
+    }
+    if (registry->num_convspecs == 0) {
+        return nullptr;
+    }
+    unsigned length = end_pos - start_pos;
+    uint64_t hash = _amw_hash_substring(str, start_pos, end_pos);
+    for (unsigned i = 0; i < registry->num_convspecs; i++) {
+        AmwConvspec* convspec = &registry->convspecs[i];
+        if (convspec->hash == hash && convspec->length == length && convspec_eq(convspec, str, start_pos)) {
+            return convspec->parser_func;
+        }
+    }
+    return nullptr;
+}
+
+AmwRegistry* _amw_registry_ref(AmwRegistry* registry)
+{
+    if (registry != &default_registry) {
+        atomic_fetch_add(&registry->refcount, 1);
+    }
+    return registry;
+}
+
+void _amw_registry_unref(AmwRegistry** registry_ptr)
+{
+    AmwRegistry* registry = *registry_ptr;
+    if (!registry) {
+        return;
+    }
+    *registry_ptr = nullptr;
+    if (registry == &default_registry) {
+        return;
+    }
+    if (atomic_fetch_sub(&registry->refcount, 1) != 1) {
+        return;
+    }
+    if (registry->convspecs) {
+        for (unsigned i = 0; i < registry->num_convspecs; i++) {
+            AmwConvspec* convspec = &registry->convspecs[i];
+            release((void**) &convspec->name, (convspec->length + 1) * sizeof(char32_t));
+        }
+        release((void**) &registry->convspecs, registry->convspecs_capacity * sizeof(AmwConvspec));
+    }
+    release((void**) &registry, sizeof(AmwRegistry));
+}
+
+static bool grow_convspecs(AmwRegistry* registry, unsigned capacity)
+{
+    AmwConvspec* new_convspecs = allocate(capacity * sizeof(AmwConvspec), false);
+    if (!new_convspecs) {
+        return false;
+    }
+    if (registry->convspecs) {
+        memcpy(new_convspecs, registry->convspecs, registry->num_convspecs * sizeof(AmwConvspec));
+        release((void**) &registry->convspecs, registry->convspecs_capacity * sizeof(AmwConvspec));
+    }
+    registry->convspecs = new_convspecs;
+    registry->convspecs_capacity = capacity;
+    return true;
+}
+
+static char32_t* copy_convspec_name(char32_t* name, unsigned length)
 {
-    UWDECL_CharPtr(key, convspec);
-    UWDECL_Ptr(value, (void*) parser_func);
-    return uw_map_update(&parser->custom_parsers, &key, &value);
+    char32_t* copy = allocate((length + 1) * sizeof(char32_t), false);
+    if (copy) {
+        memcpy(copy, name, (length + 1) * sizeof(char32_t));
+    }
+    return copy;
 }
 
-static inline bool have_custom_parser(AmwParser* parser, UwValuePtr convspec)
+static AmwRegistry* writable_registry(AmwParser* parser)
+/*
+ * Return registry of the parser that can be modified,
+ * making private copy if the registry is shared.
+ */
 {
-    return uw_map_has_key(&parser->custom_parsers, convspec);
+    AmwRegistry* registry = parser->registry;
+    if (registry != &default_registry && atomic_load(&registry->refcount) == 1) {
+        return registry;
+    }
+    AmwRegistry* copy = allocate(sizeof(AmwRegistry), true);
+    if (!copy) {
+        return nullptr;
+    }
+    atomic_init(&copy->refcount, 1);
+    memcpy(copy->builtin_parsers, registry->builtin_parsers, sizeof(copy->builtin_parsers));
+
+    if (registry->num_convspecs) {
+        if (!grow_convspecs(copy, registry->num_convspecs)) {
+            _amw_registry_unref(&copy);
+            return nullptr;
+        }
+        for (unsigned i = 0; i < registry->num_convspecs; i++) {
+            AmwConvspec* src = &registry->convspecs[i];
+            AmwConvspec* dest = &copy->convspecs[i];
+            *dest = *src;
+            dest->name = copy_convspec_name(src->name, src->length);
+            if (!dest->name) {
+                _amw_registry_unref(&copy);
+                return nullptr;
+            }
+            copy->num_convspecs++;
+        }
+    }
+    _amw_registry_unref(&parser->registry);
+    parser->registry = copy;
+    return copy;
 }
 
-static inline AmwBlockParserFunc get_custom_parser(AmwParser* parser, UwValuePtr convspec)
+UwResult amw_set_custom_parser(AmwParser* parser, char* convspec, AmwBlockParserFunc parser_func)
 {
-    UwValue parser_func = uw_map_get(&parser->custom_parsers, convspec);
-    uw_assert_ptr(&parser_func);
-    return (AmwBlockParserFunc) (parser_func.ptr);
+    UwValue name = uw_create_string(convspec);
+    uw_return_if_error(&name);
+
+    unsigned length = uw_strlen(&name);
+    uint64_t hash = _amw_hash_substring(&name, 0, length);
+    int builtin = lookup_builtin_convspec(&name, 0, length);
+
+    AmwRegistry* registry = writable_registry(parser);
+    if (!registry) {
+        return UwOOM();
+    }
+    if (builtin >= 0) {
+        registry->builtin_parsers[builtin] = parser_func;
+        return UwOK();
+    }
+    for (unsigned i = 0; i < registry->num_convspecs; i++) {
+        AmwConvspec* existing = &registry->convspecs[i];
+        if (existing->hash == hash && existing->length == length && convspec_eq(existing, &name, 0)) {
+            existing->parser_func = parser_func;
+            return UwOK();
+        }
+    }
+    if (registry->num_convspecs == registry->convspecs_capacity) {
+        if (!grow_convspecs(registry, registry->convspecs_capacity + 8)) {
+            return UwOOM();
+        }
+    }
+    char32_t* chars = allocate((length + 1) * sizeof(char32_t), false);
+    if (!chars) {
+        return UwOOM();
+    }
+    for (unsigned i = 0; i < length; i++) {
+        chars[i] = uw_char_at(&name, i);
+    }
+    chars[length] = 0;
+    AmwConvspec* new_convspec = &registry->convspecs[registry->num_convspecs++];
+    new_convspec->hash = hash;
+    new_convspec->length = length;
+    new_convspec->name = chars;
+    new_convspec->parser_func = parser_func;
+    return UwOK();
 }
 
 UwResult _amw_parser_error(AmwParser* parser, char* source_file_name, unsigned source_line_number,
@@ -165,11 +431,6 @@ UwResult _amw_parser_error(AmwParser* parser, char* source_file_name, unsigned s
     return uw_move(&status);
 }
 
-bool _amw_end_of_block(UwValuePtr status)
-{
-    return (status->type_id == UwTypeId_Status) && (status->status_code == AMW_END_OF_BLOCK);
-}
-
 static inline bool end_of_line(UwValuePtr str, unsigned position)
 /*
  * Return true if position is beyond end of line.
@@ -187,27 +448,166 @@ static inline bool isspace_or_eol_at(UwValuePtr str, unsigned position)
     }
 }
 
-static UwResult read_line(AmwParser* parser)
+static AmwReadResult read_error(AmwParser* parser, UwValuePtr status)
 /*
- * Read line into parser->current line and strip trailing spaces.
- * Return status.
+ * Save error status in the parser.
+ */
+{
+    uw_destroy(&parser->read_status);
+    parser->read_status = uw_move(status);
+    return AMW_READ_ERROR;
+}
+
+static UwResult refill_lines(AmwParser* parser)
+/*
+ * Drop lines already read from markup array, except the last one
+ * which may be unread, and append more lines with `read_lines`.
+ *
+ * Return UW_ERROR_EOF status if there are no more lines.
  */
 {
-    UwValue status = uw_read_line_inplace(&parser->markup, &parser->current_line);
+    UwValuePtr lines = &parser->markup;
+    if (parser->line_index > 1) {
+        unsigned n = parser->line_index - 1;
+        uw_array_del(lines, 0, n);
+        parser->line_index -= n;
+        parser->line_number_offset += n;
+    }
+    UwValue status = parser->read_lines(parser->read_lines_ctx, lines);
     uw_return_if_error(&status);
 
+    parser->end_line_index = uw_array_length(lines);
+    if (parser->line_index >= parser->end_line_index) {
+        return UwStatus(UW_ERROR_EOF);
+    }
+    return UwOK();
+}
+
+static inline void swap_lines(AmwParser* parser)
+{
+    _UwValue line = parser->current_line;
+    parser->current_line = parser->unread_line;
+    parser->unread_line = line;
+}
+
+static AmwReadResult read_line(AmwParser* parser)
+/*
+ * Read line into parser->current line and strip trailing spaces.
+ * Return AMW_END_OF_BLOCK if there are no more lines in the markup.
+ */
+{
+    if (parser->have_unread_line) {
+        // line pushed back by unread_line is already stripped and measured
+        parser->have_unread_line = false;
+        swap_lines(parser);
+        parser->current_indent = parser->unread_indent;
+        parser->line_number = parser->unread_line_number;
+        if (uw_is_array(&parser->markup)) {
+            parser->line_index++;
+        }
+        return AMW_LINE_READ;
+    }
+    if (uw_is_array(&parser->markup)) {
+        if (parser->line_index >= parser->end_line_index) {
+            if (!parser->read_lines) {
+                return AMW_END_OF_BLOCK;
+            }
+            UwValue status = refill_lines(parser);
+            if (uw_eof(&status)) {
+                return AMW_END_OF_BLOCK;
+            }
+            if (uw_error(&status)) {
+                return read_error(parser, &status);
+            }
+        }
+        // copy line because current_line is modified in place
+        UwValue line = uw_array_item(&parser->markup, parser->line_index);
+        uw_string_truncate(&parser->current_line, 0);
+        if (!uw_string_append(&parser->current_line, &line)) {
+            UwValue status = UwOOM();
+            return read_error(parser, &status);
+        }
+        parser->line_index++;
+        parser->line_number = parser->line_number_offset + parser->line_index;
+    } else {
+        UwValue status = uw_read_line_inplace(&parser->markup, &parser->current_line);
+        if (uw_eof(&status)) {
+            return AMW_END_OF_BLOCK;
+        }
+        if (uw_error(&status)) {
+            return read_error(parser, &status);
+        }
+        parser->line_number = uw_get_line_number(&parser->markup);
+    }
+
+    if (parser->compute_hashes && parser->line_number > parser->hashed_lines) {
+        // hash lines once, they can be read again after unread_line
+        parser->hashed_lines = parser->line_number;
+        parser->raw_hash = _amw_hash_mix(parser->raw_hash, _amw_hash_string(&parser->current_line));
+    }
+
     // strip trailing spaces
     if (!uw_string_rtrim(&parser->current_line)) {
-        return UwOOM();
+        UwValue status = UwOOM();
+        return read_error(parser, &status);
     }
 
     // measure indent
     parser->current_indent = uw_string_skip_spaces(&parser->current_line, 0);
 
-    // set current_line
-    parser->line_number = uw_get_line_number(&parser->markup);
+    return AMW_LINE_READ;
+}
 
-    return UwOK();
+static void unread_line(AmwParser* parser)
+/*
+ * Push current line back.
+ *
+ * The line is kept in the parser rather than returned to markup,
+ * so reading it again does not copy, strip, and measure it again.
+ * This matters when a dedent ends many nested blocks at once:
+ * each of them reads and unreads the same line.
+ */
+{
+    swap_lines(parser);
+    parser->have_unread_line = true;
+    parser->unread_indent = parser->current_indent;
+    parser->unread_line_number = parser->line_number;
+    if (uw_is_array(&parser->markup)) {
+        // keep line_index pointing to the next line of markup, see _amw_defer_block
+        parser->line_index--;
+    }
+}
+
+UwResult _amw_intern_key(AmwParser* parser, UwValuePtr key)
+{
+    if (!uw_is_map(&parser->key_intern) || !uw_is_string(key)) {
+        return uw_move(key);
+    }
+    UwValue interned = uw_map_get(&parser->key_intern, key);
+    if (uw_is_string(&interned)) {
+        uw_destroy(key);
+        return uw_move(&interned);
+    }
+    // new key
+    UwValue status = uw_map_update(&parser->key_intern, key, key);
+    if (uw_error(&status)) {
+        uw_destroy(key);
+        return uw_move(&status);
+    }
+    return uw_move(key);
+}
+
+bool _amw_significant_line(UwValuePtr line, unsigned* indent)
+{
+    unsigned pos = uw_string_skip_spaces(line, 0);
+    if (end_of_line(line, pos)) {
+        return false;
+    }
+    if (uw_char_at(line, pos) == AMW_COMMENT) {
+        return false;
+    }
+    *indent = pos;
+    return true;
 }
 
 static inline bool is_comment_line(AmwParser* parser)
@@ -218,25 +618,29 @@ static inline bool is_comment_line(AmwParser* parser)
     return uw_char_at(&parser->current_line, parser->current_indent) == AMW_COMMENT;
 }
 
-UwResult _amw_read_block_line(AmwParser* parser)
+AmwReadResult _amw_read_block_line(AmwParser* parser)
 {
     TRACEPOINT();
 
     if (parser->eof) {
         if (parser->blocklevel) {
             // continue returning this for nested blocks
-            return UwError(AMW_END_OF_BLOCK);
+            return AMW_END_OF_BLOCK;
         }
-        return UwError(UW_ERROR_EOF);
+        UwValue status = UwError(UW_ERROR_EOF);
+        return read_error(parser, &status);
     }
-    for (;;) {{
-        UwValue status = read_line(parser);
-        if (uw_eof(&status)) {
+    for (;;) {
+        AmwReadResult result = read_line(parser);
+        if (result == AMW_END_OF_BLOCK) {
             parser->eof = true;
-            uw_destroy(&parser->current_line);
-            return UwError(AMW_END_OF_BLOCK);
+            // keep the buffer for amw_parser_reset
+            uw_string_truncate(&parser->current_line, 0);
+            return AMW_END_OF_BLOCK;
+        }
+        if (result != AMW_LINE_READ) {
+            return result;
         }
-        uw_return_if_error(&status);
 
         if (parser->skip_comments) {
             // skip empty lines too
@@ -250,11 +654,11 @@ UwResult _amw_read_block_line(AmwParser* parser)
         }
         if (uw_strlen(&parser->current_line) == 0) {
             // return empty line as is
-            return UwOK();
+            return AMW_LINE_READ;
         }
         if (parser->current_indent >= parser->block_indent) {
             // indentation is okay, return line
-            return UwOK();
+            return AMW_LINE_READ;
         }
         // unindent detected
         if (is_comment_line(parser)) {
@@ -263,18 +667,32 @@ UwResult _amw_read_block_line(AmwParser* parser)
         }
         TRACE("unindent");
         // end of block
-        if (!uw_unread_line(&parser->markup, &parser->current_line)) {
-            return UwError(UW_ERROR_UNREAD_FAILED);
-        }
+        unread_line(parser);
         uw_string_truncate(&parser->current_line, 0);
-        return UwError(AMW_END_OF_BLOCK);
-    }}
+        return AMW_END_OF_BLOCK;
+    }
+}
+
+UwResult _amw_read_error(AmwParser* parser)
+{
+    return uw_move(&parser->read_status);
 }
 
 UwResult _amw_read_block(AmwParser* parser)
 {
     TRACEPOINT();
 
+    if (parser->validate_only) {
+        // lines are not needed, just skip the block
+        for (;;) {{
+            AmwReadResult status = _amw_read_block_line(parser);
+            if (status == AMW_END_OF_BLOCK) {
+                return UwNull();
+            }
+            _amw_return_if_read_error(parser, status);
+        }}
+    }
+
     UwValue lines = UwArray();
     uw_return_if_error(&lines);
 
@@ -286,27 +704,43 @@ UwResult _amw_read_block(AmwParser* parser)
         uw_expect_ok( uw_array_append(&lines, &line) );
 
         // read next line
-        UwValue status = _amw_read_block_line(parser);
-        if (_amw_end_of_block(&status)) {
+        AmwReadResult status = _amw_read_block_line(parser);
+        if (status == AMW_END_OF_BLOCK) {
             return uw_move(&lines);
         }
-        uw_return_if_error(&status);
+        _amw_return_if_read_error(parser, status);
     }}
 }
 
-static UwResult parse_nested_block(AmwParser* parser, unsigned block_pos, AmwBlockParserFunc parser_func)
+static UwResult begin_nested_block(AmwParser* parser, unsigned block_pos)
 /*
- * Set block indent to `block_pos` and call parser_func.
+ * Set block indent to `block_pos` and increment block level.
  */
 {
     if (parser->blocklevel >= parser->max_blocklevel) {
         return amw_parser_error(parser, parser->current_indent, "Too many nested blocks");
     }
-
-    // start nested block
     parser->blocklevel++;
-    unsigned saved_block_indent = parser->block_indent;
     parser->block_indent = block_pos;
+    return UwOK();
+}
+
+static inline void end_nested_block(AmwParser* parser, unsigned saved_block_indent)
+{
+    parser->block_indent = saved_block_indent;
+    parser->blocklevel--;
+}
+
+static UwResult parse_nested_block(AmwParser* parser, unsigned block_pos, AmwBlockParserFunc parser_func)
+/*
+ * Set block indent to `block_pos` and call parser_func.
+ */
+{
+    unsigned saved_block_indent = parser->block_indent;
+
+    // start nested block
+    UwValue status = begin_nested_block(parser, block_pos);
+    uw_return_if_error(&status);
 
     TRACE_ENTER();
 
@@ -314,16 +748,16 @@ static UwResult parse_nested_block(AmwParser* parser, unsigned block_pos, AmwBlo
     UwValue result = parser_func(parser);
 
     // end nested block
-    parser->block_indent = saved_block_indent;
-    parser->blocklevel--;
+    end_nested_block(parser, saved_block_indent);
 
     TRACE_EXIT();
     return uw_move(&result);
 }
 
-static UwResult parse_nested_block_from_next_line(AmwParser* parser, AmwBlockParserFunc parser_func)
+static UwResult read_nested_block_line(AmwParser* parser)
 /*
- * Read next line, set block indent to current indent plus one, and call parser_func.
+ * Read the first line of nested block that starts from next line.
+ * Its indent must be greater than current block indent.
  */
 {
     TRACEPOINT();
@@ -332,14 +766,29 @@ static UwResult parse_nested_block_from_next_line(AmwParser* parser, AmwBlockPar
     // temporarily increment block indent by one and read next line
     parser->block_indent++;
     parser->skip_comments = true;
-    UwValue status = _amw_read_block_line(parser);
+    AmwReadResult status = _amw_read_block_line(parser);
     parser->block_indent--;
 
-    if (_amw_end_of_block(&status)) {
+    if (status == AMW_END_OF_BLOCK) {
         return amw_parser_error(parser, parser->current_indent, "Empty block");
     }
+    _amw_return_if_read_error(parser, status);
+    return UwOK();
+}
+
+static UwResult parse_nested_block_from_next_line(AmwParser* parser, AmwBlockParserFunc parser_func)
+/*
+ * Read next line, set block indent to current indent plus one, and call parser_func.
+ */
+{
+    UwValue status = read_nested_block_line(parser);
     uw_return_if_error(&status);
 
+    if (parser->lazy && !parser->validate_only) {
+        // parse nested block on first access
+        return _amw_defer_block(parser, parser->block_indent + 1, parser_func);
+    }
+
     // call parse_nested_block
     return parse_nested_block(parser, parser->block_indent + 1, parser_func);
 }
@@ -360,15 +809,13 @@ bool _amw_comment_or_end_of_line(AmwParser* parser, unsigned position)
             || uw_char_at(&parser->current_line, position) == AMW_COMMENT);
 }
 
-static UwResult parse_convspec(AmwParser* parser, unsigned opening_colon_pos, unsigned* end_pos)
+static AmwBlockParserFunc parse_convspec(AmwParser* parser, unsigned opening_colon_pos, unsigned* end_pos)
 /*
  * Extract conversion specifier starting from `opening_colon_pos` in the `current_line`.
  *
- * On success return string and write `end_pos`.
- *
- * If conversion specified is not detected, return UwNull()
+ * On success return parser function and write `end_pos`.
  *
- * On error return UwStatus.
+ * If conversion specified is not detected, return nullptr.
  */
 {
     UwValuePtr current_line = &parser->current_line;
@@ -376,28 +823,31 @@ static UwResult parse_convspec(AmwParser* parser, unsigned opening_colon_pos, un
     unsigned start_pos = opening_colon_pos + 1;
     unsigned closing_colon_pos;
     if (!uw_strchr(current_line, ':', start_pos, &closing_colon_pos)) {
-        return UwNull();
+        return nullptr;
     }
     if (closing_colon_pos == start_pos) {
         // empty conversion specifier
-        return UwNull();
+        return nullptr;
     }
     if (!isspace_or_eol_at(current_line, closing_colon_pos + 1)) {
         // not a conversion specifier
-        return UwNull();
+        return nullptr;
     }
-    UwValue convspec = uw_substr(current_line, start_pos, closing_colon_pos);
-    uw_return_if_error(&convspec);
 
-    if (!uw_string_trim(&convspec)) {
-        return UwOOM();
+    // trim spaces
+    unsigned name_start = uw_string_skip_spaces(current_line, start_pos);
+    unsigned name_end = closing_colon_pos;
+    while (name_end > name_start && uw_isspace(uw_char_at(current_line, name_end - 1))) {
+        name_end--;
     }
-    if (!have_custom_parser(parser, &convspec)) {
+
+    AmwBlockParserFunc parser_func = lookup_convspec(parser, current_line, name_start, name_end);
+    if (!parser_func) {
         // such a conversion specifier is not defined
-        return UwNull();
+        return nullptr;
     }
     *end_pos = closing_colon_pos + 1;
-    return uw_move(&convspec);
+    return parser_func;
 }
 
 static UwResult parse_raw_value(AmwParser* parser)
@@ -407,6 +857,10 @@ static UwResult parse_raw_value(AmwParser* parser)
     UwValue lines = _amw_read_block(parser);
     uw_return_if_error(&lines);
 
+    if (parser->validate_only) {
+        return UwNull();
+    }
+
     if (uw_array_length(&lines) > 1) {
         // append one empty line for ending line break
         UWDECL_String(empty_line);
@@ -426,6 +880,10 @@ static UwResult parse_literal_string(AmwParser* parser)
     UwValue lines = _amw_read_block(parser);
     uw_return_if_error(&lines);
 
+    if (parser->validate_only) {
+        return UwNull();
+    }
+
     // normalize list of lines
 
     uw_expect_ok( uw_array_dedent(&lines) );
@@ -450,13 +908,25 @@ static UwResult parse_literal_string(AmwParser* parser)
     return uw_array_join('\n', &lines);
 }
 
+static inline bool append_unescaped(AmwParser* parser, UwValuePtr str, char32_t chr)
+/*
+ * Append character to the result of unescaping unless the parser is in validation mode.
+ */
+{
+    return parser->validate_only || uw_string_append(str, chr);
+}
+
 UwResult _amw_unescape_line(AmwParser* parser, UwValuePtr line, unsigned line_number,
                             char32_t quote, unsigned start_pos, unsigned end_pos)
 {
-    UwValue result = uw_create_empty_string(
-        end_pos - start_pos,  // unescaped string can be shorter
-        uw_string_char_size(line)
-    );
+    UwValue result = UwNull();
+    if (!parser->validate_only) {
+        result = uw_create_empty_string(
+            end_pos - start_pos,  // unescaped string can be shorter
+            uw_string_char_size(line)
+        );
+        uw_return_if_error(&result);
+    }
     unsigned pos = start_pos;
     while (pos < end_pos) {
         char32_t chr = uw_char_at(line, pos);
@@ -465,17 +935,17 @@ UwResult _amw_unescape_line(AmwParser* parser, UwValuePtr line, unsigned line_nu
             break;
         }
         if (chr != '\\') {
-            if (!uw_string_append(&result, chr)) {
+            if (!append_unescaped(parser, &result, chr)) {
                 return UwOOM();
             }
         } else {
             // start of escape sequence
             pos++;
             if (pos >= end_pos) {
-                if (!uw_string_append(&result, chr)) {  // leave backslash in the result
+                if (!append_unescaped(parser, &result, chr)) {  // leave backslash in the result
                     return UwOOM();
                 }
-                return UwOK();
+                return uw_move(&result);
             }
             bool append_ok = false;
             int hexlen;
@@ -487,15 +957,15 @@ UwResult _amw_unescape_line(AmwParser* parser, UwValuePtr line, unsigned line_nu
                 case '"':     //  \"   double quote     byte 0x22
                 case '?':     //  \?   question mark    byte 0x3f
                 case '\\':    //  \\   backslash        byte 0x5c
-                    append_ok = uw_string_append(&result, chr);
+                    append_ok = append_unescaped(parser, &result, chr);
                     break;
-                case 'a': append_ok = uw_string_append(&result, 0x07); break;  // audible bell
-                case 'b': append_ok = uw_string_append(&result, 0x08); break;  // backspace
-                case 'f': append_ok = uw_string_append(&result, 0x0c); break;  // form feed
-                case 'n': append_ok = uw_string_append(&result, 0x0a); break;  // line feed
-                case 'r': append_ok = uw_string_append(&result, 0x0d); break;  // carriage return
-                case 't': append_ok = uw_string_append(&result, 0x09); break;  // horizontal tab
-                case 'v': append_ok = uw_string_append(&result, 0x0b); break;  // vertical tab
+                case 'a': append_ok = append_unescaped(parser, &result, 0x07); break;  // audible bell
+                case 'b': append_ok = append_unescaped(parser, &result, 0x08); break;  // backspace
+                case 'f': append_ok = append_unescaped(parser, &result, 0x0c); break;  // form feed
+                case 'n': append_ok = append_unescaped(parser, &result, 0x0a); break;  // line feed
+                case 'r': append_ok = append_unescaped(parser, &result, 0x0d); break;  // carriage return
+                case 't': append_ok = append_unescaped(parser, &result, 0x09); break;  // horizontal tab
+                case 'v': append_ok = append_unescaped(parser, &result, 0x0b); break;  // vertical tab
 
                 // Numeric escape sequences
                 case 'o': {
@@ -517,7 +987,7 @@ UwResult _amw_unescape_line(AmwParser* parser, UwValuePtr line, unsigned line_nu
                             return amw_parser_error2(parser, line_number, pos, "Bad octal value");
                         }
                     }
-                    append_ok = uw_string_append(&result, v);
+                    append_ok = append_unescaped(parser, &result, v);
                     break;
                 }
                 case 'x':
@@ -555,14 +1025,14 @@ UwResult _amw_unescape_line(AmwParser* parser, UwValuePtr line, unsigned line_nu
                             return amw_parser_error2(parser, line_number, pos, "Bad hexadecimal value");
                         }
                     }
-                    append_ok = uw_string_append(&result, v);
+                    append_ok = append_unescaped(parser, &result, v);
                     break;
                 }
                 default:
                     // not a valid escape sequence
-                    append_ok = uw_string_append(&result, '\\');
+                    append_ok = append_unescaped(parser, &result, '\\');
                     if (append_ok) {
-                        append_ok = uw_string_append(&result, chr);
+                        append_ok = append_unescaped(parser, &result, chr);
                     }
                     break;
             }
@@ -677,6 +1147,10 @@ static UwResult parse_folded_string(AmwParser* parser)
     UwValue lines = _amw_read_block(parser);
     uw_return_if_error(&lines);
 
+    if (parser->validate_only) {
+        return UwNull();
+    }
+
     return fold_lines(parser, &lines, 0, nullptr);
 }
 
@@ -686,8 +1160,14 @@ bool _amw_find_closing_quote(UwValuePtr line, char32_t quote, unsigned start_pos
         if (!uw_strchr(line, quote, start_pos, end_pos)) {
             return false;
         }
-        // check if the quotation mark is not escaped
-        if (*end_pos && uw_char_at(line, *end_pos - 1) == '\\') {
+        // the quotation mark is escaped if preceded by odd number of backslashes;
+        // backslashes are counted back to start_pos only, so each char is visited
+        // at most twice and the search is linear
+        unsigned pos = *end_pos;
+        while (pos > start_pos && uw_char_at(line, pos - 1) == '\\') {
+            pos--;
+        }
+        if ((*end_pos - pos) & 1) {
             // continue searching
             start_pos = *end_pos + 1;
         } else {
@@ -696,6 +1176,36 @@ bool _amw_find_closing_quote(UwValuePtr line, char32_t quote, unsigned start_pos
     }
 }
 
+static void check_quoted_line(AmwParser* parser, char32_t quote, unsigned block_indent, unsigned end_pos,
+                              unsigned* min_indent, UwValuePtr escape_error)
+/*
+ * Helper function for parse_quoted_string in validation mode.
+ *
+ * Check escape sequences in the current line from `block_indent` to `end_pos`
+ * and update `min_indent` the block will be dedented by.
+ *
+ * The first error is saved in `escape_error` and reported when the whole string is read,
+ * because unterminated string takes precedence.
+ */
+{
+    unsigned pos = uw_string_skip_spaces(&parser->current_line, block_indent);
+    if (pos >= end_pos) {
+        // empty lines do not affect dedent
+        return;
+    }
+    if (pos - block_indent < *min_indent) {
+        *min_indent = pos - block_indent;
+    }
+    if (uw_error(escape_error)) {
+        return;
+    }
+    UwValue status = _amw_unescape_line(parser, &parser->current_line, parser->line_number,
+                                        quote, block_indent, end_pos);
+    if (uw_error(&status)) {
+        *escape_error = uw_move(&status);
+    }
+}
+
 static UwResult parse_quoted_string(AmwParser* parser, unsigned opening_quote_pos, unsigned* end_pos)
 /*
  * Parse quoted string starting from `opening_quote_pos` in the current line.
@@ -725,14 +1235,34 @@ static UwResult parse_quoted_string(AmwParser* parser, unsigned opening_quote_po
     parser->blocklevel++;
 
     // read block
-    UwValue lines = UwArray();
-    uw_return_if_error(&lines);
+    UwValue lines = UwNull();
+    UwValue line_numbers = UwNull();
 
-    UwValue line_numbers = UwArray();
-    uw_return_if_error(&line_numbers);
+    // in validation mode lines are not collected, see check_quoted_line
+    unsigned min_indent = UINT_MAX;
+    if (!parser->validate_only) {
+        lines = UwArray();
+        uw_return_if_error(&lines);
+
+        line_numbers = UwArray();
+        uw_return_if_error(&line_numbers);
+    }
+    UwValue escape_error = UwNull();
 
     bool closing_quote_detected = false;
     for (;;) {{
+        if (parser->validate_only) {
+            if (_amw_find_closing_quote(&parser->current_line, quote, block_indent, end_pos)) {
+                check_quoted_line(parser, quote, block_indent, *end_pos, &min_indent, &escape_error);
+                (*end_pos)++;
+                closing_quote_detected = true;
+                break;
+            }
+            check_quoted_line(parser, quote, block_indent, uw_strlen(&parser->current_line),
+                              &min_indent, &escape_error);
+            goto read_next_line;
+        }
+
         // append line number
         UwValue n = UwUnsigned(parser->line_number);
         uw_expect_ok( uw_array_append(&line_numbers, &n) );
@@ -754,12 +1284,14 @@ static UwResult parse_quoted_string(AmwParser* parser, unsigned opening_quote_po
             uw_return_if_error(&line);
             uw_expect_ok( uw_array_append(&lines, &line) );
         }
+
+    read_next_line:
         // read next line
-        UwValue status = _amw_read_block_line(parser);
-        if (_amw_end_of_block(&status)) {
+        AmwReadResult status = _amw_read_block_line(parser);
+        if (status == AMW_END_OF_BLOCK) {
             break;
         }
-        uw_return_if_error(&status);
+        _amw_return_if_read_error(parser, status);
     }}
 
     // finished reading nested block
@@ -771,10 +1303,12 @@ static UwResult parse_quoted_string(AmwParser* parser, unsigned opening_quote_po
         static char unterminated[] = "String has no closing quote";
 
         // the above loop terminated abnormally, need to read next line
-        UwValue status = _amw_read_block_line(parser);
-        if (_amw_end_of_block(&status)) {
+        AmwReadResult status = _amw_read_block_line(parser);
+        if (status == AMW_END_OF_BLOCK) {
             return amw_parser_error(parser, parser->current_indent, unterminated);
         }
+        _amw_return_if_read_error(parser, status);
+
         // check if the line starts with a quote with the same indent as the opening quote
         if (parser->current_indent == opening_quote_pos
             && uw_char_at(&parser->current_line, parser->current_indent) == quote) {
@@ -785,6 +1319,17 @@ static UwResult parse_quoted_string(AmwParser* parser, unsigned opening_quote_po
         }
     }
 
+    if (parser->validate_only) {
+        if (uw_error(&escape_error)) {
+            if (escape_error.status_code == AMW_PARSE_ERROR) {
+                // make position relative to dedented line, same as fold_lines reports it
+                _amw_status_data_ptr(&escape_error)->position -= block_indent + min_indent;
+            }
+            return uw_move(&escape_error);
+        }
+        return UwNull();
+    }
+
     // fold and unescape
 
     return fold_lines(parser, &lines, quote, &line_numbers);
@@ -960,7 +1505,7 @@ static UwResult parse_datetime(AmwParser* parser)
                 }
             }
         }
-        result.gmt_offset = sign * offset_hour * 60 + offset_minute;
+        result.gmt_offset = sign * (int) (offset_hour * 60 + offset_minute);
     }
 
 end_of_datetime:
@@ -1206,7 +1751,9 @@ done:
     } else {
         // make integer
         if (base.unsigned_value > UW_SIGNED_MAX) {
-            if (sign < 0) {
+            if (sign < 0 && base.unsigned_value == (uint64_t) UW_SIGNED_MAX + 1) {
+                result = UwSigned(INT64_MIN);
+            } else if (sign < 0) {
                 return amw_parser_error(parser, start_pos, "Integer overflow");
             } else {
                 result = UwUnsigned(base.unsigned_value);
@@ -1223,132 +1770,211 @@ done:
     return uw_move(&result);
 }
 
-static UwResult parse_list(AmwParser* parser)
+static UwResult parse_list_item(AmwParser* parser, unsigned item_indent)
 /*
- * Parse list.
- *
- * Return list value on success.
- * Return nullptr on error.
+ * Parse list item which hyphen is at `item_indent` in the current line.
  */
 {
-    TRACE_ENTER();
+    // check if hyphen is followed by space or end of line
+    unsigned next_pos = item_indent + 1;
+    if (!isspace_or_eol_at(&parser->current_line, next_pos)) {
+        return amw_parser_error(parser, item_indent, "Bad list item");
+    }
 
-    UwValue result = UwArray();
-    uw_return_if_error(&result);
+    // parse item as a nested block
 
-    /*
-     * All list items must have the same indent.
-     * Save indent of the first item (current one) and check it for subsequent items.
-     */
-    unsigned item_indent = _amw_get_start_position(parser);
+    if (_amw_comment_or_end_of_line(parser, next_pos)) {
+        return parse_nested_block_from_next_line(parser, value_parser_func);
+    } else {
+        // nested block starts on the same line, increment block position
+        return parse_nested_block(parser, next_pos + 1, value_parser_func);
+    }
+}
 
-    for (;;) {
-        {
-            // check if hyphen is followed by space or end of line
-            unsigned next_pos = item_indent + 1;
-            if (!isspace_or_eol_at(&parser->current_line, next_pos)) {
-                return amw_parser_error(parser, item_indent, "Bad list item");
-            }
+static UwResult parse_map_value(AmwParser* parser, AmwBlockParserFunc convspec, unsigned value_pos)
+/*
+ * Parse map value starting from `value_pos` in the current line.
+ */
+{
+    // parse value as a nested block
 
-            // parse item as a nested block
+    AmwBlockParserFunc parser_func = value_parser_func;
+    if (convspec) {
+        parser_func = convspec;
+    }
+    if (_amw_comment_or_end_of_line(parser, value_pos)) {
+        return parse_nested_block_from_next_line(parser, parser_func);
+    } else {
+        return parse_nested_block(parser, value_pos, parser_func);
+    }
+}
 
-            UwValue item = UwNull();
-            if (_amw_comment_or_end_of_line(parser, next_pos)) {
-                item = parse_nested_block_from_next_line(parser, value_parser_func);
-            } else {
-                // nested block starts on the same line, increment block position
-                next_pos++;
-                item = parse_nested_block(parser, next_pos, value_parser_func);
-            }
-            uw_return_if_error(&item);
+/*
+ * Lists and maps are parsed without recursion.
+ *
+ * When parse_value detects list or map, it pushes a frame onto parser's stack
+ * and returns to value_parser_func which parses items of the container
+ * in the nested blocks in the same loop.
+ */
 
-            uw_expect_ok( uw_array_append(&result, &item) );
+#define INITIAL_FRAMES_CAPACITY  16
 
-            UwValue status = _amw_read_block_line(parser);
-            if (_amw_end_of_block(&status)) {
-                break;
-            }
-            uw_return_if_error(&status);
+static AmwFrame* push_frame(AmwParser* parser)
+/*
+ * Push new frame onto parser's stack.
+ * Return pointer to the frame or nullptr if out of memory.
+ */
+{
+    if (parser->num_frames == parser->frames_capacity) {
+        unsigned new_capacity = parser->frames_capacity? parser->frames_capacity * 2 : INITIAL_FRAMES_CAPACITY;
+        AmwFrame* new_frames = allocate(new_capacity * sizeof(AmwFrame), false);
+        if (!new_frames) {
+            return nullptr;
+        }
+        if (parser->frames) {
+            memcpy(new_frames, parser->frames, parser->num_frames * sizeof(AmwFrame));
+            release((void**) &parser->frames, parser->frames_capacity * sizeof(AmwFrame));
+        }
+        parser->frames = new_frames;
+        parser->frames_capacity = new_capacity;
+    }
+    AmwFrame* frame = &parser->frames[parser->num_frames++];
+    frame->container = UwNull();
+    frame->indent = _amw_get_start_position(parser);
+    frame->block_indent = parser->block_indent;
+    frame->is_map = false;
+    frame->nested_block = false;
+    frame->key = UwNull();
+    frame->convspec = nullptr;
+    frame->value_pos = 0;
+    frame->hash = AMW_HASH_LIST_START;
+    frame->count = 0;
+    frame->key_hash = 0;
+    TRACE_ENTER();
+    return frame;
+}
 
-            if (parser->current_indent != item_indent) {
-                return amw_parser_error(parser, parser->current_indent, "Bad indentation of list item");
-            }
-        }
+static void pop_frame(AmwParser* parser)
+{
+    AmwFrame* frame = &parser->frames[--parser->num_frames];
+    if (frame->nested_block) {
+        end_nested_block(parser, frame->block_indent);
     }
+    uw_destroy(&frame->container);
+    uw_destroy(&frame->key);
     TRACE_EXIT();
-    return uw_move(&result);
 }
 
-static UwResult parse_map(AmwParser* parser, UwValuePtr first_key, UwValuePtr convspec_arg, unsigned value_pos)
+static UwResult push_list_frame(AmwParser* parser)
 /*
- * Parse map.
- *
- * Key is already parsed, continue parsing from `value_pos` in the `current_line`.
+ * Start parsing list.
  *
- * Return map value on success.
- * Return status on error.
+ * Return null on success, the list is returned by value_parser_func.
  */
 {
-    TRACE_ENTER();
-
-    UwValue result = UwMap();
-    uw_return_if_error(&result);
-
-    UwValue key = uw_clone(first_key);
-    UwValue convspec = uw_clone(convspec_arg);
+    TRACEPOINT();
 
-    /*
-     * All keys in the map must have the same indent.
-     * Save indent of the first key (current one) and check it for subsequent keys.
-     */
-    unsigned key_indent = _amw_get_start_position(parser);
+    AmwFrame* frame = push_frame(parser);
+    if (!frame) {
+        return UwOOM();
+    }
+    if (!parser->validate_only) {
+        frame->container = UwArray();
+        uw_return_if_error(&frame->container);
+    }
+    return UwNull();
+}
 
-    for (;;) {
-        TRACE("parse value (line %u) from position %u", parser->line_number, value_pos);
-        {
-            // parse value as a nested block
+static UwResult push_map_frame(AmwParser* parser, UwValuePtr first_key, AmwBlockParserFunc convspec, unsigned value_pos)
+/*
+ * Start parsing map.
+ *
+ * Key is already parsed, value will be parsed from `value_pos` in the `current_line`.
+ *
+ * Return null on success, the map is returned by value_parser_func.
+ */
+{
+    TRACEPOINT();
 
-            AmwBlockParserFunc parser_func = value_parser_func;
-            if (uw_is_string(&convspec)) {
-                parser_func = get_custom_parser(parser, &convspec);
-            }
-            UwValue value = UwNull();
-            if (_amw_comment_or_end_of_line(parser, value_pos)) {
-                value = parse_nested_block_from_next_line(parser, parser_func);
+    AmwFrame* frame = push_frame(parser);
+    if (!frame) {
+        return UwOOM();
+    }
+    frame->is_map = true;
+    frame->hash = AMW_HASH_MAP_START;
+    if (parser->compute_hashes) {
+        frame->key_hash = amw_value_hash(first_key);
+    }
+    UwValue key = uw_clone(first_key);
+    UwValue interned = _amw_intern_key(parser, &key);
+    uw_return_if_error(&interned);
+    frame->key = uw_move(&interned);
+    frame->convspec = convspec;
+    frame->value_pos = value_pos;
+    if (!parser->validate_only) {
+        frame->container = UwMap();
+        uw_return_if_error(&frame->container);
+    }
+    return UwNull();
+}
 
-            } else {
-                value = parse_nested_block(parser, value_pos, parser_func);
-            }
-            uw_return_if_error(&value);
+static UwResult start_item(AmwParser* parser, AmwFrame* frame, bool* complete)
+/*
+ * Start parsing list item or map value in the nested block.
+ *
+ * If the item has to be parsed by value_parser_func, just start nested block
+ * and set `complete` to false. Otherwise parse the item and return it.
+ */
+{
+    AmwBlockParserFunc parser_func = value_parser_func;
+    unsigned value_pos;
+    bool from_next_line;
 
-            uw_expect_ok( uw_map_update(&result, &key, &value) );
+    if (frame->is_map) {
+        if (frame->convspec) {
+            parser_func = frame->convspec;
         }
-        TRACE("parse next key");
-        {
-            uw_destroy(&key);
-            uw_destroy(&convspec);
+        value_pos = frame->value_pos;
+        from_next_line = _amw_comment_or_end_of_line(parser, value_pos);
+    } else {
+        // check if hyphen is followed by space or end of line
+        unsigned next_pos = frame->indent + 1;
+        if (!isspace_or_eol_at(&parser->current_line, next_pos)) {
+            return amw_parser_error(parser, frame->indent, "Bad list item");
+        }
+        from_next_line = _amw_comment_or_end_of_line(parser, next_pos);
+        // if nested block starts on the same line, increment block position
+        value_pos = next_pos + 1;
+    }
 
-            UwValue status = _amw_read_block_line(parser);
-            if (_amw_end_of_block(&status)) {
-                TRACE("end of map");
-                break;
-            }
-            uw_return_if_error(&status);
+    *complete = true;
 
-            if (parser->current_indent != key_indent) {
-                return amw_parser_error(parser, parser->current_indent, "Bad indentation of map key");
-            }
+    if (from_next_line) {
+        UwValue status = read_nested_block_line(parser);
+        uw_return_if_error(&status);
+
+        value_pos = parser->block_indent + 1;
 
-            key = parse_value(parser, &value_pos, &convspec);
-            uw_return_if_error(&key);
+        if (parser->lazy && !parser->validate_only) {
+            // parse nested block on first access
+            return _amw_defer_block(parser, value_pos, parser_func);
         }
     }
-    TRACE_EXIT();
-    return uw_move(&result);
+    if (parser_func != value_parser_func) {
+        return parse_nested_block(parser, value_pos, parser_func);
+    }
+
+    // continue parsing in value_parser_func loop
+    UwValue status = begin_nested_block(parser, value_pos);
+    uw_return_if_error(&status);
+
+    frame->nested_block = true;
+    *complete = false;
+    return UwNull();
 }
 
 static UwResult is_kv_separator(AmwParser* parser, unsigned colon_pos,
-                                UwValuePtr convspec_out, unsigned *value_pos)
+                                AmwBlockParserFunc* convspec_out, unsigned *value_pos)
 /*
  * Return UwBool(true) if colon_pos is followed by end of line, space, or conversion specifier.
  * Write conversion specifier to `convspec_out` if value is followed by conversion specifier.
@@ -1380,12 +2006,10 @@ static UwResult is_kv_separator(AmwParser* parser, unsigned colon_pos,
 
     // try parsing conversion specifier
     // value_pos will be updated only if conversion specifier is valid
-    UwValue convspec = parse_convspec(parser, next_pos, value_pos);
-    uw_return_if_error(&convspec);
-
-    if (uw_is_string(&convspec)) {
+    AmwBlockParserFunc convspec = parse_convspec(parser, next_pos, value_pos);
+    if (convspec) {
         if (convspec_out) {
-            *convspec_out = uw_move(&convspec);
+            *convspec_out = convspec;
         }
         return UwBool(true);
     }
@@ -1395,7 +2019,7 @@ static UwResult is_kv_separator(AmwParser* parser, unsigned colon_pos,
 }
 
 static UwResult check_value_end(AmwParser* parser, UwValuePtr value, unsigned end_pos,
-                                unsigned* nested_value_pos, UwValuePtr convspec_out)
+                                unsigned* nested_value_pos, AmwBlockParserFunc* convspec_out)
 /*
  * Helper function for parse_value.
  *
@@ -1425,17 +2049,15 @@ static UwResult check_value_end(AmwParser* parser, UwValuePtr value, unsigned en
             return amw_parser_error(parser, end_pos, "Map key expected");
         }
         // read next line
-        UwValue status = _amw_read_block_line(parser);
-        if (!_amw_end_of_block(&status)) {
-            uw_return_if_error(&status);
-        }
+        AmwReadResult status = _amw_read_block_line(parser);
+        _amw_return_if_read_error(parser, status);
         return uw_clone(value);
     }
 
     char32_t chr = uw_char_at(&parser->current_line, end_pos);
     if (chr == ':') {
         // check key-value separator
-        UwValue convspec = UwNull();
+        AmwBlockParserFunc convspec = nullptr;
         unsigned value_pos;
         UwValue kvs = is_kv_separator(parser, end_pos, &convspec, &value_pos);
         uw_return_if_error(&kvs);
@@ -1445,12 +2067,11 @@ static UwResult check_value_end(AmwParser* parser, UwValuePtr value, unsigned en
             if (nested_value_pos) {
                 // it was anticipated, just return the value
                 *nested_value_pos = value_pos;
-                *convspec_out = uw_move(&convspec);
+                *convspec_out = convspec;
                 return uw_clone(value);
             }
             // parse map
-            UwValue first_key = uw_clone(value);
-            return parse_map(parser, &first_key, &convspec, value_pos);
+            return push_map_frame(parser, value, convspec, value_pos);
         }
         return amw_parser_error(parser, end_pos + 1, "Bad character encountered");
     }
@@ -1460,14 +2081,12 @@ static UwResult check_value_end(AmwParser* parser, UwValuePtr value, unsigned en
     }
 
     // read next line
-    UwValue status = _amw_read_block_line(parser);
-    if (!_amw_end_of_block(&status)) {
-        uw_return_if_error(&status);
-    }
+    AmwReadResult status = _amw_read_block_line(parser);
+    _amw_return_if_read_error(parser, status);
     return uw_clone(value);
 }
 
-static UwResult parse_value(AmwParser* parser, unsigned* nested_value_pos, UwValuePtr convspec_out)
+static UwResult parse_value(AmwParser* parser, unsigned* nested_value_pos, AmwBlockParserFunc* convspec_out)
 /*
  * Parse value starting from `current_line[block_indent]` .
  *
@@ -1498,10 +2117,8 @@ static UwResult parse_value(AmwParser* parser, unsigned* nested_value_pos, UwVal
             return amw_parser_error(parser, start_pos, "Map key expected and it cannot start with colon");
         }
         unsigned value_pos;
-        UwValue convspec = parse_convspec(parser, start_pos, &value_pos);
-        uw_return_if_error(&convspec);
-
-        if (!uw_is_string(&convspec)) {
+        AmwBlockParserFunc parser_func = parse_convspec(parser, start_pos, &value_pos);
+        if (!parser_func) {
             // not a conversion specifier
             return parse_literal_string(parser);
         }
@@ -1510,21 +2127,18 @@ static UwResult parse_value(AmwParser* parser, unsigned* nested_value_pos, UwVal
 
             // conversion specifier is followed by LF
             // continue parsing CURRENT block from next line
-            UwValue status = _amw_read_block_line(parser);
-            if (_amw_end_of_block(&status)) {
+            AmwReadResult status = _amw_read_block_line(parser);
+            if (status == AMW_END_OF_BLOCK) {
                 return amw_parser_error(parser, parser->current_indent, "Empty block");
             }
-            uw_return_if_error(&status);
+            _amw_return_if_read_error(parser, status);
 
             // call parser function
-            AmwBlockParserFunc parser_func = get_custom_parser(parser, &convspec);
             return parser_func(parser);
 
         } else {
             // value is on the same line, parse it as nested block
-            return parse_nested_block(
-                parser, value_pos, get_custom_parser(parser, &convspec)
-            );
+            return parse_nested_block(parser, value_pos, parser_func);
         }
     }
 
@@ -1548,7 +2162,7 @@ static UwResult parse_value(AmwParser* parser, unsigned* nested_value_pos, UwVal
                 return amw_parser_error(parser, start_pos, "Map key expected and it cannot be a list");
             }
             // yes, it's a list item
-            return parse_list(parser);
+            return push_list_frame(parser);
         }
         // otherwise, it's a literal string or map
         goto parse_literal_string_or_map;
@@ -1616,30 +2230,33 @@ parse_literal_string_or_map:
         if (!uw_strchr(&parser->current_line, ':', pos, &colon_pos)) {
             break;
         }
-        UwValue convspec = UwNull();
+        AmwBlockParserFunc convspec = nullptr;
         unsigned value_pos;
         UwValue kvs = is_kv_separator(parser, colon_pos, &convspec, &value_pos);
         uw_return_if_error(&kvs);
 
         if (kvs.bool_value) {
             // found key-value separator, get key
-            UwValue key = uw_substr(&parser->current_line, start_pos, colon_pos);
-            uw_return_if_error(&key);
+            UwValue key = UwNull();
+            if (!parser->validate_only) {
+                key = uw_substr(&parser->current_line, start_pos, colon_pos);
+                uw_return_if_error(&key);
 
-            // strip trailing spaces
-            if (!uw_string_rtrim(&key)) {
-                return UwOOM();
+                // strip trailing spaces
+                if (!uw_string_rtrim(&key)) {
+                    return UwOOM();
+                }
             }
 
             if (nested_value_pos) {
                 // key was anticipated, simply return it
                 *nested_value_pos = value_pos;
-                *convspec_out = uw_move(&convspec);
+                *convspec_out = convspec;
                 return uw_move(&key);
             }
 
             // parse map
-            return parse_map(parser, &key, &convspec, value_pos);
+            return push_map_frame(parser, &key, convspec, value_pos);
         }
         pos = colon_pos + 1;
     }
@@ -1653,23 +2270,298 @@ parse_literal_string_or_map:
     return parse_literal_string(parser);
 }
 
+static inline bool streaming_frame(AmwParser* parser, unsigned base_frame)
+/*
+ * Return true if entries of the current frame are passed to event handler
+ * instead of adding them to the container.
+ */
+{
+    return parser->handler && base_frame == 0 && parser->num_frames == 1;
+}
+
 static UwResult value_parser_func(AmwParser* parser)
+/*
+ * Parse value in the current block.
+ *
+ * This is the driver loop for lists and maps, see push_frame.
+ */
 {
-    return parse_value(parser, nullptr, nullptr);
+    unsigned base_frame = parser->num_frames;
+    UwValue value = UwNull();
+    bool complete = false;  // if false, parse value starting from current line
+    bool hashed = false;    // structural hash of complete value is already in value_hash
+    uint64_t value_hash = 0;
+
+    for (;;) {{
+        if (!complete) {
+            unsigned num_frames = parser->num_frames;
+            uw_destroy(&value);
+            value = parse_value(parser, nullptr, nullptr);
+            if (uw_error(&value)) {
+                break;
+            }
+            if (parser->num_frames == num_frames) {
+                complete = true;
+            } else {
+                if (streaming_frame(parser, base_frame)) {
+                    UwValue status = parser->handler->begin(parser->handler_ctx, parser->frames[0].is_map);
+                    if (uw_error(&status)) {
+                        uw_destroy(&value);
+                        value = uw_move(&status);
+                        break;
+                    }
+                }
+                // list or map is started, parse the first item
+                value = start_item(parser, &parser->frames[parser->num_frames - 1], &complete);
+                if (uw_error(&value)) {
+                    break;
+                }
+            }
+            continue;
+        }
+
+        if (parser->compute_hashes && !hashed) {
+            value_hash = amw_value_hash(&value);
+        }
+        hashed = false;
+
+        if (parser->num_frames == base_frame) {
+            // done
+            parser->value_hash = value_hash;
+            return uw_move(&value);
+        }
+
+        // add complete item to the container
+
+        AmwFrame* frame = &parser->frames[parser->num_frames - 1];
+        if (frame->nested_block) {
+            end_nested_block(parser, frame->block_indent);
+            frame->nested_block = false;
+        }
+        if (parser->compute_hashes) {
+            if (frame->is_map && !parser->validate_only && !streaming_frame(parser, base_frame)) {
+                // uw_map_update keeps the last value of duplicate key,
+                // so take the previous entry out of the hash
+                UwValue previous = uw_map_get(&frame->container, &frame->key);
+                if (!uw_error(&previous)) {
+                    frame->hash -= _amw_hash_map_entry(0, frame->key_hash, amw_value_hash(&previous));
+                    frame->count--;
+                }
+            }
+            frame->count++;
+            if (frame->is_map) {
+                frame->hash = _amw_hash_map_entry(frame->hash, frame->key_hash, value_hash);
+                if (parser->num_frames == 1 && !parser->validate_only) {
+                    // top-level section
+                    UwValue section_hash = UwUnsigned(value_hash);
+                    uw_expect_ok( uw_map_update(&parser->section_hashes, &frame->key, &section_hash) );
+                }
+            } else {
+                frame->hash = _amw_hash_list_item(frame->hash, value_hash);
+            }
+        }
+        if (streaming_frame(parser, base_frame)) {
+            UwValue status = parser->handler->entry(parser->handler_ctx, frame->is_map? &frame->key : nullptr, &value);
+            if (uw_error(&status)) {
+                uw_destroy(&value);
+                value = uw_move(&status);
+                break;
+            }
+        } else if (!parser->validate_only) {
+            if (frame->is_map) {
+                uw_expect_ok( uw_map_update(&frame->container, &frame->key, &value) );
+            } else {
+                uw_expect_ok( uw_array_append(&frame->container, &value) );
+            }
+        }
+        uw_destroy(&value);
+        uw_destroy(&frame->key);
+        frame->convspec = nullptr;
+
+        // read next item
+
+        AmwReadResult status = _amw_read_block_line(parser);
+        if (status == AMW_END_OF_BLOCK) {
+            // the container is complete
+            if (streaming_frame(parser, base_frame)) {
+                UwValue status = parser->handler->end(parser->handler_ctx);
+                if (uw_error(&status)) {
+                    value = uw_move(&status);
+                    break;
+                }
+            }
+            if (parser->compute_hashes) {
+                value_hash = frame->is_map? _amw_hash_map_end(frame->hash, frame->count)
+                                          : _amw_hash_list_end(frame->hash, frame->count);
+                hashed = true;
+            }
+            value = uw_move(&frame->container);
+            pop_frame(parser);
+            continue;
+        }
+        if (status == AMW_READ_ERROR) {
+            value = _amw_read_error(parser);
+            break;
+        }
+        if (parser->current_indent != frame->indent) {
+            value = amw_parser_error(parser, parser->current_indent,
+                                     frame->is_map? "Bad indentation of map key" : "Bad indentation of list item");
+            break;
+        }
+        if (frame->is_map) {
+            TRACE("parse next key");
+            frame->key = parse_value(parser, &frame->value_pos, &frame->convspec);
+            if (uw_error(&frame->key)) {
+                value = uw_move(&frame->key);
+                break;
+            }
+            UwValue interned = _amw_intern_key(parser, &frame->key);
+            if (uw_error(&interned)) {
+                value = uw_move(&interned);
+                break;
+            }
+            frame->key = uw_move(&interned);
+            if (parser->compute_hashes) {
+                frame->key_hash = amw_value_hash(&frame->key);
+            }
+        }
+        value = start_item(parser, frame, &complete);
+        if (uw_error(&value)) {
+            break;
+        }
+    }}
+
+    // discard incomplete containers
+    while (parser->num_frames > base_frame) {
+        pop_frame(parser);
+    }
+    return uw_move(&value);
 }
 
-UwResult amw_parse(UwValuePtr markup)
+UwResult _amw_parse_part(AmwParser* parser, bool is_map, bool last_part)
 {
-    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(markup);
-    if (!parser) {
-        return UwOOM();
+    TRACE_ENTER();
+
+    UwValue result = is_map? UwMap() : UwArray();
+    uw_return_if_error(&result);
+
+    unsigned indent = parser->current_indent;
+
+    for (;;) {
+        {
+            if (is_map) {
+                AmwBlockParserFunc convspec = nullptr;
+                unsigned value_pos;
+                UwValue key = parse_value(parser, &value_pos, &convspec);
+                uw_return_if_error(&key);
+                UwValue interned = _amw_intern_key(parser, &key);
+                uw_return_if_error(&interned);
+                key = uw_move(&interned);
+
+                UwValue value = parse_map_value(parser, convspec, value_pos);
+                uw_return_if_error(&value);
+
+                uw_expect_ok( uw_map_update(&result, &key, &value) );
+            } else {
+                UwValue item = parse_list_item(parser, indent);
+                uw_return_if_error(&item);
+
+                uw_expect_ok( uw_array_append(&result, &item) );
+            }
+
+            AmwReadResult status = _amw_read_block_line(parser);
+            if (status == AMW_END_OF_BLOCK) {
+                break;
+            }
+            _amw_return_if_read_error(parser, status);
+
+            if (!last_part && parser->line_index == parser->end_line_index) {
+                // this is the first line of the next part
+                break;
+            }
+            if (parser->current_indent != indent) {
+                return amw_parser_error(parser, parser->current_indent,
+                                        is_map? "Bad indentation of map key" : "Bad indentation of list item");
+            }
+        }
     }
+    TRACE_EXIT();
+    return uw_move(&result);
+}
+
+UwResult _amw_parse_key(AmwParser* parser, unsigned* key_start, unsigned* key_end,
+                        AmwBlockParserFunc* convspec, unsigned* value_pos)
+{
+    unsigned start_pos = _amw_get_start_position(parser);
+    char32_t chr = uw_char_at(&parser->current_line, start_pos);
+
+    if (chr == '"' || chr == '\'') {
+        return parse_value(parser, value_pos, convspec);
+    }
+    if (chr == ':') {
+        return amw_parser_error(parser, start_pos, "Map key expected and it cannot start with colon");
+    }
+    if (chr == '-' && isspace_or_eol_at(&parser->current_line, start_pos + 1)) {
+        return amw_parser_error(parser, start_pos, "Map key expected and it cannot be a list");
+    }
+    for (unsigned pos = start_pos;;) {
+        unsigned colon_pos;
+        if (!uw_strchr(&parser->current_line, ':', pos, &colon_pos)) {
+            break;
+        }
+        *convspec = nullptr;
+        UwValue kvs = is_kv_separator(parser, colon_pos, convspec, value_pos);
+        uw_return_if_error(&kvs);
+
+        if (kvs.bool_value) {
+            // strip trailing spaces
+            unsigned end_pos = colon_pos;
+            while (end_pos > start_pos && uw_isspace(uw_char_at(&parser->current_line, end_pos - 1))) {
+                end_pos--;
+            }
+            *key_start = start_pos;
+            *key_end = end_pos;
+            return UwNull();
+        }
+        pos = colon_pos + 1;
+    }
+    return amw_parser_error(parser, parser->current_indent, "Not a key");
+}
+
+UwResult _amw_parse_map_value(AmwParser* parser, AmwBlockParserFunc convspec, unsigned value_pos)
+{
+    return parse_map_value(parser, convspec, value_pos);
+}
+
+UwResult _amw_enter_value_block(AmwParser* parser, unsigned value_pos, unsigned* saved_block_indent)
+{
+    *saved_block_indent = parser->block_indent;
+
+    unsigned block_pos = value_pos;
+    if (_amw_comment_or_end_of_line(parser, value_pos)) {
+        UwValue status = read_nested_block_line(parser);
+        uw_return_if_error(&status);
+        block_pos = parser->block_indent + 1;
+    }
+    return begin_nested_block(parser, block_pos);
+}
+
+void _amw_leave_block(AmwParser* parser, unsigned saved_block_indent)
+{
+    end_nested_block(parser, saved_block_indent);
+}
+
+static UwResult parse_markup(AmwParser* parser)
+/*
+ * Parse markup the parser was created for.
+ */
+{
     // read first line to prepare for parsing and to detect EOF
-    UwValue status = _amw_read_block_line(parser);
-    if (_amw_end_of_block(&status) && parser->eof) {
+    AmwReadResult status = _amw_read_block_line(parser);
+    if (status == AMW_END_OF_BLOCK && parser->eof) {
         return UwStatus(UW_ERROR_EOF);
     }
-    uw_return_if_error(&status);
+    _amw_return_if_read_error(parser, status);
 
     // parse top-level value
     UwValue result = value_parser_func(parser);
@@ -1680,8 +2572,113 @@ UwResult amw_parse(UwValuePtr markup)
     if (parser->eof) {
         // all right, no op
     } else {
-        uw_return_if_error(&status);
+        _amw_return_if_read_error(parser, status);
         return amw_parser_error(parser, parser->current_indent, "Extra data after parsed value");
     }
     return uw_move(&result);
 }
+
+UwResult amw_parser_parse(AmwParser* parser)
+{
+    return parse_markup(parser);
+}
+
+UwResult amw_parser_reset(AmwParser* parser, UwValuePtr markup)
+{
+    while (parser->num_frames) {
+        pop_frame(parser);
+    }
+    uw_destroy(&parser->markup);
+    uw_destroy(&parser->read_status);
+    uw_destroy(&parser->section_hashes);
+    uw_string_truncate(&parser->current_line, 0);
+    parser->have_unread_line = false;
+
+    parser->markup = uw_clone(markup);
+    parser->current_indent = 0;
+    parser->line_number = 0;
+    parser->block_indent = 0;
+    parser->blocklevel = 1;
+    parser->json_depth = 1;
+    parser->skip_comments = true;
+    parser->eof = false;
+
+    parser->raw_hash = AMW_FNV_OFFSET_BASIS;
+    parser->hashed_lines = 0;
+    parser->value_hash = 0;
+
+    parser->line_index = 0;
+    parser->end_line_index = 0;
+    parser->line_number_offset = 0;
+
+    if (uw_is_array(markup)) {
+        parser->end_line_index = uw_array_length(markup);
+        return UwOK();
+    }
+    return uw_start_read_lines(markup);
+}
+
+UwResult amw_parse(UwValuePtr markup)
+{
+    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(markup);
+    if (!parser) {
+        return UwOOM();
+    }
+    return parse_markup(parser);
+}
+
+UwResult amw_parse_lazy(UwValuePtr markup)
+{
+    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(markup);
+    if (!parser) {
+        return UwOOM();
+    }
+    parser->lazy = true;
+    return parse_markup(parser);
+}
+
+UwResult amw_parse_interned(UwValuePtr markup, UwValuePtr key_intern)
+{
+    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(markup);
+    if (!parser) {
+        return UwOOM();
+    }
+    parser->key_intern = uw_clone(key_intern);
+    return parse_markup(parser);
+}
+
+UwResult amw_parse_hashed(UwValuePtr markup, AmwHashes* hashes)
+{
+    hashes->raw = 0;
+    hashes->structural = 0;
+    hashes->sections = UwMap();
+    uw_return_if_error(&hashes->sections);
+
+    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(markup);
+    if (!parser) {
+        return UwOOM();
+    }
+    parser->compute_hashes = true;
+    parser->raw_hash = AMW_FNV_OFFSET_BASIS;
+    parser->section_hashes = uw_clone(&hashes->sections);
+
+    UwValue result = parse_markup(parser);
+    uw_return_if_error(&result);
+
+    hashes->raw = parser->raw_hash;
+    hashes->structural = parser->value_hash;
+    return uw_move(&result);
+}
+
+UwResult amw_validate(UwValuePtr markup)
+{
+    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(markup);
+    if (!parser) {
+        return UwOOM();
+    }
+    parser->validate_only = true;
+
+    UwValue result = parse_markup(parser);
+    uw_return_if_error(&result);
+    return UwOK();
+}
@@ -0,0 +1,325 @@
+#include <limits.h>
+
+#include <amw.h>
+
+typedef struct {
+    UwValuePtr lines;       // new source
+    unsigned   edit_start;  // range of edited lines in the new source
+    unsigned   edit_end;
+} Reparse;
+
+static UwResult apply_edits(UwValuePtr source_lines, AmwEdit* edits, unsigned num_edits, Reparse* reparse)
+/*
+ * Return new array of lines and write the range of edited lines to `reparse`.
+ */
+{
+    UwValue lines = uw_clone(source_lines);
+    unsigned edit_start = UINT_MAX;
+    unsigned edit_end = 0;
+
+    for (unsigned i = 0; i < num_edits; i++) {{
+        AmwEdit* edit = &edits[i];
+        unsigned num_lines = uw_array_length(&lines);
+        if (edit->first_line > num_lines || edit->num_lines > num_lines - edit->first_line) {
+            return UwError(UW_ERROR_INDEX_OUT_OF_RANGE);
+        }
+        unsigned num_new_lines = edit->new_lines? uw_array_length(edit->new_lines) : 0;
+
+        UwValue new_lines = UwArray();
+        uw_return_if_error(&new_lines);
+
+        for (unsigned j = 0; j < edit->first_line; j++) {{
+            UwValue line = uw_array_item(&lines, j);
+            uw_expect_ok( uw_array_append(&new_lines, &line) );
+        }}
+        for (unsigned j = 0; j < num_new_lines; j++) {{
+            UwValue line = uw_array_item(edit->new_lines, j);
+            uw_expect_ok( uw_array_append(&new_lines, &line) );
+        }}
+        for (unsigned j = edit->first_line + edit->num_lines; j < num_lines; j++) {{
+            UwValue line = uw_array_item(&lines, j);
+            uw_expect_ok( uw_array_append(&new_lines, &line) );
+        }}
+        uw_destroy(&lines);
+        lines = uw_move(&new_lines);
+
+        // shift the end of previous edits
+        if (edit_end > edit->first_line) {
+            if (edit_end < edit->first_line + edit->num_lines) {
+                edit_end = edit->first_line + edit->num_lines;
+            }
+            edit_end = edit_end - edit->num_lines + num_new_lines;
+        }
+        // merge current edit; deleted lines affect the lines around them
+        unsigned start = edit->first_line;
+        unsigned end = edit->first_line + num_new_lines;
+        if (num_new_lines == 0) {
+            if (start) {
+                start--;
+            }
+            end++;
+        }
+        if (start < edit_start) {
+            edit_start = start;
+        }
+        if (end > edit_end) {
+            edit_end = end;
+        }
+    }}
+
+    unsigned num_lines = uw_array_length(&lines);
+    if (edit_end > num_lines) {
+        edit_end = num_lines;
+    }
+    reparse->edit_start = edit_start;
+    reparse->edit_end = edit_end;
+    return uw_move(&lines);
+}
+
+static bool nested_block_from_next_line(UwValuePtr line, unsigned indent)
+/*
+ * Return true if `line` is a list item or map key which value
+ * is a nested block starting from the next line.
+ *
+ * Keys that contain colons other than the separator are not recognized.
+ * This rules out keys with conversion specifiers, such as `key::json:`,
+ * and quoted keys that contain key-value separator.
+ */
+{
+    // get length without trailing spaces
+    unsigned len = uw_strlen(line);
+    while (len > indent && uw_isspace(uw_char_at(line, len - 1))) {
+        len--;
+    }
+    if (len == indent + 1 && uw_char_at(line, indent) == '-') {
+        return true;
+    }
+    if (len < indent + 2 || uw_char_at(line, len - 1) != ':') {
+        return false;
+    }
+    // the separator must be the only colon in the line
+    for (unsigned i = indent; i < len - 1; i++) {
+        if (uw_char_at(line, i) == ':') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool block_has_convspec(Reparse* reparse, unsigned start, unsigned end)
+/*
+ * Return true if the first significant line of the block starts with colon,
+ * i.e. with conversion specifier.
+ *
+ * Such block is parsed as a whole by the conversion function, e.g. as JSON,
+ * and cannot be reparsed entry by entry.
+ */
+{
+    for (unsigned i = start; i < end; i++) {{
+        UwValue line = uw_array_item(reparse->lines, i);
+        unsigned indent;
+        if (_amw_significant_line(&line, &indent)) {
+            return uw_char_at(&line, indent) == ':';
+        }
+    }}
+    return false;
+}
+
+static UwResult parse_chunk(Reparse* reparse, unsigned start, unsigned end, unsigned indent, bool is_map)
+/*
+ * Parse lines from `start` to `end` which make a single map entry or list item
+ * with given indent.
+ *
+ * Return map or list containing that entry or item.
+ */
+{
+    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(reparse->lines);
+    if (!parser) {
+        return UwOOM();
+    }
+    parser->line_index = start;
+    parser->end_line_index = end;
+    parser->block_indent = indent;
+
+    AmwReadResult status = _amw_read_block_line(parser);
+    if (status == AMW_END_OF_BLOCK) {
+        return amw_parser_error(parser, 0, "Empty block");
+    }
+    _amw_return_if_read_error(parser, status);
+
+    return _amw_parse_part(parser, is_map, true);
+}
+
+static UwResult reparse_block(Reparse* reparse, UwValuePtr container, unsigned start, unsigned end)
+/*
+ * Reparse the block of lines from `start` to `end` which previously
+ * was parsed into `container` and return the new value.
+ *
+ * Return error if the edit changed the structure of the block.
+ * The caller should parse the block as a whole in this case.
+ */
+{
+    bool is_map = uw_is_map(container);
+    if (!is_map && !uw_is_array(container)) {
+        return UwError(AMW_PARSE_ERROR);
+    }
+    if (block_has_convspec(reparse, start, end)) {
+        // e.g. the whole block is JSON
+        return UwError(AMW_PARSE_ERROR);
+    }
+
+    // find entries: significant lines with the same indent as the first one,
+    // and the entry that contains the beginning of edited lines
+
+    unsigned num_items = is_map? uw_map_length(container) : uw_array_length(container);
+    unsigned num_chunks = 0;
+    unsigned indent = 0;
+    unsigned n = 0;
+    unsigned chunk_start = start;  // leading comments belong to the first entry
+    unsigned chunk_end = end;
+
+    for (unsigned i = start; i < end; i++) {{
+        UwValue line = uw_array_item(reparse->lines, i);
+        unsigned line_indent;
+        if (!_amw_significant_line(&line, &line_indent)) {
+            continue;
+        }
+        if (num_chunks == 0) {
+            indent = line_indent;
+        } else if (line_indent < indent) {
+            return UwError(AMW_PARSE_ERROR);
+        } else if (line_indent > indent) {
+            continue;
+        } else if (i <= reparse->edit_start) {
+            n = num_chunks;
+            chunk_start = i;
+        } else if (chunk_end == end) {
+            chunk_end = i;
+        }
+        num_chunks++;
+    }}
+    if (num_chunks != num_items || num_chunks == 0) {
+        // entries were added or removed
+        return UwError(AMW_PARSE_ERROR);
+    }
+    if (reparse->edit_end > chunk_end) {
+        // edited lines span multiple entries
+        return UwError(AMW_PARSE_ERROR);
+    }
+
+    // get the first significant line of the entry
+    unsigned first_line = chunk_start;
+    while (first_line < chunk_end) {{
+        UwValue line = uw_array_item(reparse->lines, first_line);
+        unsigned line_indent;
+        if (_amw_significant_line(&line, &line_indent)) {
+            break;
+        }
+        first_line++;
+    }}
+
+    // get the old entry
+    UwValue key = UwNull();
+    UwValue value = UwNull();
+    if (is_map) {
+        uw_map_item(container, n, &key, &value);
+    } else {
+        value = uw_array_item(container, n);
+    }
+
+    // try the smallest enclosing block first
+    UwValue new_value = UwNull();
+    if (reparse->edit_start > first_line && (uw_is_map(&value) || uw_is_array(&value))) {
+        UwValue line = uw_array_item(reparse->lines, first_line);
+        if (nested_block_from_next_line(&line, indent)
+            && !block_has_convspec(reparse, first_line + 1, chunk_end)) {
+            new_value = reparse_block(reparse, &value, first_line + 1, chunk_end);
+            if (uw_error(&new_value)) {
+                uw_destroy(&new_value);
+            }
+        }
+    }
+
+    // make new container sharing all other entries
+
+    UwValue result = is_map? UwMap() : UwArray();
+    uw_return_if_error(&result);
+
+    for (unsigned i = 0; i < num_chunks; i++) {{
+        UwValue item_key = UwNull();
+        UwValue item = UwNull();
+        if (i != n) {
+            if (is_map) {
+                uw_map_item(container, i, &item_key, &item);
+            } else {
+                item = uw_array_item(container, i);
+            }
+        } else if (!uw_is_null(&new_value)) {
+            item_key = uw_clone(&key);
+            item = uw_move(&new_value);
+        } else {
+            UwValue part = parse_chunk(reparse, chunk_start, chunk_end, indent, is_map);
+            uw_return_if_error(&part);
+            if (is_map) {
+                if (uw_map_length(&part) != 1) {
+                    return UwError(AMW_PARSE_ERROR);
+                }
+                uw_map_item(&part, 0, &item_key, &item);
+            } else {
+                if (uw_array_length(&part) != 1) {
+                    return UwError(AMW_PARSE_ERROR);
+                }
+                item = uw_array_item(&part, 0);
+            }
+        }
+        if (is_map) {
+            uw_expect_ok( uw_map_update(&result, &item_key, &item) );
+        } else {
+            uw_expect_ok( uw_array_append(&result, &item) );
+        }
+    }}
+
+    if (is_map && uw_map_length(&result) != num_chunks) {
+        // changed key duplicates another one
+        return UwError(AMW_PARSE_ERROR);
+    }
+    return uw_move(&result);
+}
+
+UwResult amw_reparse(UwValuePtr doc, UwValuePtr source_lines, AmwEdit* edits, unsigned num_edits)
+{
+    if (!uw_is_array(source_lines)) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+
+    Reparse reparse;
+    UwValue lines = apply_edits(source_lines, edits, num_edits, &reparse);
+    uw_return_if_error(&lines);
+
+    uw_destroy(source_lines);
+    *source_lines = uw_clone(&lines);
+    reparse.lines = &lines;
+
+    if (num_edits == 0) {
+        return uw_clone(doc);
+    }
+
+    // top-level block must start from the first column, see amw_parse_parallel
+    unsigned num_lines = uw_array_length(&lines);
+    for (unsigned i = 0; i < num_lines; i++) {{
+        UwValue line = uw_array_item(&lines, i);
+        unsigned indent;
+        if (_amw_significant_line(&line, &indent)) {
+            if (indent == 0) {
+                UwValue result = reparse_block(&reparse, doc, 0, num_lines);
+                if (!uw_error(&result)) {
+                    return uw_move(&result);
+                }
+            }
+            break;
+        }
+    }}
+
+    // parse the whole source
+    return amw_parse(&lines);
+}
@@ -0,0 +1,353 @@
+#include <string.h>
+
+#include <amw.h>
+
+UwResult amw_init_schema(AmwSchema* schema)
+{
+    for (unsigned i = 0; i < schema->num_fields; i++) {{
+        AmwField* field = &schema->fields[i];
+
+        UwValue name = uw_create_string(field->name);
+        uw_return_if_error(&name);
+
+        field->name_hash = _amw_hash_string(&name);
+        field->name_length = uw_strlen(&name);
+
+        if (field->type == AMW_FIELD_STRUCT) {
+            if (!field->schema) {
+                return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+            }
+            if (!field->schema->initialized) {
+                UwValue status = amw_init_schema(field->schema);
+                uw_return_if_error(&status);
+            }
+        }
+    }}
+    schema->initialized = true;
+    return UwOK();
+}
+
+static inline void* field_ptr(AmwField* field, void* out)
+{
+    return ((char*) out) + field->offset;
+}
+
+static void clear_struct(AmwSchema* schema, void* out)
+/*
+ * Initialize all fields with zeroes and nulls, so the struct can be destroyed at any point.
+ */
+{
+    for (unsigned i = 0; i < schema->num_fields; i++) {
+        AmwField* field = &schema->fields[i];
+        void* ptr = field_ptr(field, out);
+        switch (field->type) {
+            case AMW_FIELD_BOOL:   *(bool*) ptr = false; break;
+            case AMW_FIELD_INT:    *(int64_t*) ptr = 0; break;
+            case AMW_FIELD_UINT:   *(uint64_t*) ptr = 0; break;
+            case AMW_FIELD_FLOAT:  *(double*) ptr = 0.0; break;
+            case AMW_FIELD_STRING:
+            case AMW_FIELD_VALUE:  *(UwValuePtr) ptr = UwNull(); break;
+            case AMW_FIELD_STRUCT: clear_struct(field->schema, ptr); break;
+        }
+    }
+}
+
+static UwResult set_defaults(AmwSchema* schema, void* out)
+{
+    for (unsigned i = 0; i < schema->num_fields; i++) {{
+        AmwField* field = &schema->fields[i];
+        void* ptr = field_ptr(field, out);
+        if (field->type == AMW_FIELD_STRUCT) {
+            UwValue status = set_defaults(field->schema, ptr);
+            uw_return_if_error(&status);
+            continue;
+        }
+        if (!field->has_default) {
+            continue;
+        }
+        switch (field->type) {
+            case AMW_FIELD_BOOL:  *(bool*) ptr = field->default_value.bool_value; break;
+            case AMW_FIELD_INT:   *(int64_t*) ptr = field->default_value.signed_value; break;
+            case AMW_FIELD_UINT:  *(uint64_t*) ptr = field->default_value.unsigned_value; break;
+            case AMW_FIELD_FLOAT: *(double*) ptr = field->default_value.float_value; break;
+            case AMW_FIELD_STRING:
+            case AMW_FIELD_VALUE:
+                if (field->default_value.string_value) {
+                    UwValue str = uw_create_string(field->default_value.string_value);
+                    uw_return_if_error(&str);
+                    *(UwValuePtr) ptr = uw_move(&str);
+                }
+                break;
+            default:
+                break;
+        }
+    }}
+    return UwOK();
+}
+
+void amw_destroy_struct(AmwSchema* schema, void* out)
+{
+    for (unsigned i = 0; i < schema->num_fields; i++) {
+        AmwField* field = &schema->fields[i];
+        void* ptr = field_ptr(field, out);
+        if (field->type == AMW_FIELD_STRING || field->type == AMW_FIELD_VALUE) {
+            uw_destroy((UwValuePtr) ptr);
+        } else if (field->type == AMW_FIELD_STRUCT) {
+            amw_destroy_struct(field->schema, ptr);
+        }
+    }
+}
+
+static int find_field(AmwSchema* schema, UwValuePtr str, unsigned start_pos, unsigned end_pos)
+/*
+ * Find field by name in `str` from `start_pos` to `end_pos`.
+ * Return field index or -1.
+ */
+{
+    unsigned length = end_pos - start_pos;
+    uint64_t hash = _amw_hash_substring(str, start_pos, end_pos);
+    for (unsigned i = 0; i < schema->num_fields; i++) {
+        AmwField* field = &schema->fields[i];
+        if (field->name_hash == hash && field->name_length == length
+                && uw_substring_eq(str, start_pos, end_pos, field->name)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static UwResult store_value(AmwParser* parser, AmwField* field, UwValuePtr value, void* ptr,
+                            unsigned line_number, unsigned value_pos)
+/*
+ * Convert scalar value to field type and write it to the struct.
+ */
+{
+    switch (field->type) {
+        case AMW_FIELD_BOOL:
+            if (uw_is_bool(value)) {
+                *(bool*) ptr = value->bool_value;
+                return UwOK();
+            }
+            break;
+
+        case AMW_FIELD_INT:
+            if (uw_is_signed(value)) {
+                *(int64_t*) ptr = value->signed_value;
+                return UwOK();
+            }
+            if (uw_is_unsigned(value) && value->unsigned_value <= INT64_MAX) {
+                *(int64_t*) ptr = (int64_t) value->unsigned_value;
+                return UwOK();
+            }
+            break;
+
+        case AMW_FIELD_UINT:
+            if (uw_is_unsigned(value)) {
+                *(uint64_t*) ptr = value->unsigned_value;
+                return UwOK();
+            }
+            if (uw_is_signed(value) && value->signed_value >= 0) {
+                *(uint64_t*) ptr = (uint64_t) value->signed_value;
+                return UwOK();
+            }
+            break;
+
+        case AMW_FIELD_FLOAT:
+            if (uw_is_float(value)) {
+                *(double*) ptr = value->float_value;
+                return UwOK();
+            }
+            if (uw_is_signed(value)) {
+                *(double*) ptr = (double) value->signed_value;
+                return UwOK();
+            }
+            if (uw_is_unsigned(value)) {
+                *(double*) ptr = (double) value->unsigned_value;
+                return UwOK();
+            }
+            break;
+
+        case AMW_FIELD_STRING:
+            if (!uw_is_string(value)) {
+                break;
+            }
+            [[fallthrough]];
+
+        case AMW_FIELD_VALUE:
+            // the key may be repeated, the last value wins
+            uw_destroy((UwValuePtr) ptr);
+            *(UwValuePtr) ptr = uw_move(value);
+            return UwOK();
+
+        default:
+            break;
+    }
+    return amw_parser_error2(parser, line_number, value_pos, "Bad value for %s", field->name);
+}
+
+static UwResult skip_value(AmwParser* parser, AmwBlockParserFunc convspec, unsigned value_pos)
+/*
+ * Check value of unknown key without constructing it.
+ */
+{
+    bool saved_validate_only = parser->validate_only;
+    parser->validate_only = true;
+    UwValue value = _amw_parse_map_value(parser, convspec, value_pos);
+    parser->validate_only = saved_validate_only;
+    uw_return_if_error(&value);
+    return UwOK();
+}
+
+static AmwField* find_required_field(AmwSchema* schema)
+/*
+ * Return the first field that must be present in the markup if the struct key is missing,
+ * or nullptr if the struct can be omitted.
+ */
+{
+    for (unsigned i = 0; i < schema->num_fields; i++) {
+        AmwField* field = &schema->fields[i];
+        if (field->required) {
+            return field;
+        }
+        if (field->type == AMW_FIELD_STRUCT && !field->optional) {
+            AmwField* nested = find_required_field(field->schema);
+            if (nested) {
+                return nested;
+            }
+        }
+    }
+    return nullptr;
+}
+
+static UwResult parse_struct(AmwParser* parser, AmwSchema* schema, void* out)
+/*
+ * Parse map in the current block into struct.
+ *
+ * Nesting of structs is limited by schema, so this function is recursive.
+ */
+{
+    bool seen[schema->num_fields + 1];
+    memset(seen, 0, sizeof(seen));
+
+    unsigned indent = _amw_get_start_position(parser);
+
+    for (;;) {{
+        unsigned key_start = 0;
+        unsigned key_end = 0;
+        unsigned value_pos = 0;
+        AmwBlockParserFunc convspec = nullptr;
+        UwValue quoted_key = _amw_parse_key(parser, &key_start, &key_end, &convspec, &value_pos);
+        uw_return_if_error(&quoted_key);
+
+        int index;
+        if (uw_is_string(&quoted_key)) {
+            index = find_field(schema, &quoted_key, 0, uw_strlen(&quoted_key));
+        } else {
+            index = find_field(schema, &parser->current_line, key_start, key_end);
+        }
+        unsigned line_number = parser->line_number;
+
+        if (index < 0) {
+            UwValue status = skip_value(parser, convspec, value_pos);
+            uw_return_if_error(&status);
+
+        } else if (schema->fields[index].type == AMW_FIELD_STRUCT) {
+            AmwField* field = &schema->fields[index];
+            if (convspec) {
+                return amw_parser_error2(parser, line_number, value_pos, "Map expected for %s", field->name);
+            }
+            unsigned saved_block_indent;
+            UwValue status = _amw_enter_value_block(parser, value_pos, &saved_block_indent);
+            uw_return_if_error(&status);
+
+            UwValue result = parse_struct(parser, field->schema, field_ptr(field, out));
+            _amw_leave_block(parser, saved_block_indent);
+            uw_return_if_error(&result);
+
+        } else {
+            AmwField* field = &schema->fields[index];
+            UwValue value = _amw_parse_map_value(parser, convspec, value_pos);
+            uw_return_if_error(&value);
+
+            UwValue status = store_value(parser, field, &value, field_ptr(field, out), line_number, value_pos);
+            uw_return_if_error(&status);
+        }
+        if (index >= 0) {
+            seen[index] = true;
+        }
+
+        // read next key
+        AmwReadResult status = _amw_read_block_line(parser);
+        if (status == AMW_END_OF_BLOCK) {
+            break;
+        }
+        _amw_return_if_read_error(parser, status);
+
+        if (parser->current_indent != indent) {
+            return amw_parser_error(parser, parser->current_indent, "Bad indentation of map key");
+        }
+    }}
+
+    for (unsigned i = 0; i < schema->num_fields; i++) {
+        AmwField* field = &schema->fields[i];
+        if (seen[i]) {
+            continue;
+        }
+        if (field->required) {
+            return amw_parser_error(parser, indent, "Missing %s", field->name);
+        }
+        if (field->type == AMW_FIELD_STRUCT && !field->optional) {
+            AmwField* nested = find_required_field(field->schema);
+            if (nested) {
+                return amw_parser_error(parser, indent, "Missing %s, required in %s", nested->name, field->name);
+            }
+        }
+    }
+    return UwOK();
+}
+
+static UwResult parse_markup_into(UwValuePtr markup, AmwSchema* schema, void* out)
+{
+    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(markup);
+    if (!parser) {
+        return UwOOM();
+    }
+
+    // read first line to prepare for parsing and to detect EOF
+    AmwReadResult status = _amw_read_block_line(parser);
+    if (status == AMW_END_OF_BLOCK && parser->eof) {
+        return UwStatus(UW_ERROR_EOF);
+    }
+    _amw_return_if_read_error(parser, status);
+
+    UwValue result = parse_struct(parser, schema, out);
+    uw_return_if_error(&result);
+
+    // make sure markup has no more data
+    status = _amw_read_block_line(parser);
+    if (!parser->eof) {
+        _amw_return_if_read_error(parser, status);
+        return amw_parser_error(parser, parser->current_indent, "Extra data after parsed value");
+    }
+    return UwOK();
+}
+
+UwResult amw_parse_into(UwValuePtr markup, AmwSchema* schema, void* out)
+{
+    if (!schema->initialized) {
+        UwValue status = amw_init_schema(schema);
+        uw_return_if_error(&status);
+    }
+    clear_struct(schema, out);
+
+    UwValue status = set_defaults(schema, out);
+    if (!uw_error(&status)) {
+        uw_destroy(&status);
+        status = parse_markup_into(markup, schema, out);
+    }
+    if (uw_error(&status)) {
+        amw_destroy_struct(schema, out);
+        return uw_move(&status);
+    }
+    return UwOK();
+}
@@ -0,0 +1,339 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <amw.h>
+
+/*
+ * Segment layout: header followed by compiled image.
+ *
+ * Segments are private to the user: the name includes effective uid,
+ * the segment is created with mode 0600, and readers accept only segments
+ * owned by the same user and not writable by anyone else.
+ * Otherwise any local user could create the predictable name first
+ * and inject values.
+ *
+ * The first process claims the name before parsing: it creates segment with O_EXCL
+ * and writes its pid to the header. Processes started at the same time find
+ * the segment and wait in `attach` instead of parsing the same file.
+ * When the document is compiled, the owner extends the segment, writes the image,
+ * and then sets `ready` flag with release semantic. Readers check the flag
+ * with acquire semantic. If the owner dies, waiting processes remove the segment
+ * and one of them claims the name again. If the owner fails, it marks the segment
+ * abandoned and removes it, so waiting processes parse the file themselves.
+ */
+
+// values of `ready` flag
+#define SHM_PUBLISHING  0
+#define SHM_READY       1
+#define SHM_ABANDONED   2   // the owner failed to parse the file and removed the segment
+
+typedef struct {
+    atomic_uint  ready;
+    atomic_uint  creator_pid;
+    uint64_t     content_hash;
+    uint64_t     image_size;
+    uint64_t     reserved;
+} ShmHeader;
+
+_Static_assert(sizeof(ShmHeader) % _Alignof(AmwCompiledNode) == 0, "image must be aligned");
+
+#define POLL_INTERVAL_MS  1
+
+typedef enum {
+    SHM_OK = 0,
+    SHM_MISSING,   // segment does not exist
+    SHM_STALE,     // segment was removed because its publisher is dead
+    SHM_BUSY,      // publisher is still working after AMW_SHM_WAIT_MS
+    SHM_FAILED     // shared memory is not usable
+} ShmResult;
+
+static void make_name(char* buf, size_t size, uint64_t content_hash)
+{
+    snprintf(buf, size, "/amw-v%d-%u-%016llx", AMW_COMPILED_VERSION,
+             (unsigned) geteuid(), (unsigned long long) content_hash);
+}
+
+static void sleep_ms(unsigned ms)
+{
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+    nanosleep(&ts, nullptr);
+}
+
+static bool process_alive(pid_t pid)
+{
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+static ShmResult attach(char* name, uint64_t content_hash, AmwCompiled* compiled)
+/*
+ * Map existing segment and wait until it's ready.
+ */
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) {
+        return (errno == ENOENT)? SHM_MISSING : SHM_FAILED;
+    }
+    struct stat owner;
+    if (fstat(fd, &owner) == -1
+        || owner.st_uid != geteuid()
+        || (owner.st_mode & (S_IWGRP | S_IWOTH))) {
+        // not ours, do not trust it and do not try to remove it
+        close(fd);
+        return SHM_FAILED;
+    }
+    ShmResult result = SHM_BUSY;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+
+    for (unsigned waited = 0; waited <= AMW_SHM_WAIT_MS; waited += POLL_INTERVAL_MS) {
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            result = SHM_FAILED;
+            break;
+        }
+        if ((size_t) st.st_size >= sizeof(ShmHeader)) {
+            if (!mapping) {
+                mapping_size = st.st_size;
+                mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+                if (mapping == MAP_FAILED) {
+                    mapping = nullptr;
+                    result = SHM_FAILED;
+                    break;
+                }
+            }
+            ShmHeader* header = mapping;
+            unsigned state = atomic_load_explicit(&header->ready, memory_order_acquire);
+            if (state == SHM_ABANDONED) {
+                // already removed, the name may belong to a new owner
+                result = SHM_STALE;
+                break;
+            }
+            if (state == SHM_READY) {
+                // the segment was claimed with header only and extended before it got ready
+                if (fstat(fd, &st) == -1) {
+                    result = SHM_FAILED;
+                    break;
+                }
+                if ((size_t) st.st_size > mapping_size) {
+                    munmap(mapping, mapping_size);
+                    mapping_size = st.st_size;
+                    mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+                    if (mapping == MAP_FAILED) {
+                        mapping = nullptr;
+                        result = SHM_FAILED;
+                        break;
+                    }
+                    header = mapping;
+                }
+                bool valid = false;
+                if (header->content_hash == content_hash
+                    && sizeof(ShmHeader) + header->image_size <= mapping_size) {
+                    UwValue status = amw_init_compiled(compiled, (uint8_t*) mapping + sizeof(ShmHeader),
+                                                       header->image_size);
+                    valid = uw_ok(&status);
+                }
+                if (valid) {
+                    compiled->mapping = mapping;
+                    compiled->mapping_size = mapping_size;
+                    close(fd);
+                    return SHM_OK;
+                }
+                // bad segment
+                shm_unlink(name);
+                result = SHM_STALE;
+                break;
+            }
+            pid_t pid = atomic_load_explicit(&header->creator_pid, memory_order_relaxed);
+            if (pid && !process_alive(pid)) {
+                shm_unlink(name);
+                result = SHM_STALE;
+                break;
+            }
+        } else if (time(nullptr) - st.st_ctime > AMW_SHM_WAIT_MS / 1000) {
+            // the owner died before writing the header
+            shm_unlink(name);
+            result = SHM_STALE;
+            break;
+        }
+        sleep_ms(POLL_INTERVAL_MS);
+    }
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    }
+    close(fd);
+    return result;
+}
+
+static ShmResult claim(char* name, int* fd_out)
+/*
+ * Create segment with header only and write our pid to it.
+ * Return SHM_BUSY if another process has claimed the name.
+ */
+{
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1) {
+        return (errno == EEXIST)? SHM_BUSY : SHM_FAILED;
+    }
+    if (ftruncate(fd, sizeof(ShmHeader)) == -1) {
+        close(fd);
+        shm_unlink(name);
+        return SHM_FAILED;
+    }
+    ShmHeader* header = mmap(nullptr, sizeof(ShmHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (header == MAP_FAILED) {
+        close(fd);
+        shm_unlink(name);
+        return SHM_FAILED;
+    }
+    atomic_store_explicit(&header->creator_pid, getpid(), memory_order_relaxed);
+    munmap(header, sizeof(ShmHeader));
+    *fd_out = fd;
+    return SHM_OK;
+}
+
+static void abandon(int fd, char* name)
+/*
+ * Mark claimed segment abandoned, remove it, and close the descriptor.
+ */
+{
+    ShmHeader* header = mmap(nullptr, sizeof(ShmHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (header != MAP_FAILED) {
+        atomic_store_explicit(&header->ready, SHM_ABANDONED, memory_order_release);
+        munmap(header, sizeof(ShmHeader));
+    }
+    shm_unlink(name);
+    close(fd);
+}
+
+static ShmResult publish(int fd, char* name, uint64_t content_hash, uint8_t* image, size_t image_size,
+                         AmwCompiled* compiled)
+/*
+ * Write image to claimed segment and mark it ready.
+ * On failure the segment is abandoned. The descriptor is always closed.
+ */
+{
+    size_t mapping_size = sizeof(ShmHeader) + image_size;
+    if (ftruncate(fd, mapping_size) == -1) {
+        abandon(fd, name);
+        return SHM_FAILED;
+    }
+    void* mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        abandon(fd, name);
+        return SHM_FAILED;
+    }
+    close(fd);
+    ShmHeader* header = mapping;
+    header->content_hash = content_hash;
+    header->image_size = image_size;
+    memcpy((uint8_t*) mapping + sizeof(ShmHeader), image, image_size);
+    atomic_store_explicit(&header->ready, SHM_READY, memory_order_release);
+
+    UwValue status = amw_init_compiled(compiled, (uint8_t*) mapping + sizeof(ShmHeader), image_size);
+    if (uw_error(&status)) {
+        munmap(mapping, mapping_size);
+        return SHM_FAILED;
+    }
+    compiled->mapping = mapping;
+    compiled->mapping_size = mapping_size;
+    return SHM_OK;
+}
+
+static UwResult compile_data(uint8_t* data, size_t size, uint8_t** image, size_t* image_size)
+/*
+ * Parse file data and compile the document.
+ */
+{
+    UwValue lines = amw_split_lines((char*) data, size);
+    uw_return_if_error(&lines);
+
+    UwValue doc = amw_parse(&lines);
+    uw_return_if_error(&doc);
+
+    return _amw_compile_to_buffer(&doc, image, image_size);
+}
+
+// attempts to attach to or claim the segment, the owner may die while others wait
+#define MAX_CLAIM_ATTEMPTS  3
+
+UwResult amw_shm_load(char* path, AmwCompiled* compiled)
+{
+    // read file and compute content hash
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return _amw_io_error("Cannot open", path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        UwValue status = _amw_io_error("Cannot stat", path);
+        close(fd);
+        return uw_move(&status);
+    }
+    uint8_t* data;
+    UwValue status = _amw_read_fd(fd, path, st.st_size, &data);
+    close(fd);
+    uw_return_if_error(&status);
+
+    uint64_t content_hash = amw_fnv1a(data, st.st_size, AMW_FNV_OFFSET_BASIS);
+
+    char name[64];
+    make_name(name, sizeof(name), content_hash);
+
+    // use published document or claim the name before parsing
+
+    int claim_fd = -1;
+    for (unsigned attempt = 0; attempt < MAX_CLAIM_ATTEMPTS; attempt++) {
+        ShmResult shm_result = attach(name, content_hash, compiled);
+        if (shm_result == SHM_OK) {
+            release((void**) &data, st.st_size + 1);
+            return UwOK();
+        }
+        if (shm_result != SHM_MISSING && shm_result != SHM_STALE) {
+            // the owner is too slow or shared memory is not usable
+            break;
+        }
+        shm_result = claim(name, &claim_fd);
+        if (shm_result != SHM_BUSY) {
+            break;
+        }
+        // another process claimed the name after attach, wait for it
+    }
+
+    // parse and compile
+
+    uint8_t* image;
+    size_t image_size;
+    UwValue compile_status = compile_data(data, st.st_size, &image, &image_size);
+    release((void**) &data, st.st_size + 1);
+    if (uw_error(&compile_status)) {
+        if (claim_fd != -1) {
+            // let waiting processes parse the file and get the error too
+            abandon(claim_fd, name);
+        }
+        return uw_move(&compile_status);
+    }
+
+    if (claim_fd != -1
+        && publish(claim_fd, name, content_hash, image, image_size, compiled) == SHM_OK) {
+        release((void**) &image, image_size);
+        return UwOK();
+    }
+
+    // fall back to private copy
+    UwValue init_status = amw_init_compiled(compiled, image, image_size);
+    if (uw_error(&init_status)) {
+        release((void**) &image, image_size);
+        return uw_move(&init_status);
+    }
+    compiled->allocated = true;
+    return UwOK();
+}
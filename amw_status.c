@@ -2,8 +2,9 @@
 
 UwTypeId UwTypeId_AmwStatus = 0;
 
-uint16_t AMW_END_OF_BLOCK = 0;
 uint16_t AMW_PARSE_ERROR = 0;
+uint16_t AMW_IO_ERROR = 0;
+uint16_t AMW_BAD_COMPILED_DATA = 0;
 
 static UwResult amw_status_create(UwTypeId type_id, void* ctor_args)
 {
@@ -77,6 +78,7 @@ static void init_amw_status()
     amw_status_type.to_string = amw_status_to_string;
 
     // init status codes
-    AMW_END_OF_BLOCK = uw_define_status("END_OF_BLOCK");
-    AMW_PARSE_ERROR  = uw_define_status("PARSE_ERROR");
+    AMW_PARSE_ERROR       = uw_define_status("PARSE_ERROR");
+    AMW_IO_ERROR          = uw_define_status("IO_ERROR");
+    AMW_BAD_COMPILED_DATA = uw_define_status("BAD_COMPILED_DATA");
 }
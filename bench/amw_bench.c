@@ -0,0 +1,255 @@
+/*
+ * Parser benchmarks.
+ *
+ * Usage: amw_bench [--size BYTES] [--min-time SECONDS] [--only CORPUS] [--output FILE]
+ *
+ * Each synthetic corpus (see corpus.c) is parsed with amw_parse,
+ * then converted to JSON and parsed with amw_parse_json.
+ * Markup is split into lines beforehand, so only parsing is measured.
+ *
+ * Each benchmark is repeated until it runs at least `--min-time` seconds
+ * (0.5 by default) and at least three times; the best time is reported.
+ * Allocations, bytes copied by memcpy and memmove, and instructions
+ * are counted during the first run. These metrics do not depend on CPU frequency
+ * and load, see bench_compare.c. Instructions are null if hardware counters
+ * are not available.
+ *
+ * Results are written to stdout as JSON:
+ *
+ *     {"size": ..., "results": [{"name": "wide_map", "format": "amw", "bytes": ..., ...}, ...]}
+ *
+ * or to FILE if --output is given.
+ *
+ * Peak RSS is process-wide and never decreases, use --only to measure
+ * a single corpus.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <amw.h>
+
+#include "common.h"
+#include "bench.h"
+#include "corpus.h"
+
+#define DEFAULT_SIZE      (4 << 20)
+#define DEFAULT_MIN_TIME  0.5
+#define MIN_ITERATIONS    3
+
+typedef struct {
+    char*     name;
+    char*     format;
+    size_t    bytes;
+    unsigned  lines;
+    uint64_t  values;
+    unsigned  iterations;
+    uint64_t  best_ns;
+    uint64_t  total_ns;
+    uint64_t  allocations;
+    uint64_t  allocated_bytes;
+    uint64_t  copied_bytes;
+    uint64_t  instructions;
+    bool      have_instructions;
+    long      peak_rss_kb;
+} BenchResult;
+
+static FILE* output;
+
+// instruction counter, -1 if not available
+static int instruction_counter = -1;
+
+static uint64_t count_values(UwValuePtr value)
+/*
+ * Return the number of values in the tree, including containers and map keys.
+ */
+{
+    uint64_t n = 1;
+    if (uw_is_array(value)) {
+        unsigned length = uw_array_length(value);
+        for (unsigned i = 0; i < length; i++) {{
+            UwValue item = uw_array_item(value, i);
+            n += count_values(&item);
+        }}
+    } else if (uw_is_map(value)) {
+        unsigned length = uw_map_length(value);
+        for (unsigned i = 0; i < length; i++) {{
+            UwValue key = UwNull();
+            UwValue item = UwNull();
+            uw_map_item(value, i, &key, &item);
+            n += 1 + count_values(&item);
+        }}
+    }
+    return n;
+}
+
+static UwResult run_benchmark(BenchResult* result, UwValuePtr lines, UwResult (*parse)(UwValuePtr),
+                              double min_time)
+{
+    result->lines = uw_array_length(lines);
+
+    uint64_t min_ns = (uint64_t) (min_time * 1e9);
+
+    while (result->iterations < MIN_ITERATIONS || result->total_ns < min_ns) {{
+        AllocStats start_stats = alloc_stats;
+        uint64_t start_copied = copied_bytes;
+        uint64_t start_instructions = 0;
+        bool have_instructions = bench_read_counter(instruction_counter, &start_instructions);
+        uint64_t start = bench_now_ns();
+
+        UwValue value = parse(lines);
+
+        uint64_t elapsed = bench_now_ns() - start;
+        uint64_t end_instructions = 0;
+        have_instructions = have_instructions && bench_read_counter(instruction_counter, &end_instructions);
+        uw_return_if_error(&value);
+
+        if (result->iterations == 0) {
+            result->allocations = alloc_stats.count - start_stats.count;
+            result->allocated_bytes = alloc_stats.bytes - start_stats.bytes;
+            result->copied_bytes = copied_bytes - start_copied;
+            result->have_instructions = have_instructions;
+            result->instructions = end_instructions - start_instructions;
+            result->values = count_values(&value);
+            result->best_ns = elapsed;
+        } else if (elapsed < result->best_ns) {
+            result->best_ns = elapsed;
+        }
+        result->total_ns += elapsed;
+        result->iterations++;
+    }}
+    result->peak_rss_kb = bench_peak_rss_kb();
+    return UwOK();
+}
+
+static void print_result(BenchResult* result, bool first)
+{
+    double seconds = result->best_ns / 1e9;
+    if (seconds <= 0) {
+        seconds = 1e-9;
+    }
+    char instructions[24] = "null";
+    if (result->have_instructions) {
+        snprintf(instructions, sizeof(instructions), "%llu", (unsigned long long) result->instructions);
+    }
+    fprintf(output, "%s\n    {\"name\": \"%s\", \"format\": \"%s\", \"bytes\": %zu, \"lines\": %u, \"values\": %llu,"
+            " \"iterations\": %u, \"best_ns\": %llu, \"mean_ns\": %llu,"
+            " \"mb_per_s\": %.2f, \"values_per_s\": %.0f,"
+            " \"allocations\": %llu, \"allocated_bytes\": %llu, \"copied_bytes\": %llu,"
+            " \"instructions\": %s, \"peak_rss_kb\": %ld}",
+            first? "" : ",",
+            result->name, result->format, result->bytes, result->lines,
+            (unsigned long long) result->values, result->iterations,
+            (unsigned long long) result->best_ns,
+            (unsigned long long) (result->total_ns / result->iterations),
+            result->bytes / seconds / 1e6, result->values / seconds,
+            (unsigned long long) result->allocations, (unsigned long long) result->allocated_bytes,
+            (unsigned long long) result->copied_bytes, instructions, result->peak_rss_kb);
+    fflush(output);
+}
+
+static UwResult bench_corpus(Corpus* corpus, size_t size, double min_time, bool* first)
+{
+    AmwOutput markup;
+    UwValue status = amw_init_output(&markup, 0, nullptr, nullptr);
+    uw_return_if_error(&status);
+
+    status = corpus_generate(corpus, size, &markup);
+    if (uw_error(&status)) {
+        amw_fini_output(&markup);
+        return uw_move(&status);
+    }
+    UwValue lines = amw_split_lines(markup.data, markup.length);
+    BenchResult result = { .name = corpus->name, .format = "amw", .bytes = markup.length };
+    amw_fini_output(&markup);
+    uw_return_if_error(&lines);
+
+    status = run_benchmark(&result, &lines, amw_parse, min_time);
+    uw_return_if_error(&status);
+    print_result(&result, *first);
+    *first = false;
+
+    // convert to JSON
+    UwValue value = amw_parse(&lines);
+    uw_return_if_error(&value);
+    uw_destroy(&lines);
+
+    AmwOutput json;
+    status = amw_init_output(&json, 0, nullptr, nullptr);
+    uw_return_if_error(&status);
+    status = amw_dump_json(&value, &json);
+    if (uw_error(&status)) {
+        amw_fini_output(&json);
+        return uw_move(&status);
+    }
+    uw_destroy(&value);
+    lines = amw_split_lines(json.data, json.length);
+    result = (BenchResult) { .name = corpus->name, .format = "json", .bytes = json.length };
+    amw_fini_output(&json);
+    uw_return_if_error(&lines);
+
+    status = run_benchmark(&result, &lines, amw_parse_json, min_time);
+    uw_return_if_error(&status);
+    print_result(&result, false);
+    return UwOK();
+}
+
+int main(int argc, char* argv[])
+{
+    size_t size = DEFAULT_SIZE;
+    double min_time = DEFAULT_MIN_TIME;
+    char* only = nullptr;
+    char* output_path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            size = strtoull(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_path = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--size BYTES] [--min-time SECONDS] [--only CORPUS] [--output FILE]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (size == 0) {
+        fprintf(stderr, "%s: bad size\n", argv[0]);
+        return 2;
+    }
+    output = stdout;
+    if (output_path) {
+        output = fopen(output_path, "w");
+        if (!output) {
+            perror(output_path);
+            return 1;
+        }
+    }
+    instruction_counter = bench_open_instruction_counter();
+
+    fprintf(output, "{\"size\": %zu, \"results\": [", size);
+
+    bool first = true;
+    int exit_code = 0;
+    for (unsigned i = 0; i < num_corpora; i++) {{
+        Corpus* corpus = &corpora[i];
+        if (only && strcmp(only, corpus->name) != 0) {
+            continue;
+        }
+        UwValue status = bench_corpus(corpus, size, min_time, &first);
+        if (uw_error(&status)) {
+            print_error(corpus->name, &status);
+            exit_code = 1;
+        }
+    }}
+    fprintf(output, "\n]}\n");
+    if (output_path && fclose(output) != 0) {
+        perror(output_path);
+        return 1;
+    }
+    return exit_code;
+}
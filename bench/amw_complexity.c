@@ -0,0 +1,244 @@
+/*
+ * Check that parsing time of adversarial inputs grows linearly.
+ *
+ * Usage: amw_complexity [--size BYTES] [--min-time SECONDS] [--only CASE]
+ *
+ * Each case generates crafted markup of `--size` bytes (256 KiB by default)
+ * and of twice that size, parses both with amw_parse, and compares
+ * time per byte. Growth is the ratio of time per byte of the larger input
+ * to the smaller one: it is close to 1 for linear parsing and close to 2
+ * for quadratic. The check fails if growth exceeds MAX_GROWTH or markup
+ * fails to parse.
+ *
+ * Cases are worst-case inputs for paths that rescan the line:
+ *
+ *   colon_runs      colons that look like conversion specifiers
+ *   spaced_colons   key-value separator candidates followed by unknown conversion specifiers
+ *   backslash_runs  quoted string full of escaped quotes after long backslash runs
+ *   dedent_cascade  long line that ends thousands of nested blocks at once
+ *
+ * Each case is a single long line or ends with one, because per-line work
+ * is where superlinear behaviour hides.
+ *
+ * Exit code is 1 if any case fails and 2 on bad arguments, including unknown case name.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <amw.h>
+
+#include "common.h"
+#include "bench.h"
+
+#define DEFAULT_SIZE      (256 << 10)
+#define DEFAULT_MIN_TIME  0.2
+#define MIN_ITERATIONS    3
+#define MAX_GROWTH        1.5
+
+// nesting depth of dedent_cascade is size / DEDENT_BYTES_PER_LEVEL
+#define DEDENT_BYTES_PER_LEVEL  64
+
+typedef UwResult (*CaseFunc)(AmwOutput* output, size_t size);
+
+typedef struct {
+    char*    name;
+    CaseFunc generate;
+} Case;
+
+static UwResult put_repeated(AmwOutput* output, char* pattern, size_t size)
+/*
+ * Write as many copies of `pattern` as fit in `size` bytes.
+ * Patterns are never truncated, a truncated one might end with key-value separator.
+ */
+{
+    size_t length = strlen(pattern);
+    for (size_t n = size / length; n; n--) {{
+        UwValue status = _amw_output_write(output, pattern, length);
+        uw_return_if_error(&status);
+    }}
+    return UwOK();
+}
+
+static UwResult gen_colon_runs(AmwOutput* output, size_t size)
+/*
+ * Map value with runs of colons, each colon is checked for conversion specifier.
+ */
+{
+    UwValue status = _amw_output_write(output, "key: value", 10);
+    uw_return_if_error(&status);
+    status = put_repeated(output, ":::::::x", size);
+    uw_return_if_error(&status);
+    return _amw_output_putc(output, '\n');
+}
+
+static UwResult gen_spaced_colons(AmwOutput* output, size_t size)
+/*
+ * Map value with colons followed by space and something like conversion specifier
+ * that is not followed by space. Each of them makes is_kv_separator call parse_convspec.
+ */
+{
+    UwValue status = _amw_output_write(output, "key: value", 10);
+    uw_return_if_error(&status);
+    status = put_repeated(output, " : :literal:x", size);
+    uw_return_if_error(&status);
+    return _amw_output_putc(output, '\n');
+}
+
+static UwResult gen_backslash_runs(AmwOutput* output, size_t size)
+/*
+ * Quoted string of 63 backslashes followed by quotation mark, repeated.
+ * Odd number of backslashes makes the quotation mark escaped.
+ */
+{
+    char pattern[65];
+    memset(pattern, '\\', 63);
+    pattern[63] = '"';
+    pattern[64] = 0;
+
+    UwValue status = _amw_output_write(output, "key: \"", 6);
+    uw_return_if_error(&status);
+    status = put_repeated(output, pattern, size);
+    uw_return_if_error(&status);
+    return _amw_output_write(output, "\"\n", 2);
+}
+
+static UwResult gen_dedent_cascade(AmwOutput* output, size_t size)
+/*
+ * List nested on a single line, followed by long top-level list item.
+ * Each nested block reads the long line, finds it unindented, and unreads it.
+ */
+{
+    size_t depth = size / DEDENT_BYTES_PER_LEVEL;
+    UwValue status = put_repeated(output, "- ", depth * 2);
+    uw_return_if_error(&status);
+    status = _amw_output_write(output, "x\n- ", 4);
+    uw_return_if_error(&status);
+    status = put_repeated(output, "lorem ipsum dolor sit amet ", size - depth * 2);
+    uw_return_if_error(&status);
+    return _amw_output_putc(output, '\n');
+}
+
+static Case cases[] = {
+    { "colon_runs",     gen_colon_runs },
+    { "spaced_colons",  gen_spaced_colons },
+    { "backslash_runs", gen_backslash_runs },
+    { "dedent_cascade", gen_dedent_cascade }
+};
+
+#define NUM_CASES  (sizeof(cases) / sizeof(cases[0]))
+
+static UwResult measure(Case* c, size_t size, double min_time, size_t* bytes, uint64_t* best_ns)
+/*
+ * Generate markup of `size` bytes, parse it repeatedly, and write the best time to `best_ns`.
+ */
+{
+    AmwOutput markup;
+    UwValue status = amw_init_output(&markup, 0, nullptr, nullptr);
+    uw_return_if_error(&status);
+
+    status = c->generate(&markup, size);
+    if (uw_error(&status)) {
+        amw_fini_output(&markup);
+        return uw_move(&status);
+    }
+    *bytes = markup.length;
+    UwValue lines = amw_split_lines(markup.data, markup.length);
+    amw_fini_output(&markup);
+    uw_return_if_error(&lines);
+
+    uint64_t min_ns = (uint64_t) (min_time * 1e9);
+    uint64_t total_ns = 0;
+    *best_ns = UINT64_MAX;
+
+    for (unsigned i = 0; i < MIN_ITERATIONS || total_ns < min_ns; i++) {{
+        uint64_t start = bench_now_ns();
+        UwValue value = amw_parse(&lines);
+        uint64_t elapsed = bench_now_ns() - start;
+        uw_return_if_error(&value);
+
+        if (elapsed < *best_ns) {
+            *best_ns = elapsed;
+        }
+        total_ns += elapsed;
+    }}
+    if (*best_ns == 0) {
+        *best_ns = 1;
+    }
+    return UwOK();
+}
+
+static bool check_case(Case* c, size_t size, double min_time)
+{
+    size_t bytes[2];
+    uint64_t best_ns[2];
+    for (unsigned i = 0; i < 2; i++) {{
+        UwValue status = measure(c, size << i, min_time, &bytes[i], &best_ns[i]);
+        if (uw_error(&status)) {
+            print_error(c->name, &status);
+            return false;
+        }
+    }}
+    double ns_per_byte[2];
+    for (unsigned i = 0; i < 2; i++) {
+        ns_per_byte[i] = (double) best_ns[i] / bytes[i];
+    }
+    double growth = ns_per_byte[1] / ns_per_byte[0];
+    bool ok = growth <= MAX_GROWTH;
+    printf("%-16s %10zu %10zu %12.3f %12.3f %8.2f %s\n",
+           c->name, bytes[0], bytes[1], ns_per_byte[0], ns_per_byte[1], growth, ok? "ok" : "FAIL");
+    fflush(stdout);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t size = DEFAULT_SIZE;
+    double min_time = DEFAULT_MIN_TIME;
+    char* only = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            size = strtoull(argv[++i], nullptr, 0);
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--size BYTES] [--min-time SECONDS] [--only CASE]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (size < DEDENT_BYTES_PER_LEVEL * 2) {
+        fprintf(stderr, "%s: size is too small\n", argv[0]);
+        return 2;
+    }
+    if (only) {
+        unsigned i = 0;
+        while (i < NUM_CASES && strcmp(only, cases[i].name) != 0) {
+            i++;
+        }
+        if (i == NUM_CASES) {
+            fprintf(stderr, "%s: no such case: %s\n", argv[0], only);
+            return 2;
+        }
+    }
+
+    printf("%-16s %10s %10s %12s %12s %8s (limit %.2f)\n",
+           "case", "bytes", "bytes x2", "ns/byte", "ns/byte x2", "growth", MAX_GROWTH);
+
+    unsigned num_run = 0;
+    unsigned num_failed = 0;
+    for (unsigned i = 0; i < NUM_CASES; i++) {
+        if (only && strcmp(only, cases[i].name) != 0) {
+            continue;
+        }
+        num_run++;
+        if (!check_case(&cases[i], size, min_time)) {
+            num_failed++;
+        }
+    }
+    printf("\n%u cases, %u failed\n", num_run, num_failed);
+    return num_failed? 1 : 0;
+}
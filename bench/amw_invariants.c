@@ -0,0 +1,464 @@
+/*
+ * Check invariants that optimized code paths must keep.
+ *
+ * Usage: amw_invariants [--only CHECK]
+ *
+ * Each check parses crafted input or synthetic corpora (see corpus.c)
+ * and compares results of two code paths that must agree.
+ *
+ * Exit code is 1 if any check fails.
+ */
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <amw.h>
+
+#include "common.h"
+#include "corpus.h"
+
+#define CORPUS_SIZE  (64 << 10)
+
+typedef bool (*CheckFunc)();
+
+typedef struct {
+    char*     name;
+    CheckFunc run;
+} Check;
+
+static char* current_check;
+
+static bool fail(char* fmt, ...)
+/*
+ * Print failure of the current check and return false.
+ */
+{
+    va_list ap;
+    va_start(ap);
+    fprintf(stderr, "%s: ", current_check);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+    return false;
+}
+
+static bool fail_status(char* what, UwValuePtr status)
+/*
+ * Print error status of the current check and return false.
+ */
+{
+    char prefix[strlen(current_check) + strlen(what) + 3];
+    sprintf(prefix, "%s: %s", current_check, what);
+    print_error(prefix, status);
+    return false;
+}
+
+static bool check_hashed(char* what, UwValuePtr lines)
+/*
+ * Check that structural hash computed while parsing equals hash of parsed value.
+ */
+{
+    AmwHashes hashes = {};
+    UwValue value = amw_parse_hashed(lines, &hashes);
+    uw_destroy(&hashes.sections);
+    if (uw_error(&value)) {
+        return fail_status(what, &value);
+    }
+    uint64_t expected = amw_value_hash(&value);
+    if (hashes.structural != expected) {
+        return fail("%s: streaming hash %016llx, value hash %016llx", what,
+                    (unsigned long long) hashes.structural, (unsigned long long) expected);
+    }
+    return true;
+}
+
+static bool check_hash_duplicate_keys()
+{
+    static char markup[] =
+        "a: 1\n"
+        "a: 2\n"
+        "b:\n"
+        "  c: 1\n"
+        "  c:\n"
+        "    - 3\n"
+        "  d: 4\n";
+
+    UwValue lines = amw_split_lines(markup, strlen(markup));
+    if (uw_error(&lines)) {
+        return fail_status("split", &lines);
+    }
+    return check_hashed("duplicate keys", &lines);
+}
+
+static bool check_hash_corpora()
+{
+    bool ok = true;
+    for (unsigned i = 0; i < num_corpora; i++) {{
+        AmwOutput markup;
+        UwValue status = amw_init_output(&markup, 0, nullptr, nullptr);
+        if (uw_error(&status)) {
+            return fail_status(corpora[i].name, &status);
+        }
+        status = corpus_generate(&corpora[i], CORPUS_SIZE, &markup);
+        UwValue lines = UwNull();
+        if (uw_ok(&status)) {
+            lines = amw_split_lines(markup.data, markup.length);
+        }
+        amw_fini_output(&markup);
+        if (uw_error(&status)) {
+            ok = fail_status(corpora[i].name, &status);
+            continue;
+        }
+        if (uw_error(&lines)) {
+            ok = fail_status(corpora[i].name, &lines);
+            continue;
+        }
+        if (!check_hashed(corpora[i].name, &lines)) {
+            ok = false;
+        }
+    }}
+    return ok;
+}
+
+static bool check_reparse_edit(UwValuePtr doc, UwValuePtr source, unsigned line, char* text)
+/*
+ * Replace `line` of `source` with `text` and check that amw_reparse
+ * agrees with parsing the edited source from scratch.
+ */
+{
+    UwValue lines = uw_clone(source);
+    UwValue new_lines = amw_split_lines(text, strlen(text));
+    if (uw_error(&new_lines)) {
+        return fail_status("split", &new_lines);
+    }
+    AmwEdit edit = { .first_line = line, .num_lines = 1, .new_lines = &new_lines };
+    UwValue reparsed = amw_reparse(doc, &lines, &edit, 1);
+    UwValue parsed = amw_parse(&lines);
+
+    if (uw_error(&parsed) != uw_error(&reparsed)) {
+        return fail("edit \"%s\": amw_reparse %s, amw_parse %s", text,
+                    uw_error(&reparsed)? "failed" : "succeeded", uw_error(&parsed)? "failed" : "succeeded");
+    }
+    if (!uw_error(&parsed) && amw_value_hash(&parsed) != amw_value_hash(&reparsed)) {
+        return fail("edit \"%s\": amw_reparse and amw_parse results differ", text);
+    }
+    return true;
+}
+
+static bool check_reparse_convspec_block()
+{
+    static char markup[] =
+        "config:\n"
+        "  :json:\n"
+        "  {\n"
+        "    \"a\": 1,\n"
+        "    \"b\": 2\n"
+        "  }\n"
+        "other: 3\n";
+
+    UwValue source = amw_split_lines(markup, strlen(markup));
+    if (uw_error(&source)) {
+        return fail_status("split", &source);
+    }
+    UwValue doc = amw_parse(&source);
+    if (uw_error(&doc)) {
+        return fail_status("parse", &doc);
+    }
+    bool ok = check_reparse_edit(&doc, &source, 3, "    \"a\": 5,");
+    ok = check_reparse_edit(&doc, &source, 3, "    \"a\": 1,,") && ok;
+    return ok;
+}
+
+static bool check_compiled_zero_bytes()
+{
+    UwValue str = uw_create_string("zero");
+    if (uw_error(&str)) {
+        return fail_status("create", &str);
+    }
+    if (!uw_string_append(&str, (char32_t) 0) || !uw_string_append(&str, "byte")) {
+        return fail("out of memory");
+    }
+    UwValue doc = UwMap();
+    if (uw_error(&doc)) {
+        return fail_status("create", &doc);
+    }
+    UwValue status = uw_map_update(&doc, &str, &str);
+    if (uw_error(&status)) {
+        return fail_status("create", &status);
+    }
+
+    uint8_t* image;
+    size_t image_size;
+    status = _amw_compile_to_buffer(&doc, &image, &image_size);
+    if (uw_error(&status)) {
+        return fail_status("compile", &status);
+    }
+    bool ok = true;
+    AmwCompiled compiled;
+    status = amw_init_compiled(&compiled, image, image_size);
+    if (uw_error(&status)) {
+        ok = fail_status("load", &status);
+    } else {
+        UwValue loaded = amw_compiled_to_value(&compiled, amw_compiled_root(&compiled));
+        if (uw_error(&loaded)) {
+            ok = fail_status("load", &loaded);
+        } else if (amw_value_hash(&loaded) != amw_value_hash(&doc)) {
+            ok = fail("loaded value differs from compiled one");
+        }
+    }
+    release((void**) &image, image_size);
+    return ok;
+}
+
+static bool check_split_zero_bytes()
+{
+    static char data[] = "a\0b\nc";
+
+    UwValue lines = amw_split_lines(data, sizeof(data) - 1);
+    if (uw_error(&lines)) {
+        return fail_status("split", &lines);
+    }
+    if (uw_array_length(&lines) != 2) {
+        return fail("%u lines instead of 2", uw_array_length(&lines));
+    }
+    UwValue line = uw_array_item(&lines, 0);
+    if (uw_strlen(&line) != 3 || uw_char_at(&line, 1) != 0 || uw_char_at(&line, 2) != 'b') {
+        return fail("zero byte truncated the line");
+    }
+    return true;
+}
+
+static UwResult cst_edit(AmwCst* cst, UwValuePtr value, char* key, int index)
+/*
+ * Set value at path made of the key and, if `index` is not negative, list index.
+ */
+{
+    UwValue path = UwArray();
+    uw_return_if_error(&path);
+    UwValue item = uw_create_string(key);
+    uw_return_if_error(&item);
+    UwValue status = uw_array_append(&path, &item);
+    uw_return_if_error(&status);
+    if (index >= 0) {
+        uw_destroy(&item);
+        item = UwUnsigned(index);
+        status = uw_array_append(&path, &item);
+        uw_return_if_error(&status);
+    }
+    return amw_cst_set(cst, &path, value);
+}
+
+static bool check_cst_trailing_comments()
+{
+    static char markup[] =
+        "a: 1  # one\n"
+        "b: \"x\" # two\n"
+        "c:\n"
+        "  - true # three\n";
+
+    [[ gnu::cleanup(amw_cst_fini) ]] AmwCst cst;
+    UwValue status = amw_cst_init(&cst, markup, strlen(markup));
+    if (uw_error(&status)) {
+        return fail_status("init", &status);
+    }
+    UwValue map = UwMap();
+    if (uw_error(&map)) {
+        return fail_status("create", &map);
+    }
+    UwValue number = UwUnsigned(5);
+    char* keys[] = { "x", "y" };
+    for (unsigned i = 0; i < 2; i++) {{
+        UwValue key = uw_create_string(keys[i]);
+        if (uw_error(&key)) {
+            return fail_status("create", &key);
+        }
+        UwValue update_status = uw_map_update(&map, &key, &number);
+        if (uw_error(&update_status)) {
+            return fail_status("create", &update_status);
+        }
+    }}
+
+    // new value fits the line, block that starts on the next line, and multi-line list item
+    status = cst_edit(&cst, &number, "a", -1);
+    if (uw_ok(&status)) {
+        status = cst_edit(&cst, &map, "b", -1);
+    }
+    if (uw_ok(&status)) {
+        status = cst_edit(&cst, &map, "c", 0);
+    }
+    if (uw_error(&status)) {
+        return fail_status("edit", &status);
+    }
+
+    [[ gnu::cleanup(amw_fini_output) ]] AmwOutput output;
+    status = amw_init_output(&output, 0, nullptr, nullptr);
+    if (uw_error(&status)) {
+        return fail_status("write", &status);
+    }
+    status = amw_cst_write(&cst, &output);
+    if (uw_ok(&status)) {
+        status = _amw_output_putc(&output, 0);
+    }
+    if (uw_error(&status)) {
+        return fail_status("write", &status);
+    }
+    char* comments[] = { "# one", "# two", "# three" };
+    for (unsigned i = 0; i < 3; i++) {
+        if (!strstr(output.data, comments[i])) {
+            return fail("comment \"%s\" is lost", comments[i]);
+        }
+    }
+    UwValue lines = amw_split_lines(output.data, output.length - 1);
+    if (uw_error(&lines)) {
+        return fail_status("split", &lines);
+    }
+    UwValue value = amw_parse(&lines);
+    if (uw_error(&value)) {
+        return fail_status("parse edited", &value);
+    }
+    return true;
+}
+
+static bool check_cache_null_document()
+{
+    char path[] = "/tmp/amw_invariants_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        return fail("cannot create %s", path);
+    }
+    bool written = write(fd, "null\n", 5) == 5;
+    close(fd);
+    if (!written) {
+        unlink(path);
+        return fail("cannot write %s", path);
+    }
+    AmwCache* cache = amw_create_cache(4, false);
+    if (!cache) {
+        unlink(path);
+        return fail("out of memory");
+    }
+    bool ok = true;
+    for (unsigned i = 0; i < 2 && ok; i++) {{
+        UwValue doc = amw_cache_parse(cache, path);
+        if (uw_error(&doc)) {
+            ok = fail_status("parse", &doc);
+        } else if (!uw_is_null(&doc)) {
+            ok = fail("document is not null");
+        }
+    }}
+    uint64_t hits, misses;
+    amw_cache_stats(cache, &hits, &misses);
+    if (ok && (hits != 1 || misses != 1)) {
+        ok = fail("%llu hits and %llu misses instead of 1 and 1",
+                  (unsigned long long) hits, (unsigned long long) misses);
+    }
+    amw_delete_cache(&cache);
+    unlink(path);
+    return ok;
+}
+
+typedef struct {
+    int64_t  port;
+} SchemaServer;
+
+typedef struct {
+    _UwValue      name;
+    SchemaServer  server;
+} SchemaConfig;
+
+static AmwField server_fields[] = {
+    { .name = "port", .offset = offsetof(SchemaServer, port), .type = AMW_FIELD_INT, .required = true }
+};
+
+static AmwSchema server_schema = { .fields = server_fields, .num_fields = 1 };
+
+static AmwField config_fields[] = {
+    { .name = "name",   .offset = offsetof(SchemaConfig, name),   .type = AMW_FIELD_STRING },
+    { .name = "server", .offset = offsetof(SchemaConfig, server), .type = AMW_FIELD_STRUCT,
+      .schema = &server_schema }
+};
+
+static AmwSchema config_schema = { .fields = config_fields, .num_fields = 2 };
+
+static bool check_schema_missing_struct()
+{
+    static char markup[] = "name: test\n";
+
+    UwValue lines = amw_split_lines(markup, strlen(markup));
+    if (uw_error(&lines)) {
+        return fail_status("split", &lines);
+    }
+    SchemaConfig config;
+    UwValue status = amw_parse_into(&lines, &config_schema, &config);
+    if (uw_ok(&status)) {
+        amw_destroy_struct(&config_schema, &config);
+        return fail("missing required field of nested struct is not reported");
+    }
+    if (status.status_code != AMW_PARSE_ERROR) {
+        return fail_status("parse", &status);
+    }
+
+    // optional struct can be omitted
+    config_fields[1].optional = true;
+    uw_destroy(&status);
+    status = amw_parse_into(&lines, &config_schema, &config);
+    config_fields[1].optional = false;
+    if (uw_error(&status)) {
+        return fail_status("optional struct", &status);
+    }
+    amw_destroy_struct(&config_schema, &config);
+    return true;
+}
+
+static Check checks[] = {
+    { "hash_duplicate_keys", check_hash_duplicate_keys },
+    { "hash_corpora",        check_hash_corpora },
+    { "reparse_convspec",    check_reparse_convspec_block },
+    { "compiled_zero_bytes", check_compiled_zero_bytes },
+    { "split_zero_bytes",    check_split_zero_bytes },
+    { "cst_trailing_comments", check_cst_trailing_comments },
+    { "cache_null_document", check_cache_null_document },
+    { "schema_missing_struct", check_schema_missing_struct }
+};
+
+#define NUM_CHECKS  (sizeof(checks) / sizeof(checks[0]))
+
+int main(int argc, char* argv[])
+{
+    char* only = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else {
+            fprintf(stderr, "Usage: %s [--only CHECK]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    unsigned num_run = 0;
+    unsigned num_failed = 0;
+    for (unsigned i = 0; i < NUM_CHECKS; i++) {
+        if (only && strcmp(only, checks[i].name) != 0) {
+            continue;
+        }
+        current_check = checks[i].name;
+        bool ok = checks[i].run();
+        printf("%-24s %s\n", checks[i].name, ok? "ok" : "FAIL");
+        fflush(stdout);
+        num_run++;
+        if (!ok) {
+            num_failed++;
+        }
+    }
+    if (num_run == 0) {
+        fprintf(stderr, "%s: no such check: %s\n", argv[0], only);
+        return 2;
+    }
+    printf("\n%u checks, %u failed\n", num_run, num_failed);
+    return num_failed? 1 : 0;
+}
@@ -0,0 +1,365 @@
+/*
+ * Microbenchmarks of parser hot functions.
+ *
+ * Usage: amw_kernels [--repeat N] [--warmup N] [--only KERNEL]
+ *
+ * Each kernel calls a single internal function on a fixed input.
+ * Static functions are reached through kernels_parser.c and kernels_json.c.
+ *
+ * After warmup the kernel runs `--repeat` samples (31 by default),
+ * each sample is a batch of calls timed with cycle counter, see bench_cycles.
+ * Kernels that need to reset parser state before each call are timed
+ * one call per sample, the reset is not included.
+ *
+ * Results are written to stdout as JSON with minimal and median
+ * cycles and nanoseconds per call.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <amw.h>
+
+#include "bench.h"
+#include "kernels.h"
+
+#define DEFAULT_REPEAT  31
+#define DEFAULT_WARMUP  1000
+#define BATCH_SIZE      1000
+
+typedef struct {
+    AmwParser* parser;
+    _UwValue   line;    // input for kernels that take line argument
+    _UwValue   lines;   // input for fold_lines, or markup for kernels that read lines
+    unsigned   end_pos;
+} KernelCtx;
+
+typedef struct {
+    char*     name;
+    UwResult (*init)(KernelCtx* ctx);
+    UwResult (*prepare)(KernelCtx* ctx);  // called before each call, not timed
+    UwResult (*run)(KernelCtx* ctx);
+} Kernel;
+
+static char number_terminators[] = { AMW_COMMENT, ':', 0 };
+
+static char text_with_escapes[] =
+    "lorem ipsum \\\"dolor\\\" sit\\tamet \\u00e9 consectetur \\\\ adipiscing elit\\n"
+    "sed do eiusmod \\u263a tempor incididunt ut labore et \\\"dolore\\\" magna aliqua\\r\\n";
+
+static char plain_text[] =
+    "lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor "
+    "incididunt ut labore et dolore magna aliqua ut enim ad minim veniam quis nostrud";
+
+static UwResult set_current_line(KernelCtx* ctx, char* text)
+{
+    uw_destroy(&ctx->parser->current_line);
+    ctx->parser->current_line = uw_create_string(text);
+    uw_return_if_error(&ctx->parser->current_line);
+    ctx->parser->block_indent = 0;
+    return UwOK();
+}
+
+static UwResult make_lines(UwValuePtr lines, char* first_line, char* line, unsigned count, char* last_line)
+/*
+ * Create array of lines: optional first line, `count` copies of `line`, optional last line.
+ */
+{
+    *lines = UwArray();
+    uw_return_if_error(lines);
+    if (first_line) {
+        UwValue s = uw_create_string(first_line);
+        uw_return_if_error(&s);
+        UwValue status = uw_array_append(lines, &s);
+        uw_return_if_error(&status);
+    }
+    for (unsigned i = 0; i < count; i++) {{
+        UwValue s = uw_create_string(line);
+        uw_return_if_error(&s);
+        UwValue status = uw_array_append(lines, &s);
+        uw_return_if_error(&status);
+    }}
+    if (last_line) {
+        UwValue s = uw_create_string(last_line);
+        uw_return_if_error(&s);
+        UwValue status = uw_array_append(lines, &s);
+        uw_return_if_error(&status);
+    }
+    return UwOK();
+}
+
+static UwResult start_markup(KernelCtx* ctx)
+/*
+ * Reset parser for markup and read the first line.
+ */
+{
+    UwValue status = amw_parser_reset(ctx->parser, &ctx->lines);
+    uw_return_if_error(&status);
+    if (_amw_read_block_line(ctx->parser) != AMW_LINE_READ) {
+        return UwError(UW_ERROR_EOF);
+    }
+    return UwOK();
+}
+
+/*
+ * Kernels
+ */
+
+static UwResult init_unescape(KernelCtx* ctx)
+{
+    ctx->line = uw_create_string(text_with_escapes);
+    uw_return_if_error(&ctx->line);
+    ctx->end_pos = uw_strlen(&ctx->line);
+    return UwOK();
+}
+
+static UwResult init_unescape_plain(KernelCtx* ctx)
+{
+    ctx->line = uw_create_string(plain_text);
+    uw_return_if_error(&ctx->line);
+    ctx->end_pos = uw_strlen(&ctx->line);
+    return UwOK();
+}
+
+static UwResult run_unescape(KernelCtx* ctx)
+{
+    return _amw_unescape_line(ctx->parser, &ctx->line, 1, '"', 0, ctx->end_pos);
+}
+
+static UwResult init_number_int(KernelCtx* ctx)
+{
+    return set_current_line(ctx, "1234567890123");
+}
+
+static UwResult init_number_float(KernelCtx* ctx)
+{
+    return set_current_line(ctx, "12345.678901e-12");
+}
+
+static UwResult run_number(KernelCtx* ctx)
+{
+    unsigned end_pos;
+    return _amw_parse_number(ctx->parser, 0, 1, &end_pos, number_terminators);
+}
+
+static UwResult init_datetime(KernelCtx* ctx)
+{
+    return set_current_line(ctx, "2024-03-01T12:34:56.123456789+02:00");
+}
+
+static UwResult run_datetime(KernelCtx* ctx)
+{
+    return _bench_parse_datetime(ctx->parser);
+}
+
+static UwResult init_timestamp(KernelCtx* ctx)
+{
+    return set_current_line(ctx, "1709296496.123456789");
+}
+
+static UwResult run_timestamp(KernelCtx* ctx)
+{
+    return _bench_parse_timestamp(ctx->parser);
+}
+
+static UwResult init_fold_lines(KernelCtx* ctx)
+{
+    // lines are dedented in place, they have no common indent, so every call does the same work
+    return make_lines(&ctx->lines, nullptr, plain_text, 8, nullptr);
+}
+
+static UwResult run_fold_lines(KernelCtx* ctx)
+{
+    return _bench_fold_lines(ctx->parser, &ctx->lines);
+}
+
+static UwResult init_closing_quote(KernelCtx* ctx)
+{
+    // escaped quotes before the closing one
+    ctx->line = uw_create_string(
+        "\"lorem ipsum \\\"dolor\\\" sit amet consectetur adipiscing \\\"elit\\\" sed do eiusmod"
+        " tempor incididunt ut labore et dolore magna aliqua\" # comment"
+    );
+    uw_return_if_error(&ctx->line);
+    return UwOK();
+}
+
+static UwResult run_closing_quote(KernelCtx* ctx)
+{
+    unsigned end_pos;
+    if (!_amw_find_closing_quote(&ctx->line, '"', 1, &end_pos)) {
+        return UwError(UW_ERROR_EOF);
+    }
+    return UwOK();
+}
+
+static UwResult init_read_block(KernelCtx* ctx)
+{
+    return make_lines(&ctx->lines, nullptr, "    lorem ipsum dolor sit amet consectetur adipiscing elit", 1000, nullptr);
+}
+
+static UwResult run_read_block(KernelCtx* ctx)
+{
+    return _amw_read_block(ctx->parser);
+}
+
+static UwResult init_json_spaces(KernelCtx* ctx)
+{
+    return set_current_line(ctx, "                                                                1");
+}
+
+static UwResult run_json_spaces(KernelCtx* ctx)
+{
+    unsigned pos = 0;
+    return _bench_json_skip_spaces(ctx->parser, &pos);
+}
+
+static UwResult init_json_comments(KernelCtx* ctx)
+{
+    // the first line is not a comment, leading comments would be skipped by the line reader
+    return make_lines(&ctx->lines, "[", "        # comment line inside JSON array", 100, "1]");
+}
+
+static UwResult run_json_comments(KernelCtx* ctx)
+{
+    unsigned pos = 1;
+    return _bench_json_skip_spaces(ctx->parser, &pos);
+}
+
+static Kernel kernels[] = {
+    { "unescape_line",         init_unescape,       nullptr,      run_unescape },
+    { "unescape_line/plain",   init_unescape_plain, nullptr,      run_unescape },
+    { "parse_number/int",      init_number_int,     nullptr,      run_number },
+    { "parse_number/float",    init_number_float,   nullptr,      run_number },
+    { "parse_datetime",        init_datetime,       nullptr,      run_datetime },
+    { "parse_timestamp",       init_timestamp,      nullptr,      run_timestamp },
+    { "fold_lines",            init_fold_lines,     nullptr,      run_fold_lines },
+    { "find_closing_quote",    init_closing_quote,  nullptr,      run_closing_quote },
+    { "read_block",            init_read_block,     start_markup, run_read_block },
+    { "json_skip_spaces",      init_json_spaces,    nullptr,      run_json_spaces },
+    { "json_skip_spaces/comments", init_json_comments, start_markup, run_json_comments }
+};
+
+/*
+ * Harness
+ */
+
+static int compare_u64(const void* a, const void* b)
+{
+    uint64_t x = *(uint64_t*) a;
+    uint64_t y = *(uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+static UwResult call_once(Kernel* kernel, KernelCtx* ctx, uint64_t* cycles, uint64_t* ns)
+/*
+ * Run one sample. Kernels with `prepare` are called once per sample, others BATCH_SIZE times.
+ */
+{
+    unsigned n = BATCH_SIZE;
+    if (kernel->prepare) {
+        UwValue status = kernel->prepare(ctx);
+        uw_return_if_error(&status);
+        n = 1;
+    }
+    uint64_t start_ns = bench_now_ns();
+    uint64_t start = bench_cycles();
+    for (unsigned i = 0; i < n; i++) {{
+        UwValue result = kernel->run(ctx);
+        if (uw_error(&result)) {
+            return uw_move(&result);
+        }
+    }}
+    *cycles = (bench_cycles() - start) / n;
+    *ns = (bench_now_ns() - start_ns) / n;
+    return UwOK();
+}
+
+static UwResult run_kernel(Kernel* kernel, unsigned repeat, unsigned warmup, bool first)
+{
+    KernelCtx ctx = {
+        .line  = UwNull(),
+        .lines = UwNull()
+    };
+    UwValue empty = UwArray();
+    uw_return_if_error(&empty);
+    ctx.parser = amw_create_parser(&empty);
+    if (!ctx.parser) {
+        return UwOOM();
+    }
+    uint64_t cycles[repeat];
+    uint64_t ns[repeat];
+
+    UwValue status = kernel->init(&ctx);
+    if (uw_ok(&status)) {
+        // each warmup sample is a batch, so warmup is measured in calls for batched kernels
+        unsigned warmup_samples = kernel->prepare? warmup : (warmup + BATCH_SIZE - 1) / BATCH_SIZE;
+        for (unsigned i = 0; i < warmup_samples && uw_ok(&status); i++) {
+            uw_destroy(&status);
+            status = call_once(kernel, &ctx, &cycles[0], &ns[0]);
+        }
+        for (unsigned i = 0; i < repeat && uw_ok(&status); i++) {
+            uw_destroy(&status);
+            status = call_once(kernel, &ctx, &cycles[i], &ns[i]);
+        }
+    }
+    uw_destroy(&ctx.line);
+    uw_destroy(&ctx.lines);
+    amw_delete_parser(&ctx.parser);
+    uw_return_if_error(&status);
+
+    qsort(cycles, repeat, sizeof(uint64_t), compare_u64);
+    qsort(ns, repeat, sizeof(uint64_t), compare_u64);
+
+    printf("%s\n    {\"name\": \"%s\", \"calls_per_sample\": %u, \"samples\": %u,"
+           " \"min_cycles\": %llu, \"median_cycles\": %llu, \"min_ns\": %llu, \"median_ns\": %llu}",
+           first? "" : ",", kernel->name, kernel->prepare? 1 : BATCH_SIZE, repeat,
+           (unsigned long long) cycles[0], (unsigned long long) cycles[repeat / 2],
+           (unsigned long long) ns[0], (unsigned long long) ns[repeat / 2]);
+    fflush(stdout);
+    return UwOK();
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned repeat = DEFAULT_REPEAT;
+    unsigned warmup = DEFAULT_WARMUP;
+    char* only = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            warmup = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--only") == 0 && i + 1 < argc) {
+            only = argv[++i];
+        } else {
+            repeat = 0;
+            break;
+        }
+    }
+    if (repeat == 0 || repeat > 10000) {
+        fprintf(stderr, "Usage: %s [--repeat N] [--warmup N] [--only KERNEL]\n", argv[0]);
+        return 2;
+    }
+    printf("{\"cycle_counter\": \"%s\", \"results\": [", BENCH_CYCLE_COUNTER);
+
+    bool first = true;
+    int exit_code = 0;
+    for (unsigned i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {{
+        Kernel* kernel = &kernels[i];
+        if (only && strcmp(only, kernel->name) != 0) {
+            continue;
+        }
+        UwValue status = run_kernel(kernel, repeat, warmup, first);
+        if (uw_error(&status)) {
+            fprintf(stderr, "%s: kernel failed\n", kernel->name);
+            exit_code = 1;
+            continue;
+        }
+        first = false;
+    }}
+    printf("\n]}\n");
+    return exit_code;
+}
@@ -0,0 +1,208 @@
+/*
+ * Generate synthetic AMW or JSON document of controllable shape.
+ *
+ * Usage: amwgen [options] [output]
+ *
+ *     --size BYTES           approximate size of AMW markup
+ *     --seed N               random seed, output is the same for the same seed and options
+ *     --depth N              maximal nesting depth, 1 for flat map
+ *     --fanout N             maximal number of items in nested maps and lists
+ *     --key-length MIN:MAX   range of key lengths
+ *     --strings L:Q:F:R      weights of literal, quoted, folded, and raw strings
+ *     --escapes PERCENT      words in quoted strings preceded by escape
+ *     --numbers PERCENT      scalars that are numbers
+ *     --datetimes PERCENT    scalars that are dates or timestamps
+ *     --comments PERCENT     probability of comment where it is allowed
+ *     --json                 parse generated markup and write it as JSON
+ *
+ * Output defaults to stdout. See CORPUS_DEFAULT_SHAPE for defaults.
+ *
+ * Varying one option at a time helps to isolate parser regressions, e.g.
+ * --strings 0:0:1:0 stresses fold_lines and --escapes 100 with --strings 0:1:0:0
+ * stresses _amw_unescape_line.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <amw.h>
+
+#include "common.h"
+#include "corpus.h"
+
+static bool parse_unsigned(char* arg, unsigned max_value, unsigned* result)
+{
+    char* end;
+    unsigned long n = strtoul(arg, &end, 10);
+    if (end == arg || *end || n > max_value) {
+        return false;
+    }
+    *result = n;
+    return true;
+}
+
+static bool parse_list(char* arg, unsigned* values, unsigned num_values)
+/*
+ * Parse colon-separated list of exactly `num_values` numbers.
+ */
+{
+    for (unsigned i = 0; i < num_values; i++) {
+        char* end;
+        unsigned long n = strtoul(arg, &end, 10);
+        if (end == arg || n > UINT_MAX) {
+            return false;
+        }
+        values[i] = n;
+        if (i + 1 < num_values) {
+            if (*end != ':') {
+                return false;
+            }
+            arg = end + 1;
+        } else if (*end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static UwResult generate(CorpusShape* shape, bool json, int fd)
+{
+    AmwOutput markup;
+    UwValue status = amw_init_output(&markup, 0, nullptr, nullptr);
+    uw_return_if_error(&status);
+
+    status = corpus_generate_shaped(shape, &markup);
+    if (uw_error(&status)) {
+        amw_fini_output(&markup);
+        return uw_move(&status);
+    }
+    if (!json) {
+        status = amw_write_fd(&fd, markup.data, markup.length);
+        amw_fini_output(&markup);
+        return uw_move(&status);
+    }
+    UwValue lines = amw_split_lines(markup.data, markup.length);
+    amw_fini_output(&markup);
+    uw_return_if_error(&lines);
+
+    UwValue value = amw_parse(&lines);
+    uw_return_if_error(&value);
+
+    AmwOutput output;
+    status = amw_init_output(&output, 0, amw_write_fd, &fd);
+    uw_return_if_error(&status);
+    status = amw_dump_json(&value, &output);
+    if (uw_ok(&status)) {
+        status = _amw_output_putc(&output, '\n');
+        if (uw_ok(&status)) {
+            status = amw_flush_output(&output);
+        }
+    }
+    amw_fini_output(&output);
+    return uw_move(&status);
+}
+
+int main(int argc, char* argv[])
+{
+    CorpusShape shape = CORPUS_DEFAULT_SHAPE;
+    bool json = false;
+    char* output_path = nullptr;
+    bool ok = true;
+
+    for (int i = 1; i < argc && ok; i++) {
+        char* arg = argv[i];
+        char* value = i + 1 < argc? argv[i + 1] : nullptr;
+        unsigned key_length[2];
+
+        if (strcmp(arg, "--json") == 0) {
+            json = true;
+            continue;
+        }
+        if (arg[0] != '-') {
+            ok = !output_path;
+            output_path = arg;
+            continue;
+        }
+        if (!value) {
+            ok = false;
+            break;
+        }
+        i++;
+        if (strcmp(arg, "--size") == 0) {
+            char* end;
+            shape.size = strtoull(value, &end, 0);
+            ok = end != value && !*end && shape.size;
+
+        } else if (strcmp(arg, "--seed") == 0) {
+            char* end;
+            shape.seed = strtoull(value, &end, 0);
+            ok = end != value && !*end;
+
+        } else if (strcmp(arg, "--depth") == 0) {
+            ok = parse_unsigned(value, CORPUS_MAX_DEPTH, &shape.depth) && shape.depth;
+
+        } else if (strcmp(arg, "--fanout") == 0) {
+            ok = parse_unsigned(value, UINT_MAX, &shape.fanout) && shape.fanout;
+
+        } else if (strcmp(arg, "--key-length") == 0) {
+            ok = parse_list(value, key_length, 2) && key_length[0] && key_length[0] <= key_length[1];
+            shape.key_min_length = key_length[0];
+            shape.key_max_length = key_length[1];
+
+        } else if (strcmp(arg, "--strings") == 0) {
+            ok = parse_list(value, shape.string_mix, CORPUS_NUM_STRING_KINDS);
+
+        } else if (strcmp(arg, "--escapes") == 0) {
+            ok = parse_unsigned(value, 100, &shape.escape_percent);
+
+        } else if (strcmp(arg, "--numbers") == 0) {
+            ok = parse_unsigned(value, 100, &shape.number_percent);
+
+        } else if (strcmp(arg, "--datetimes") == 0) {
+            ok = parse_unsigned(value, 100, &shape.datetime_percent);
+
+        } else if (strcmp(arg, "--comments") == 0) {
+            ok = parse_unsigned(value, 100, &shape.comment_percent);
+
+        } else {
+            ok = false;
+        }
+    }
+    if (ok && shape.number_percent + shape.datetime_percent > 100) {
+        fprintf(stderr, "%s: numbers and datetimes exceed 100 percent\n", argv[0]);
+        return 2;
+    }
+    if (!ok) {
+        fprintf(stderr, "Usage: %s [--size BYTES] [--seed N] [--depth N] [--fanout N]"
+                        " [--key-length MIN:MAX] [--strings L:Q:F:R] [--escapes PERCENT]"
+                        " [--numbers PERCENT] [--datetimes PERCENT] [--comments PERCENT]"
+                        " [--json] [output]\n", argv[0]);
+        return 2;
+    }
+
+    int fd = 1;
+    if (output_path) {
+        fd = open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (fd < 0) {
+            perror(output_path);
+            return 1;
+        }
+    }
+    UwValue status = generate(&shape, json, fd);
+    if (uw_error(&status)) {
+        print_error(output_path? output_path : "<stdout>", &status);
+        if (output_path) {
+            close(fd);
+            unlink(output_path);
+        }
+        return 1;
+    }
+    if (output_path && close(fd) != 0) {
+        perror(output_path);
+        return 1;
+    }
+    return 0;
+}
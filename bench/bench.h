@@ -0,0 +1,76 @@
+#pragma once
+
+/*
+ * Common definitions for benchmarks.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Counters of allocations and copying, see counters.c
+ *
+ * Benchmarks are linked with --wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free
+ * and --wrap=memcpy,--wrap=memmove so all allocations made by amw and uw libraries
+ * and their calls to memcpy and memmove are counted.
+ * Copies inlined by the compiler are not counted.
+ */
+
+typedef struct {
+    uint64_t  count;  // number of malloc, calloc, and realloc calls
+    uint64_t  bytes;  // total number of bytes requested
+} AllocStats;
+
+extern AllocStats alloc_stats;
+extern uint64_t copied_bytes;
+
+static inline uint64_t bench_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#ifdef __has_builtin
+#   if __has_builtin(__builtin_readcyclecounter)
+#       define BENCH_HAVE_CYCLE_COUNTER
+#   endif
+#endif
+
+#ifdef BENCH_HAVE_CYCLE_COUNTER
+#   define BENCH_CYCLE_COUNTER  "readcyclecounter"
+#else
+#   define BENCH_CYCLE_COUNTER  "ns"
+#endif
+
+static inline uint64_t bench_cycles()
+/*
+ * Read cycle counter. On x86 this is TSC that ticks at constant rate
+ * regardless of frequency scaling. Fall back to nanoseconds if not available.
+ */
+{
+#ifdef BENCH_HAVE_CYCLE_COUNTER
+    return __builtin_readcyclecounter();
+#else
+    return bench_now_ns();
+#endif
+}
+
+long bench_peak_rss_kb();
+/*
+ * Return peak resident set size of the process in kilobytes.
+ */
+
+int bench_open_instruction_counter();
+/*
+ * Open counter of user-space instructions retired by the calling thread.
+ * Return file descriptor or -1 if hardware counters are not available,
+ * e.g. in virtual machines or when perf_event_paranoid forbids them.
+ */
+
+bool bench_read_counter(int fd, uint64_t* value);
+/*
+ * Read counter opened by bench_open_instruction_counter.
+ */
@@ -0,0 +1,357 @@
+/*
+ * Compare amw_bench results against baseline.
+ *
+ * Usage: amw_bench_compare [--no-time] [--update] baseline.json results.json
+ *
+ * Baseline is a JSON object:
+ *
+ *     {
+ *         "size": 4194304,
+ *         "tolerance": {"instructions": 2, "allocations": 0, ...},
+ *         "benchmarks": {
+ *             "wide_map/amw": {"instructions": ..., "allocations": ..., "tolerance": {...}},
+ *             ...
+ *         }
+ *     }
+ *
+ * Tolerances are in percent. Per-benchmark tolerances override default ones.
+ * Metrics without tolerance are not checked.
+ *
+ * Instructions, allocations, and copied bytes do not depend on CPU frequency and load,
+ * so they can be checked with tight tolerances on shared machines.
+ * Throughput (mb_per_s) is noisy, it has wide tolerance and can be skipped with --no-time.
+ *
+ * Exit code is 1 if any metric is worse than baseline beyond tolerance,
+ * if a result has no baseline entry, or if a baseline entry has no result.
+ * Add or remove benchmarks together with their baseline entries, see --update.
+ *
+ * With --update, baseline file is rewritten with current results,
+ * tolerances are preserved.
+ *
+ * bench/baseline.json has no entries until it is generated on the reference
+ * machine, comparing against it fails on every result.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <amw.h>
+
+#include "common.h"
+
+typedef struct {
+    char*  name;
+    bool   higher_is_better;
+    bool   is_time;
+} Metric;
+
+static Metric metrics[] = {
+    { "instructions",    false, false },
+    { "allocations",     false, false },
+    { "allocated_bytes", false, false },
+    { "copied_bytes",    false, false },
+    { "mb_per_s",        true,  true }
+};
+
+#define NUM_METRICS  (sizeof(metrics) / sizeof(metrics[0]))
+
+static UwResult read_json(char* path)
+{
+    UwValue lines = amw_read_file_lines(path);
+    uw_return_if_error(&lines);
+    return amw_parse_json(&lines);
+}
+
+static UwResult get(UwValuePtr map, char* name)
+/*
+ * Return map value or null if `map` is not a map or has no such key.
+ */
+{
+    if (!uw_is_map(map)) {
+        return UwNull();
+    }
+    UwValue key = uw_create_string(name);
+    uw_return_if_error(&key);
+    UwValue value = uw_map_get(map, &key);
+    if (uw_error(&value)) {
+        return UwNull();
+    }
+    return uw_move(&value);
+}
+
+static bool to_number(UwValuePtr value, double* result)
+{
+    if (uw_is_signed(value)) {
+        *result = value->signed_value;
+    } else if (uw_is_unsigned(value)) {
+        *result = value->unsigned_value;
+    } else if (uw_is_float(value)) {
+        *result = value->float_value;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool get_number(UwValuePtr map, char* name, double* result)
+{
+    UwValue value = get(map, name);
+    return to_number(&value, result);
+}
+
+static bool get_tolerance(UwValuePtr baseline, UwValuePtr benchmark, char* metric, double* result)
+{
+    UwValue tolerance = get(benchmark, "tolerance");
+    if (get_number(&tolerance, metric, result)) {
+        return true;
+    }
+    UwValue default_tolerance = get(baseline, "tolerance");
+    return get_number(&default_tolerance, metric, result);
+}
+
+static UwResult result_name(UwValuePtr result, char* buf, size_t size)
+/*
+ * Write "name/format" of benchmark result to `buf`.
+ */
+{
+    UwValue name = get(result, "name");
+    UwValue format = get(result, "format");
+    if (!uw_is_string(&name) || !uw_is_string(&format)
+            || uw_strlen_in_utf8(&name) + uw_strlen_in_utf8(&format) + 2 > size) {
+        return UwError(UW_ERROR_INCOMPATIBLE_TYPE);
+    }
+    uw_substr_to_utf8_buf(&name, 0, uw_strlen(&name), buf);
+    size_t n = strlen(buf);
+    buf[n++] = '/';
+    uw_substr_to_utf8_buf(&format, 0, uw_strlen(&format), buf + n);
+    return UwOK();
+}
+
+static bool compare(UwValuePtr baseline, UwValuePtr results, bool check_time)
+/*
+ * Print comparison table and return true if no regressions found.
+ */
+{
+    bool ok = true;
+    unsigned num_checked = 0;
+    unsigned num_failed = 0;
+
+    double base_size, size;
+    if (get_number(baseline, "size", &base_size) && get_number(results, "size", &size) && base_size != size) {
+        printf("corpus size %.0f differs from baseline %.0f, results are not comparable\n", size, base_size);
+        return false;
+    }
+    UwValue benchmarks = get(baseline, "benchmarks");
+    UwValue result_list = get(results, "results");
+    if (!uw_is_array(&result_list)) {
+        printf("no results\n");
+        return false;
+    }
+    UwValue seen = UwMap();  // names of results, to find baseline entries without results
+    if (uw_error(&seen)) {
+        printf("out of memory\n");
+        return false;
+    }
+    printf("%-28s %-16s %16s %16s %9s %7s\n", "benchmark", "metric", "baseline", "current", "change", "limit");
+
+    unsigned n = uw_array_length(&result_list);
+    for (unsigned i = 0; i < n; i++) {{
+        UwValue result = uw_array_item(&result_list, i);
+        char name[256];
+        UwValue status = result_name(&result, name, sizeof(name));
+        if (uw_error(&status)) {
+            printf("result %u: bad name\n", i);
+            ok = false;
+            continue;
+        }
+        UwValue seen_name = uw_create_string(name);
+        UwValue seen_status = uw_map_update(&seen, &seen_name, &seen_name);
+        if (uw_error(&seen_status)) {
+            printf("out of memory\n");
+            return false;
+        }
+        UwValue benchmark = get(&benchmarks, name);
+        if (!uw_is_map(&benchmark)) {
+            printf("%-28s FAIL: not in baseline, run bench_update_baseline\n", name);
+            num_failed++;
+            ok = false;
+            continue;
+        }
+        for (unsigned j = 0; j < NUM_METRICS; j++) {
+            Metric* metric = &metrics[j];
+            if (metric->is_time && !check_time) {
+                continue;
+            }
+            double base_value, value, tolerance;
+            if (!get_tolerance(baseline, &benchmark, metric->name, &tolerance)) {
+                continue;
+            }
+            if (!get_number(&benchmark, metric->name, &base_value) || !get_number(&result, metric->name, &value)) {
+                // e.g. instructions are not available on this machine
+                continue;
+            }
+            double change = 0;
+            if (base_value != 0) {
+                change = (value - base_value) / base_value * 100;
+            } else if (value != 0) {
+                change = metric->higher_is_better? 100 : 1e9;
+            }
+            double worse = metric->higher_is_better? -change : change;
+            char* verdict = "ok";
+            if (worse > tolerance) {
+                verdict = "FAIL";
+                num_failed++;
+                ok = false;
+            } else if (-worse > tolerance) {
+                verdict = "better";
+            }
+            num_checked++;
+            printf("%-28s %-16s %16.2f %16.2f %+8.2f%% %6.1f%% %s\n",
+                   name, metric->name, base_value, value, change, tolerance, verdict);
+        }
+    }}
+
+    unsigned num_benchmarks = uw_is_map(&benchmarks)? uw_map_length(&benchmarks) : 0;
+    for (unsigned i = 0; i < num_benchmarks; i++) {{
+        UwValue key = UwNull();
+        UwValue value = UwNull();
+        uw_map_item(&benchmarks, i, &key, &value);
+        UwValue found = uw_map_get(&seen, &key);
+        if (uw_error(&found) && uw_is_string(&key)) {
+            char name[uw_strlen_in_utf8(&key) + 1];
+            uw_substr_to_utf8_buf(&key, 0, uw_strlen(&key), name);
+            printf("%-28s FAIL: no result, benchmark removed or failed\n", name);
+            num_failed++;
+            ok = false;
+        }
+    }}
+    if (num_checked == 0) {
+        printf("nothing checked\n");
+        ok = false;
+    }
+    printf("\n%u checks, %u failed\n", num_checked, num_failed);
+    return ok;
+}
+
+static void print_tolerance(FILE* out, UwValuePtr tolerance)
+{
+    fputc('{', out);
+    bool first = true;
+    unsigned n = uw_map_length(tolerance);
+    for (unsigned i = 0; i < n; i++) {{
+        UwValue key = UwNull();
+        UwValue value = UwNull();
+        uw_map_item(tolerance, i, &key, &value);
+        char name[64];
+        double number;
+        if (!uw_is_string(&key) || uw_strlen_in_utf8(&key) >= sizeof(name) || !to_number(&value, &number)) {
+            continue;
+        }
+        uw_substr_to_utf8_buf(&key, 0, uw_strlen(&key), name);
+        fprintf(out, "%s\"%s\": %g", first? "" : ", ", name, number);
+        first = false;
+    }}
+    fputc('}', out);
+}
+
+static bool update(char* path, UwValuePtr baseline, UwValuePtr results)
+/*
+ * Write results to baseline file preserving tolerances.
+ * One benchmark per line, so changes of baseline are easy to review.
+ */
+{
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        return false;
+    }
+    double size = 0;
+    get_number(results, "size", &size);
+    UwValue default_tolerance = get(baseline, "tolerance");
+    UwValue benchmarks = get(baseline, "benchmarks");
+    UwValue result_list = get(results, "results");
+
+    fprintf(out, "{\n    \"size\": %.0f,\n    \"tolerance\": ", size);
+    if (uw_is_map(&default_tolerance)) {
+        print_tolerance(out, &default_tolerance);
+    } else {
+        fputs("{}", out);
+    }
+    fprintf(out, ",\n    \"benchmarks\": {");
+
+    unsigned n = uw_is_array(&result_list)? uw_array_length(&result_list) : 0;
+    bool first = true;
+    for (unsigned i = 0; i < n; i++) {{
+        UwValue result = uw_array_item(&result_list, i);
+        char name[256];
+        UwValue status = result_name(&result, name, sizeof(name));
+        if (uw_error(&status)) {
+            continue;
+        }
+        fprintf(out, "%s\n        \"%s\": {", first? "" : ",", name);
+        first = false;
+
+        bool first_metric = true;
+        for (unsigned j = 0; j < NUM_METRICS; j++) {
+            double value;
+            if (get_number(&result, metrics[j].name, &value)) {
+                fprintf(out, metrics[j].is_time? "%s\"%s\": %.2f" : "%s\"%s\": %.0f",
+                        first_metric? "" : ", ", metrics[j].name, value);
+                first_metric = false;
+            }
+        }
+        UwValue old = get(&benchmarks, name);
+        UwValue tolerance = get(&old, "tolerance");
+        if (uw_is_map(&tolerance)) {
+            fprintf(out, "%s\"tolerance\": ", first_metric? "" : ", ");
+            print_tolerance(out, &tolerance);
+        }
+        fputc('}', out);
+    }}
+    fprintf(out, "\n    }\n}\n");
+
+    if (fclose(out) != 0) {
+        perror(path);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    bool check_time = true;
+    bool do_update = false;
+    char* paths[2];
+    unsigned num_paths = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-time") == 0) {
+            check_time = false;
+        } else if (strcmp(argv[i], "--update") == 0) {
+            do_update = true;
+        } else if (argv[i][0] != '-' && num_paths < 2) {
+            paths[num_paths++] = argv[i];
+        } else {
+            num_paths = 0;
+            break;
+        }
+    }
+    if (num_paths != 2) {
+        fprintf(stderr, "Usage: %s [--no-time] [--update] baseline.json results.json\n", argv[0]);
+        return 2;
+    }
+    UwValue baseline = read_json(paths[0]);
+    if (uw_error(&baseline)) {
+        print_error(paths[0], &baseline);
+        return 2;
+    }
+    UwValue results = read_json(paths[1]);
+    if (uw_error(&results)) {
+        print_error(paths[1], &results);
+        return 2;
+    }
+    if (do_update) {
+        return update(paths[0], &baseline, &results)? 0 : 1;
+    }
+    return compare(&baseline, &results, check_time)? 0 : 1;
+}
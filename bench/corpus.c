@@ -0,0 +1,680 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "corpus.h"
+
+static char* words[] = {
+    "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+    "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore",
+    "magna", "aliqua", "enim", "ad", "minim", "veniam", "quis", "nostrud",
+    "exercitation", "ullamco", "laboris", "nisi", "aliquip", "ex", "ea", "commodo"
+};
+#define NUM_WORDS  (sizeof(words) / sizeof(words[0]))
+
+// escapes for quoted strings, all of them are valid JSON escapes
+static char* escapes[] = {
+    "\\n", "\\t", "\\\"", "\\\\", "\\/", "\\u00e9", "\\u263a", "\\r"
+};
+#define NUM_ESCAPES  (sizeof(escapes) / sizeof(escapes[0]))
+
+static char* log_levels[] = { "debug", "info", "warning", "error" };
+
+static UwResult put(AmwOutput* output, char* fmt, ...)
+{
+    char buf[256];
+    va_list ap;
+    va_start(ap);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n >= (int) sizeof(buf)) {
+        n = sizeof(buf) - 1;
+    }
+    return _amw_output_write(output, buf, n);
+}
+
+static UwResult put_indent(AmwOutput* output, unsigned indent)
+{
+    UwValue status = _amw_output_reserve(output, indent);
+    uw_return_if_error(&status);
+    memset(output->data + output->length, ' ', indent);
+    output->length += indent;
+    return UwOK();
+}
+
+static UwResult put_words(AmwOutput* output, CorpusRng* rng, unsigned n)
+/*
+ * Write `n` random words separated by spaces.
+ */
+{
+    for (unsigned i = 0; i < n; i++) {{
+        char* word = words[corpus_rng_range(rng, NUM_WORDS)];
+        UwValue status = put(output, i? " %s" : "%s", word);
+        uw_return_if_error(&status);
+    }}
+    return UwOK();
+}
+
+static UwResult put_escaped_words(AmwOutput* output, CorpusRng* rng, unsigned n, unsigned escape_percent)
+/*
+ * Write `n` random words for quoted string, `escape_percent` of them preceded by escape.
+ * Escapes never end the string, so closing quote is never preceded by backslash.
+ */
+{
+    for (unsigned i = 0; i < n; i++) {{
+        if (i) {
+            UwValue status = _amw_output_putc(output, ' ');
+            uw_return_if_error(&status);
+        }
+        if (corpus_rng_range(rng, 100) < escape_percent) {
+            UwValue status = put(output, "%s", escapes[corpus_rng_range(rng, NUM_ESCAPES)]);
+            uw_return_if_error(&status);
+        }
+        UwValue status = put_words(output, rng, 1);
+        uw_return_if_error(&status);
+    }}
+    return UwOK();
+}
+
+static UwResult gen_wide_map(AmwOutput* output, size_t size, CorpusRng* rng)
+/*
+ * Flat map with many short entries of mixed types.
+ */
+{
+    for (unsigned i = 0; output->length < size; i++) {{
+        UwValue status = put(output, "k%u_%s: ", i, words[corpus_rng_range(rng, NUM_WORDS)]);
+        uw_return_if_error(&status);
+        switch (corpus_rng_range(rng, 4)) {
+            case 0:
+                status = put(output, "%u\n", corpus_rng_range(rng, 1000000));
+                break;
+            case 1:
+                status = put(output, "%s\n", corpus_rng_range(rng, 2)? "true" : "false");
+                break;
+            default:
+                status = put_words(output, rng, 2 + corpus_rng_range(rng, 6));
+                uw_return_if_error(&status);
+                status = _amw_output_putc(output, '\n');
+                break;
+        }
+        uw_return_if_error(&status);
+    }}
+    return UwOK();
+}
+
+#define TREE_DEPTH  48
+
+static UwResult gen_deep_nesting(AmwOutput* output, size_t size, CorpusRng* rng)
+/*
+ * Maps and lists nested TREE_DEPTH levels deep, with a sibling after each nested block,
+ * so every tree ends with a cascade of dedents.
+ * The depth is below the recursion limit of JSON parser, so the corpus can be converted to JSON.
+ */
+{
+    struct {
+        unsigned indent;
+        bool     is_list;
+    } levels[TREE_DEPTH];
+
+    for (unsigned tree = 0; output->length < size; tree++) {{
+        UwValue status = put(output, "tree_%u:\n", tree);
+        uw_return_if_error(&status);
+
+        unsigned indent = 2;
+        for (unsigned d = 0; d < TREE_DEPTH; d++) {
+            bool is_list = d % 4 == 3;
+            levels[d].indent = indent;
+            levels[d].is_list = is_list;
+
+            status = put_indent(output, indent);
+            uw_return_if_error(&status);
+            status = put(output, is_list? "- id: %u\n" : "id: %u\n", d);
+            uw_return_if_error(&status);
+
+            unsigned child_indent = is_list? indent + 2 : indent;
+            status = put_indent(output, child_indent);
+            uw_return_if_error(&status);
+            status = put(output, "child:\n");
+            uw_return_if_error(&status);
+
+            indent = child_indent + 2;
+        }
+        status = put_indent(output, indent);
+        uw_return_if_error(&status);
+        status = put(output, "leaf: ");
+        uw_return_if_error(&status);
+        status = put_words(output, rng, 3);
+        uw_return_if_error(&status);
+
+        for (unsigned d = TREE_DEPTH; d--;) {
+            status = _amw_output_putc(output, '\n');
+            uw_return_if_error(&status);
+            status = put_indent(output, levels[d].indent);
+            uw_return_if_error(&status);
+            status = put(output, levels[d].is_list? "- tail " : "tail: ");
+            uw_return_if_error(&status);
+            status = put_words(output, rng, 2);
+            uw_return_if_error(&status);
+        }
+        status = _amw_output_putc(output, '\n');
+        uw_return_if_error(&status);
+    }}
+    return UwOK();
+}
+
+static UwResult gen_literal_strings(AmwOutput* output, size_t size, CorpusRng* rng)
+/*
+ * Multi-line literal strings, with and without conversion specifier.
+ */
+{
+    for (unsigned i = 0; output->length < size; i++) {{
+        bool convspec = i & 1;
+        UwValue status = put(output, convspec? "text_%u:\n    :literal:\n" : "plain_%u:\n", i);
+        uw_return_if_error(&status);
+
+        unsigned num_lines = 3 + corpus_rng_range(rng, 8);
+        for (unsigned j = 0; j < num_lines; j++) {
+            // the first line defines block indent, the following ones may be indented more
+            unsigned extra_indent = j? corpus_rng_range(rng, 4) : 0;
+            status = put_indent(output, (convspec? 8 : 4) + extra_indent);
+            uw_return_if_error(&status);
+            status = put_words(output, rng, 5 + corpus_rng_range(rng, 8));
+            uw_return_if_error(&status);
+            status = _amw_output_putc(output, '\n');
+            uw_return_if_error(&status);
+        }
+    }}
+    return UwOK();
+}
+
+static UwResult gen_folded_strings(AmwOutput* output, size_t size, CorpusRng* rng)
+/*
+ * Multi-line folded strings with occasional empty lines in the middle.
+ */
+{
+    for (unsigned i = 0; output->length < size; i++) {{
+        UwValue status = put(output, "para_%u:\n    :folded:\n", i);
+        uw_return_if_error(&status);
+
+        unsigned num_lines = 3 + corpus_rng_range(rng, 8);
+        for (unsigned j = 0; j < num_lines; j++) {
+            if (j && j + 1 < num_lines && corpus_rng_range(rng, 5) == 0) {
+                status = _amw_output_putc(output, '\n');
+                uw_return_if_error(&status);
+            }
+            status = put_indent(output, 8);
+            uw_return_if_error(&status);
+            status = put_words(output, rng, 5 + corpus_rng_range(rng, 8));
+            uw_return_if_error(&status);
+            status = _amw_output_putc(output, '\n');
+            uw_return_if_error(&status);
+        }
+    }}
+    return UwOK();
+}
+
+static UwResult gen_quoted_strings(AmwOutput* output, size_t size, CorpusRng* rng)
+/*
+ * List of single-line and multi-line quoted strings with escapes.
+ */
+{
+    while (output->length < size) {{
+        UwValue status = put(output, "- \"");
+        uw_return_if_error(&status);
+
+        unsigned num_lines = corpus_rng_range(rng, 2)? 1 : 2 + corpus_rng_range(rng, 4);
+        for (unsigned j = 0; j < num_lines; j++) {
+            if (j) {
+                // block indent is next to the opening quote
+                status = put(output, "\n   ");
+                uw_return_if_error(&status);
+            }
+            status = put_escaped_words(output, rng, 4 + corpus_rng_range(rng, 8), 33);
+            uw_return_if_error(&status);
+        }
+        status = put(output, "\"\n");
+        uw_return_if_error(&status);
+    }}
+    return UwOK();
+}
+
+static UwResult put_number(AmwOutput* output, CorpusRng* rng)
+/*
+ * Write random integer or float in one of various forms.
+ */
+{
+    switch (corpus_rng_range(rng, 6)) {
+        case 0:
+            return put(output, "%u", corpus_rng_range(rng, 1000));
+        case 1:
+            return put(output, "-%llu", (unsigned long long) (corpus_rng_next(rng) >> 2));
+        case 2:
+            return put(output, "+%u", corpus_rng_range(rng, 100000));
+        case 3:
+            // above signed range
+            return put(output, "%llu", 9300000000000000000ULL + (corpus_rng_next(rng) >> 14));
+        case 4:
+            return put(output, "%u.%04u", corpus_rng_range(rng, 100000), corpus_rng_range(rng, 10000));
+        default:
+            return put(output, "-%u.%03ue%d", corpus_rng_range(rng, 10),
+                       corpus_rng_range(rng, 1000), (int) corpus_rng_range(rng, 600) - 300);
+    }
+}
+
+static UwResult put_datetime(AmwOutput* output, CorpusRng* rng)
+/*
+ * Write conversion specifier and date in one of various formats.
+ */
+{
+    unsigned month = 1 + corpus_rng_range(rng, 12);
+    unsigned day = 1 + corpus_rng_range(rng, 28);
+    unsigned hour = corpus_rng_range(rng, 24);
+    unsigned minute = corpus_rng_range(rng, 60);
+    unsigned second = corpus_rng_range(rng, 60);
+
+    switch (corpus_rng_range(rng, 3)) {
+        case 0:
+            return put(output, ":datetime: 2024-%02u-%02uT%02u:%02u:%02u.%06uZ",
+                       month, day, hour, minute, second, corpus_rng_range(rng, 1000000));
+        case 1:
+            return put(output, ":datetime: 2024-%02u-%02u %02u:%02u:%02u+%02u:00",
+                       month, day, hour, minute, second, corpus_rng_range(rng, 12));
+        default:
+            return put(output, ":datetime: 2024%02u%02uT%02u:%02u:%02uZ",
+                       month, day, hour, minute, second);
+    }
+}
+
+static UwResult put_timestamp(AmwOutput* output, CorpusRng* rng)
+{
+    return put(output, ":timestamp: %u.%09u",
+               1700000000 + corpus_rng_range(rng, 100000000), corpus_rng_range(rng, 1000000000));
+}
+
+static UwResult gen_numbers(AmwOutput* output, size_t size, CorpusRng* rng)
+/*
+ * List of integers and floats in various forms.
+ */
+{
+    while (output->length < size) {{
+        UwValue status = put(output, "- ");
+        uw_return_if_error(&status);
+        status = put_number(output, rng);
+        uw_return_if_error(&status);
+        status = _amw_output_putc(output, '\n');
+        uw_return_if_error(&status);
+    }}
+    return UwOK();
+}
+
+static UwResult gen_datetimes(AmwOutput* output, size_t size, CorpusRng* rng)
+/*
+ * Log records with dates in various formats and timestamps.
+ */
+{
+    while (output->length < size) {{
+        UwValue status = put(output, "- time: ");
+        uw_return_if_error(&status);
+        status = put_datetime(output, rng);
+        uw_return_if_error(&status);
+        status = put(output, "\n  stamp: ");
+        uw_return_if_error(&status);
+        status = put_timestamp(output, rng);
+        uw_return_if_error(&status);
+        status = put(output, "\n  level: %s\n  message: ", log_levels[corpus_rng_range(rng, 4)]);
+        uw_return_if_error(&status);
+        status = put_words(output, rng, 4 + corpus_rng_range(rng, 8));
+        uw_return_if_error(&status);
+        status = _amw_output_putc(output, '\n');
+        uw_return_if_error(&status);
+    }}
+    return UwOK();
+}
+
+static UwResult gen_json_blocks(AmwOutput* output, size_t size, CorpusRng* rng)
+/*
+ * Multi-line and single-line :json: blocks.
+ */
+{
+    for (unsigned i = 0; output->length < size; i++) {{
+        if (i % 4 == 3) {
+            UwValue status = put(output, "inline_%u: :json: [%u, %u.5, \"%s\", null, false]\n",
+                                 i, corpus_rng_range(rng, 1000), corpus_rng_range(rng, 1000),
+                                 words[corpus_rng_range(rng, NUM_WORDS)]);
+            uw_return_if_error(&status);
+            continue;
+        }
+        UwValue status = put(output, "block_%u: :json:\n    {\n        \"id\": %u,\n        \"name\": \"",
+                             i, i);
+        uw_return_if_error(&status);
+        status = put_escaped_words(output, rng, 3 + corpus_rng_range(rng, 4), 33);
+        uw_return_if_error(&status);
+        status = put(output, "\",\n        \"enabled\": %s,\n        \"tags\": [",
+                     corpus_rng_range(rng, 2)? "true" : "false");
+        uw_return_if_error(&status);
+        unsigned num_tags = 1 + corpus_rng_range(rng, 5);
+        for (unsigned j = 0; j < num_tags; j++) {
+            status = put(output, j? ", \"%s\"" : "\"%s\"", words[corpus_rng_range(rng, NUM_WORDS)]);
+            uw_return_if_error(&status);
+        }
+        status = put(output, "],\n        \"values\": [%u, %u.25, -%u],\n",
+                     corpus_rng_range(rng, 100000), corpus_rng_range(rng, 1000), corpus_rng_range(rng, 1000));
+        uw_return_if_error(&status);
+        status = put(output, "        \"nested\": {\"a\": null, \"b\": \"%s\"}\n    }\n",
+                     words[corpus_rng_range(rng, NUM_WORDS)]);
+        uw_return_if_error(&status);
+    }}
+    return UwOK();
+}
+
+static UwResult gen_short_lines(AmwOutput* output, size_t size, CorpusRng* rng)
+/*
+ * Lists of one-word items and :json: arrays with one number per line.
+ * Nearly all work is per line, so it shows the cost of reading block lines.
+ */
+{
+    for (unsigned i = 0; output->length < size; i++) {{
+        bool json = i & 1;
+        UwValue status = put(output, json? "numbers_%u: :json:\n    [\n" : "items_%u:\n", i);
+        uw_return_if_error(&status);
+
+        unsigned num_lines = 8 + corpus_rng_range(rng, 24);
+        for (unsigned j = 0; j < num_lines; j++) {
+            if (json) {
+                status = put(output, j + 1 < num_lines? "        %u,\n" : "        %u\n    ]\n",
+                             corpus_rng_range(rng, 1000));
+            } else {
+                status = put(output, "  - %s\n", words[corpus_rng_range(rng, NUM_WORDS)]);
+            }
+            uw_return_if_error(&status);
+        }
+    }}
+    return UwOK();
+}
+
+static UwResult gen_mixed(AmwOutput* output, size_t size, CorpusRng* rng);
+
+Corpus corpora[] = {
+    { "wide_map",        gen_wide_map },
+    { "deep_nesting",    gen_deep_nesting },
+    { "literal_strings", gen_literal_strings },
+    { "folded_strings",  gen_folded_strings },
+    { "quoted_strings",  gen_quoted_strings },
+    { "numbers",         gen_numbers },
+    { "datetimes",       gen_datetimes },
+    { "json_blocks",     gen_json_blocks },
+    { "short_lines",     gen_short_lines },
+    { "mixed",           gen_mixed }
+};
+
+unsigned num_corpora = sizeof(corpora) / sizeof(corpora[0]);
+
+UwResult corpus_generate(Corpus* corpus, size_t size, AmwOutput* output)
+{
+    CorpusRng rng = { .state = CORPUS_SEED };
+    return corpus->generate(output, output->length + size, &rng);
+}
+
+/*
+ * Corpus of controllable shape
+ */
+
+typedef struct {
+    bool      is_map;
+    bool      inline_first;  // the first entry continues the line of list item
+    unsigned  indent;
+    unsigned  remaining;     // number of entries to generate
+} ShapeFrame;
+
+static UwResult put_comment(AmwOutput* output, CorpusRng* rng)
+{
+    UwValue status = put(output, "  # ");
+    uw_return_if_error(&status);
+    return put_words(output, rng, 2 + corpus_rng_range(rng, 4));
+}
+
+static UwResult put_key(AmwOutput* output, CorpusRng* rng, CorpusShape* shape, unsigned* length)
+/*
+ * Write random key of lowercase letters, write its length to `length`.
+ */
+{
+    unsigned n = shape->key_min_length;
+    if (shape->key_max_length > n) {
+        n += corpus_rng_range(rng, shape->key_max_length - n + 1);
+    }
+    UwValue status = _amw_output_reserve(output, n);
+    uw_return_if_error(&status);
+    for (unsigned i = 0; i < n; i++) {
+        output->data[output->length++] = 'a' + corpus_rng_range(rng, 26);
+    }
+    *length = n;
+    return UwOK();
+}
+
+static UwResult put_lines(AmwOutput* output, CorpusRng* rng, unsigned indent, unsigned num_lines)
+/*
+ * Write `num_lines` lines of words, each preceded by line break.
+ * The first line has exactly `indent`, the following ones may be indented more.
+ */
+{
+    for (unsigned j = 0; j < num_lines; j++) {{
+        UwValue status = _amw_output_putc(output, '\n');
+        uw_return_if_error(&status);
+        status = put_indent(output, indent + (j? corpus_rng_range(rng, 3) : 0));
+        uw_return_if_error(&status);
+        status = put_words(output, rng, 3 + corpus_rng_range(rng, 8));
+        uw_return_if_error(&status);
+    }}
+    return UwOK();
+}
+
+static unsigned choose_string_kind(CorpusRng* rng, CorpusShape* shape)
+{
+    unsigned total = 0;
+    for (unsigned i = 0; i < CORPUS_NUM_STRING_KINDS; i++) {
+        total += shape->string_mix[i];
+    }
+    if (total == 0) {
+        return CORPUS_LITERAL;
+    }
+    unsigned r = corpus_rng_range(rng, total);
+    for (unsigned i = 0; i < CORPUS_NUM_STRING_KINDS; i++) {
+        if (r < shape->string_mix[i]) {
+            return i;
+        }
+        r -= shape->string_mix[i];
+    }
+    return CORPUS_LITERAL;
+}
+
+static UwResult put_string(AmwOutput* output, CorpusRng* rng, CorpusShape* shape,
+                           bool map_value, unsigned indent, unsigned column)
+/*
+ * Write string value of entry that starts at `indent`.
+ * `column` is the position right after the key separator or dash.
+ */
+{
+    // multi-line values of map entries start on the next line with deeper indent,
+    // list items continue on the next line with the indent of item
+    unsigned block_indent = map_value? indent + 4 : indent + 2;
+    bool multiline = corpus_rng_range(rng, 2);
+    unsigned num_lines = 2 + corpus_rng_range(rng, 6);
+
+    switch (choose_string_kind(rng, shape)) {
+        case CORPUS_QUOTED: {
+            UwValue status = put(output, " \"");
+            uw_return_if_error(&status);
+            status = put_escaped_words(output, rng, 2 + corpus_rng_range(rng, 8), shape->escape_percent);
+            uw_return_if_error(&status);
+            if (multiline) {
+                // block indent is next to the opening quote
+                for (unsigned j = 1; j < num_lines; j++) {
+                    status = _amw_output_putc(output, '\n');
+                    uw_return_if_error(&status);
+                    status = put_indent(output, column + 2);
+                    uw_return_if_error(&status);
+                    status = put_escaped_words(output, rng, 2 + corpus_rng_range(rng, 8), shape->escape_percent);
+                    uw_return_if_error(&status);
+                }
+            }
+            status = _amw_output_putc(output, '"');
+            uw_return_if_error(&status);
+            if (!multiline && corpus_rng_range(rng, 100) < shape->comment_percent) {
+                return put_comment(output, rng);
+            }
+            return UwOK();
+        }
+        case CORPUS_FOLDED: {
+            UwValue status = put(output, " :folded:");
+            uw_return_if_error(&status);
+            return put_lines(output, rng, block_indent, num_lines);
+        }
+        case CORPUS_RAW: {
+            if (!multiline) {
+                // comment is a part of raw value
+                UwValue status = put(output, " :raw: ");
+                uw_return_if_error(&status);
+                status = put_words(output, rng, 2 + corpus_rng_range(rng, 6));
+                uw_return_if_error(&status);
+                return put(output, " # raw");
+            }
+            UwValue status = put(output, " :raw:");
+            uw_return_if_error(&status);
+            return put_lines(output, rng, block_indent, num_lines);
+        }
+        default: {
+            if (multiline && map_value) {
+                if (corpus_rng_range(rng, 100) < shape->comment_percent) {
+                    UwValue status = put_comment(output, rng);
+                    uw_return_if_error(&status);
+                }
+                return put_lines(output, rng, block_indent, num_lines);
+            }
+            UwValue status = _amw_output_putc(output, ' ');
+            uw_return_if_error(&status);
+            status = put_words(output, rng, 2 + corpus_rng_range(rng, 6));
+            uw_return_if_error(&status);
+            if (multiline) {
+                return put_lines(output, rng, block_indent, num_lines - 1);
+            }
+            return UwOK();
+        }
+    }
+}
+
+static UwResult put_scalar(AmwOutput* output, CorpusRng* rng, CorpusShape* shape,
+                           bool map_value, unsigned indent, unsigned column)
+{
+    unsigned r = corpus_rng_range(rng, 100);
+    if (r < shape->number_percent) {
+        UwValue status = _amw_output_putc(output, ' ');
+        uw_return_if_error(&status);
+        status = put_number(output, rng);
+        uw_return_if_error(&status);
+        if (corpus_rng_range(rng, 100) < shape->comment_percent) {
+            return put_comment(output, rng);
+        }
+        return UwOK();
+    }
+    if (r < shape->number_percent + shape->datetime_percent) {
+        UwValue status = _amw_output_putc(output, ' ');
+        uw_return_if_error(&status);
+        return corpus_rng_range(rng, 2)? put_datetime(output, rng) : put_timestamp(output, rng);
+    }
+    return put_string(output, rng, shape, map_value, indent, column);
+}
+
+UwResult corpus_generate_shaped(CorpusShape* shape, AmwOutput* output)
+{
+    // xorshift state must not be zero
+    CorpusRng rng = { .state = shape->seed? shape->seed : CORPUS_SEED };
+    size_t size = output->length + shape->size;
+    unsigned max_depth = shape->depth;
+    if (max_depth > CORPUS_MAX_DEPTH) {
+        max_depth = CORPUS_MAX_DEPTH;
+    }
+    ShapeFrame frames[CORPUS_MAX_DEPTH];
+
+    if (corpus_rng_range(&rng, 100) < shape->comment_percent) {
+        UwValue status = put(output, "# generated by amwgen\n");
+        uw_return_if_error(&status);
+    }
+    frames[0] = (ShapeFrame) { .is_map = true, .indent = 0, .remaining = UINT_MAX };
+    unsigned num_frames = 1;
+
+    while (num_frames) {{
+        ShapeFrame* frame = &frames[num_frames - 1];
+        if (frame->remaining == 0 || (num_frames == 1 && output->length >= size)) {
+            num_frames--;
+            continue;
+        }
+        frame->remaining--;
+        bool map_value = frame->is_map;
+        unsigned indent = frame->indent;
+
+        if (frame->inline_first) {
+            frame->inline_first = false;
+        } else {
+            UwValue status = put_indent(output, indent);
+            uw_return_if_error(&status);
+        }
+        unsigned column;
+        if (map_value) {
+            unsigned key_length;
+            UwValue status = put_key(output, &rng, shape, &key_length);
+            uw_return_if_error(&status);
+            status = _amw_output_putc(output, ':');
+            uw_return_if_error(&status);
+            column = indent + key_length + 1;
+        } else {
+            UwValue status = _amw_output_putc(output, '-');
+            uw_return_if_error(&status);
+            column = indent + 1;
+        }
+
+        if (num_frames < max_depth && corpus_rng_range(&rng, 100) < CORPUS_NESTING_PERCENT) {
+            ShapeFrame nested = {
+                .is_map = corpus_rng_range(&rng, 2),
+                .indent = indent + 2,
+                .remaining = 1 + corpus_rng_range(&rng, shape->fanout? shape->fanout : 1)
+            };
+            if (map_value) {
+                // nested block starts on the next line and may begin with comments
+                if (corpus_rng_range(&rng, 100) < shape->comment_percent) {
+                    UwValue status = put_comment(output, &rng);
+                    uw_return_if_error(&status);
+                }
+                UwValue status = _amw_output_putc(output, '\n');
+                uw_return_if_error(&status);
+                if (corpus_rng_range(&rng, 100) < shape->comment_percent) {
+                    status = put_indent(output, nested.indent);
+                    uw_return_if_error(&status);
+                    status = put(output, "# nested block\n");
+                    uw_return_if_error(&status);
+                }
+            } else {
+                // nested value continues the line of list item
+                UwValue status = _amw_output_putc(output, ' ');
+                uw_return_if_error(&status);
+                nested.inline_first = true;
+            }
+            frames[num_frames++] = nested;
+            continue;
+        }
+        UwValue status = put_scalar(output, &rng, shape, map_value, indent, column);
+        uw_return_if_error(&status);
+        status = _amw_output_putc(output, '\n');
+        uw_return_if_error(&status);
+    }}
+    return UwOK();
+}
+
+static UwResult gen_mixed(AmwOutput* output, size_t size, CorpusRng* rng)
+/*
+ * Corpus of default shape.
+ */
+{
+    CorpusShape shape = CORPUS_DEFAULT_SHAPE;
+    shape.size = size - output->length;
+    shape.seed = corpus_rng_next(rng);
+    return corpus_generate_shaped(&shape, output);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+/*
+ * Synthetic corpora for benchmarks.
+ *
+ * Each corpus is generated deterministically from a fixed seed,
+ * so results are comparable between runs and machines.
+ */
+
+#include <amw.h>
+
+typedef struct {
+    uint64_t  state;
+} CorpusRng;
+
+static inline uint64_t corpus_rng_next(CorpusRng* rng)
+/*
+ * xorshift64*
+ */
+{
+    uint64_t x = rng->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rng->state = x;
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+static inline unsigned corpus_rng_range(CorpusRng* rng, unsigned n)
+/*
+ * Return random number in range 0 ... n - 1.
+ */
+{
+    return (unsigned) ((corpus_rng_next(rng) >> 32) * n >> 32);
+}
+
+#define CORPUS_SEED  0x616d775f62656e63ULL
+
+typedef UwResult (*CorpusFunc)(AmwOutput* output, size_t size, CorpusRng* rng);
+
+typedef struct {
+    char*      name;
+    CorpusFunc generate;
+} Corpus;
+
+extern Corpus corpora[];
+extern unsigned num_corpora;
+
+UwResult corpus_generate(Corpus* corpus, size_t size, AmwOutput* output);
+/*
+ * Append AMW markup of approximately `size` bytes to `output`.
+ * Output should have no flush function.
+ */
+
+/*
+ * Corpus of controllable shape, see amwgen.c
+ *
+ * The top-level value is a map with entries generated until the size is reached.
+ * Entries are nested maps or lists with probability CORPUS_NESTING_PERCENT
+ * unless maximal depth is reached, otherwise scalars.
+ * Scalars are numbers, dates or timestamps, and strings in proportions given by the shape.
+ */
+
+#define CORPUS_NESTING_PERCENT  30
+#define CORPUS_MAX_DEPTH        256
+
+enum {
+    CORPUS_LITERAL,
+    CORPUS_QUOTED,
+    CORPUS_FOLDED,
+    CORPUS_RAW,
+    CORPUS_NUM_STRING_KINDS
+};
+
+typedef struct {
+    size_t    size;
+    uint64_t  seed;
+    unsigned  depth;            // maximal nesting depth, 1 for flat map
+    unsigned  fanout;           // maximal number of items in nested containers
+    unsigned  key_min_length;   // key lengths are uniformly distributed
+    unsigned  key_max_length;   // between min and max
+    unsigned  string_mix[CORPUS_NUM_STRING_KINDS];  // weights of string kinds
+    unsigned  escape_percent;   // words in quoted strings preceded by escape
+    unsigned  number_percent;   // scalars that are numbers
+    unsigned  datetime_percent; // scalars that are dates or timestamps
+    unsigned  comment_percent;  // probability of comment where it is allowed
+} CorpusShape;
+
+#define CORPUS_DEFAULT_SHAPE  {  \
+    .size = 1 << 20,             \
+    .seed = CORPUS_SEED,         \
+    .depth = 4,                  \
+    .fanout = 8,                 \
+    .key_min_length = 3,         \
+    .key_max_length = 12,        \
+    .string_mix = { 1, 1, 1, 1 },\
+    .escape_percent = 10,        \
+    .number_percent = 30,        \
+    .datetime_percent = 10,      \
+    .comment_percent = 5         \
+}
+
+UwResult corpus_generate_shaped(CorpusShape* shape, AmwOutput* output);
+/*
+ * Append AMW markup of approximately `shape->size` bytes to `output`.
+ * Output should have no flush function.
+ */
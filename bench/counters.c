@@ -0,0 +1,84 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "bench.h"
+
+AllocStats alloc_stats = {};
+uint64_t copied_bytes = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void  __real_free(void* ptr);
+void* __real_memcpy(void* dest, const void* src, size_t n);
+void* __real_memmove(void* dest, const void* src, size_t n);
+
+void* __wrap_malloc(size_t size)
+{
+    alloc_stats.count++;
+    alloc_stats.bytes += size;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size)
+{
+    alloc_stats.count++;
+    alloc_stats.bytes += n * size;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    alloc_stats.count++;
+    alloc_stats.bytes += size;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void* ptr)
+{
+    __real_free(ptr);
+}
+
+void* __wrap_memcpy(void* dest, const void* src, size_t n)
+{
+    copied_bytes += n;
+    return __real_memcpy(dest, src, n);
+}
+
+void* __wrap_memmove(void* dest, const void* src, size_t n)
+{
+    copied_bytes += n;
+    return __real_memmove(dest, src, n);
+}
+
+long bench_peak_rss_kb()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    return usage.ru_maxrss;
+}
+
+int bench_open_instruction_counter()
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    return fd < 0? -1 : fd;
+}
+
+bool bench_read_counter(int fd, uint64_t* value)
+{
+    return fd >= 0 && read(fd, value, sizeof(uint64_t)) == sizeof(uint64_t);
+}
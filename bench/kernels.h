@@ -0,0 +1,13 @@
+#pragma once
+
+/*
+ * Static functions of the parser exposed to microbenchmarks,
+ * see kernels_parser.c and kernels_json.c
+ */
+
+#include <amw.h>
+
+UwResult _bench_parse_datetime(AmwParser* parser);
+UwResult _bench_parse_timestamp(AmwParser* parser);
+UwResult _bench_fold_lines(AmwParser* parser, UwValuePtr lines);
+UwResult _bench_json_skip_spaces(AmwParser* parser, unsigned* pos);
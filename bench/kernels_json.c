@@ -0,0 +1,14 @@
+/*
+ * amw_json.c with static functions exposed to microbenchmarks, see amw_kernels.c
+ *
+ * This file is compiled instead of amw_json.c, so it is not a part of amw library.
+ */
+
+#include "../amw_json.c"
+
+#include "kernels.h"
+
+UwResult _bench_json_skip_spaces(AmwParser* parser, unsigned* pos)
+{
+    return skip_spaces(parser, pos, __LINE__);
+}
@@ -0,0 +1,24 @@
+/*
+ * amw_parser.c with static functions exposed to microbenchmarks, see amw_kernels.c
+ *
+ * This file is compiled instead of amw_parser.c, so it is not a part of amw library.
+ */
+
+#include "../amw_parser.c"
+
+#include "kernels.h"
+
+UwResult _bench_parse_datetime(AmwParser* parser)
+{
+    return parse_datetime(parser);
+}
+
+UwResult _bench_parse_timestamp(AmwParser* parser)
+{
+    return parse_timestamp(parser);
+}
+
+UwResult _bench_fold_lines(AmwParser* parser, UwValuePtr lines)
+{
+    return fold_lines(parser, lines, 0, nullptr);
+}
@@ -0,0 +1,171 @@
+/*
+ * Compile AMW document into C source.
+ *
+ * Usage: amw2c [--name NAME] [--header output.h] input.amw output.c
+ *
+ * The document is parsed and compiled at build time, see amw_compile_value.
+ * The output contains compiled image as static const array, so it is placed
+ * in .rodata, and accessor function
+ *
+ *     AmwCompiled* NAME_get();
+ *
+ * which returns the document ready for amw_compiled_* functions
+ * with no parsing and no allocation at run time.
+ *
+ * If --header is given, the declaration of the accessor is written to that file.
+ *
+ * NAME defaults to amw_embedded.
+ */
+
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <amw.h>
+
+#include "common.h"
+
+#define BYTES_PER_LINE  16
+
+static bool valid_name(char* name)
+{
+    if (!(isalpha(*name) || *name == '_')) {
+        return false;
+    }
+    for (char* p = name; *p; p++) {
+        if (!(isalnum(*p) || *p == '_')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool write_source(FILE* out, char* input_path, char* name, uint8_t* data, size_t size)
+{
+    fprintf(out, "// generated by amw2c from %s, do not edit\n\n", input_path);
+    fprintf(out, "#include <amw.h>\n\n");
+
+    // nodes contain 64-bit values, align the image as allocate would do
+    fprintf(out, "static const uint8_t _Alignas(AmwCompiledNode) %s_data[%zu] = {\n", name, size);
+    for (size_t i = 0; i < size; i++) {
+        if (i % BYTES_PER_LINE == 0) {
+            fputs("    ", out);
+        }
+        fprintf(out, "0x%02x,", data[i]);
+        if (i % BYTES_PER_LINE == BYTES_PER_LINE - 1 || i + 1 == size) {
+            fputc('\n', out);
+        } else {
+            fputc(' ', out);
+        }
+    }
+    fprintf(out, "};\n\n");
+
+    // accessor functions do not modify the image, so casting away const is safe
+    fprintf(out, "static AmwCompiled %s = {\n", name);
+    fprintf(out, "    .data = (uint8_t*) %s_data,\n", name);
+    fprintf(out, "    .size = sizeof(%s_data)\n", name);
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "AmwCompiled* %s_get()\n", name);
+    fprintf(out, "{\n");
+    fprintf(out, "    return &%s;\n", name);
+    fprintf(out, "}\n");
+
+    return !ferror(out);
+}
+
+static bool write_header(FILE* out, char* input_path, char* name, uint8_t* data, size_t size)
+{
+    fprintf(out, "// generated by amw2c from %s, do not edit\n\n", input_path);
+    fprintf(out, "#pragma once\n\n");
+    fprintf(out, "#include <amw.h>\n\n");
+    fprintf(out, "AmwCompiled* %s_get();\n", name);
+    fprintf(out, "/*\n");
+    fprintf(out, " * Return document compiled from %s.\n", input_path);
+    fprintf(out, " */\n");
+
+    return !ferror(out);
+}
+
+typedef bool (*WriteFunc)(FILE* out, char* input_path, char* name, uint8_t* data, size_t size);
+
+static UwResult write_file(char* output_path, WriteFunc write, char* input_path, char* name,
+                           uint8_t* data, size_t size)
+/*
+ * Create output file with `write` function, remove it on error.
+ */
+{
+    FILE* out = fopen(output_path, "w");
+    if (!out) {
+        return _amw_io_error("Cannot create", output_path);
+    }
+    bool ok = write(out, input_path, name, data, size);
+
+    if (fclose(out) != 0 || !ok) {
+        UwValue error = _amw_io_error("Cannot write", output_path);
+        unlink(output_path);
+        return uw_move(&error);
+    }
+    return UwOK();
+}
+
+static UwResult compile_to_source(char* input_path, char* output_path, char* header_path, char* name)
+{
+    UwValue lines = amw_read_file_lines(input_path);
+    uw_return_if_error(&lines);
+
+    UwValue value = amw_parse(&lines);
+    uw_return_if_error(&value);
+
+    uint8_t* data;
+    size_t size;
+    UwValue status = _amw_compile_to_buffer(&value, &data, &size);
+    uw_return_if_error(&status);
+
+    status = write_file(output_path, write_source, input_path, name, data, size);
+    if (uw_ok(&status) && header_path) {
+        status = write_file(header_path, write_header, input_path, name, data, size);
+        if (uw_error(&status)) {
+            unlink(output_path);
+        }
+    }
+    release((void**) &data, size);
+    return uw_move(&status);
+}
+
+int main(int argc, char* argv[])
+{
+    char* name = "amw_embedded";
+    char* header_path = nullptr;
+    char* paths[2];
+    unsigned num_paths = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+            name = argv[++i];
+        } else if (strcmp(argv[i], "--header") == 0 && i + 1 < argc) {
+            header_path = argv[++i];
+        } else if (argv[i][0] != '-' && num_paths < 2) {
+            paths[num_paths++] = argv[i];
+        } else {
+            num_paths = 0;
+            break;
+        }
+    }
+    if (num_paths != 2) {
+        fprintf(stderr, "Usage: %s [--name NAME] [--header output.h] input.amw output.c\n", argv[0]);
+        return 2;
+    }
+    if (!valid_name(name)) {
+        fprintf(stderr, "%s: bad name %s\n", argv[0], name);
+        return 2;
+    }
+    UwValue status = compile_to_source(paths[0], paths[1], header_path, name);
+    if (uw_error(&status)) {
+        print_error(paths[0], &status);
+        return 1;
+    }
+    return 0;
+}
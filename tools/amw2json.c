@@ -0,0 +1,290 @@
+/*
+ * Convert AMW to JSON and back without loading the whole document.
+ *
+ * Usage: amw2json [--ndjson] [--reverse] [input [output]]
+ *
+ * Input and output default to stdin and stdout.
+ *
+ * Input is read by chunks and entries of the top-level map or list
+ * are written out as soon as they are parsed, see AmwEventHandler,
+ * so memory usage is bounded by the largest top-level entry
+ * plus the set of top-level keys.
+ *
+ * A top-level map key that occurs twice is an error: the first entry is
+ * written already, while amw_parse would keep only the last one.
+ *
+ * --ndjson     write each top-level list item on its own line,
+ *              and each top-level map entry as single-member object
+ * --reverse    convert JSON to AMW
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <amw.h>
+
+#include "common.h"
+
+typedef struct {
+    AmwParser* parser;
+    AmwOutput* output;
+    bool       ndjson;
+    bool       is_map;
+    bool       started;  // top-level container is written
+    unsigned   count;
+    _UwValue   keys;     // top-level keys written so far
+} JsonWriter;
+
+static UwResult check_duplicate_key(JsonWriter* jw, UwValuePtr key)
+/*
+ * Return parse error if top-level key is already written, remember it otherwise.
+ */
+{
+    if (uw_map_has_key(&jw->keys, key)) {
+        if (!uw_is_string(key)) {
+            return amw_parser_error(jw->parser, jw->parser->current_indent, "Duplicate top-level key");
+        }
+        char buf[uw_strlen_in_utf8(key) + 1];
+        uw_substr_to_utf8_buf(key, 0, uw_strlen(key), buf);
+        return amw_parser_error(jw->parser, jw->parser->current_indent, "Duplicate top-level key %s", buf);
+    }
+    UwValue null = UwNull();
+    return uw_map_update(&jw->keys, key, &null);
+}
+
+static UwResult json_begin(void* ctx, bool is_map)
+{
+    JsonWriter* jw = ctx;
+    jw->is_map = is_map;
+    jw->started = true;
+    jw->count = 0;
+    if (jw->ndjson) {
+        return UwOK();
+    }
+    return _amw_output_putc(jw->output, is_map? '{' : '[');
+}
+
+static UwResult json_entry(void* ctx, UwValuePtr key, UwValuePtr value)
+{
+    JsonWriter* jw = ctx;
+    if (key) {
+        UwValue status = check_duplicate_key(jw, key);
+        uw_return_if_error(&status);
+    }
+    if (jw->ndjson) {
+        if (key) {
+            UwValue status = _amw_output_putc(jw->output, '{');
+            uw_return_if_error(&status);
+            status = _amw_dump_json_key(jw->output, key);
+            uw_return_if_error(&status);
+            status = _amw_dump_json_value(jw->output, value);
+            uw_return_if_error(&status);
+            status = _amw_output_putc(jw->output, '}');
+            uw_return_if_error(&status);
+        } else {
+            UwValue status = _amw_dump_json_value(jw->output, value);
+            uw_return_if_error(&status);
+        }
+        jw->count++;
+        return _amw_output_putc(jw->output, '\n');
+    }
+    if (jw->count++) {
+        UwValue status = _amw_output_putc(jw->output, ',');
+        uw_return_if_error(&status);
+    }
+    if (key) {
+        UwValue status = _amw_dump_json_key(jw->output, key);
+        uw_return_if_error(&status);
+    }
+    return _amw_dump_json_value(jw->output, value);
+}
+
+static UwResult json_end(void* ctx)
+{
+    JsonWriter* jw = ctx;
+    if (jw->ndjson) {
+        return UwOK();
+    }
+    return _amw_output_write(jw->output, jw->is_map? "}\n" : "]\n", 2);
+}
+
+static UwResult amw_begin(void* ctx, bool is_map)
+{
+    return is_map? amw_writer_begin_map(ctx) : amw_writer_begin_list(ctx);
+}
+
+static UwResult amw_entry(void* ctx, UwValuePtr key, UwValuePtr value)
+{
+    if (key) {
+        UwValue status = amw_writer_key(ctx, key);
+        uw_return_if_error(&status);
+    }
+    return amw_writer_scalar(ctx, value);
+}
+
+static UwResult amw_end(void* ctx)
+{
+    return amw_writer_end(ctx);
+}
+
+static UwResult amw_to_json(AmwParser* parser, int fd, bool ndjson)
+{
+    AmwOutput output;
+    UwValue status = amw_init_output(&output, 0, amw_write_fd, &fd);
+    uw_return_if_error(&status);
+
+    JsonWriter jw = { .parser = parser, .output = &output, .ndjson = ndjson, .keys = UwMap() };
+    if (uw_error(&jw.keys)) {
+        amw_fini_output(&output);
+        return uw_move(&jw.keys);
+    }
+    AmwEventHandler handler = {
+        .begin = json_begin,
+        .entry = json_entry,
+        .end   = json_end
+    };
+    parser->handler = &handler;
+    parser->handler_ctx = &jw;
+
+    UwValue value = amw_parser_parse(parser);
+    if (uw_ok(&value) && !jw.started) {
+        // top-level scalar is not streamed
+        status = _amw_dump_json_value(&output, &value);
+        if (uw_ok(&status)) {
+            status = _amw_output_putc(&output, '\n');
+        }
+    } else {
+        uw_destroy(&status);
+        status = uw_move(&value);
+    }
+    if (uw_ok(&status)) {
+        uw_destroy(&status);
+        status = amw_flush_output(&output);
+    }
+    amw_fini_output(&output);
+    uw_destroy(&jw.keys);
+    return uw_move(&status);
+}
+
+static UwResult json_to_amw(AmwParser* parser, int fd)
+{
+    AmwWriter writer;
+    UwValue status = amw_writer_init(&writer, fd, 0);
+    uw_return_if_error(&status);
+
+    AmwEventHandler handler = {
+        .begin = amw_begin,
+        .entry = amw_entry,
+        .end   = amw_end
+    };
+    parser->handler = &handler;
+    parser->handler_ctx = &writer;
+
+    UwValue value = amw_parser_parse_json(parser);
+    if (uw_ok(&value)) {
+        if (writer.done) {
+            // top-level container is written already
+            status = UwOK();
+        } else {
+            status = amw_writer_scalar(&writer, &value);
+        }
+        if (uw_ok(&status)) {
+            uw_destroy(&status);
+            status = amw_writer_finish(&writer);
+        }
+    } else {
+        uw_destroy(&status);
+        status = uw_move(&value);
+    }
+    amw_writer_fini(&writer);
+    return uw_move(&status);
+}
+
+static UwResult convert(int input_fd, int output_fd, bool ndjson, bool reverse)
+{
+    AmwLineReader reader;
+    UwValue status = amw_init_line_reader(&reader, input_fd, 0);
+    uw_return_if_error(&status);
+
+    UwValue lines = UwArray();
+    if (uw_error(&lines)) {
+        amw_fini_line_reader(&reader);
+        return uw_move(&lines);
+    }
+    [[ gnu::cleanup(amw_delete_parser) ]] AmwParser* parser = amw_create_parser(&lines);
+    if (!parser) {
+        amw_fini_line_reader(&reader);
+        return UwOOM();
+    }
+    parser->read_lines = amw_read_fd_lines;
+    parser->read_lines_ctx = &reader;
+
+    if (reverse) {
+        status = json_to_amw(parser, output_fd);
+    } else {
+        status = amw_to_json(parser, output_fd, ndjson);
+    }
+    amw_fini_line_reader(&reader);
+    return uw_move(&status);
+}
+
+int main(int argc, char* argv[])
+{
+    bool ndjson = false;
+    bool reverse = false;
+    char* paths[2];
+    unsigned num_paths = 0;
+    bool bad_args = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ndjson") == 0) {
+            ndjson = true;
+        } else if (strcmp(argv[i], "--reverse") == 0) {
+            reverse = true;
+        } else if (argv[i][0] != '-' && num_paths < 2) {
+            paths[num_paths++] = argv[i];
+        } else {
+            bad_args = true;
+            break;
+        }
+    }
+    if (bad_args || (ndjson && reverse)) {
+        fprintf(stderr, "Usage: %s [--ndjson] [--reverse] [input [output]]\n", argv[0]);
+        return 2;
+    }
+    char* input_path = num_paths > 0? paths[0] : "<stdin>";
+    char* output_path = num_paths > 1? paths[1] : "<stdout>";
+
+    int input_fd = 0;
+    if (num_paths > 0) {
+        input_fd = open(paths[0], O_RDONLY);
+        if (input_fd < 0) {
+            perror(paths[0]);
+            return 1;
+        }
+    }
+    int output_fd = 1;
+    if (num_paths > 1) {
+        output_fd = open(paths[1], O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (output_fd < 0) {
+            perror(paths[1]);
+            return 1;
+        }
+    }
+    UwValue status = convert(input_fd, output_fd, ndjson, reverse);
+    if (uw_error(&status)) {
+        print_error(input_path, &status);
+        if (num_paths > 1) {
+            close(output_fd);
+            unlink(output_path);
+        }
+        return 1;
+    }
+    if (num_paths > 1 && close(output_fd) != 0) {
+        perror(output_path);
+        return 1;
+    }
+    return 0;
+}
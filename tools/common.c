@@ -0,0 +1,15 @@
+#include <stdio.h>
+
+#include "common.h"
+
+void print_error(char* prefix, UwValuePtr status)
+{
+    UwValue desc = uw_to_string(status);
+    if (!uw_is_string(&desc)) {
+        fprintf(stderr, "%s: error\n", prefix);
+        return;
+    }
+    char buf[uw_strlen_in_utf8(&desc) + 1];
+    uw_substr_to_utf8_buf(&desc, 0, uw_strlen(&desc), buf);
+    fprintf(stderr, "%s: %s\n", prefix, buf);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+/*
+ * Helpers shared by command line tools and benchmarks.
+ */
+
+#include <amw.h>
+
+void print_error(char* prefix, UwValuePtr status);
+/*
+ * Print description of error `status` to stderr after `prefix` and colon.
+ */